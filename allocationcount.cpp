@@ -0,0 +1,26 @@
+// Replaces the global operator new to count every thread's heap allocations for --stats. In a file of its own, so
+// that GCC doesn't see the free() when inlining operator delete into code using a plain operator new allocation.
+#include <stdlib.h>  // for malloc, free
+#include <new>       // for bad_alloc
+#include "stats.h"   // for countAllocation
+
+#ifdef TOXSAVE_HAVE_STATS
+void* operator new(size_t size)
+{
+    countAllocation();
+    if (void* p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+#endif
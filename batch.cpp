@@ -0,0 +1,150 @@
+#include "batch.h"
+#include <algorithm>          // for sort
+#include <atomic>             // for atomic
+#include <chrono>             // for steady_clock, duration
+#include <exception>          // for exception
+#include <filesystem>         // for recursive_directory_iterator, directory_options, is_directory
+#include <iostream>           // for cin, cout, cerr, ostream
+#include <memory>             // for unique_ptr
+#include <mutex>              // for mutex, lock_guard
+#include <system_error>       // for error_code, errc
+#include "encryptedsave.h"    // for DecryptedSave, KeyCache, openSave
+#include "mappedfile.h"       // for MappedFile
+#include "outputbuffer.h"     // for OutputBuffer
+#include "profilecache.h"     // for ProfileCache
+#include "stats.h"            // for StatsReport, StatsScope, PoolTaskTimer
+#include "threadpool.h"       // for blockingMap
+
+namespace {
+void addDirectory(const std::string& directory, std::vector<std::string>& paths)
+{
+    // An entry that can't be examined (a symlink loop, an I/O error) is still listed, so opening it fails and it is
+    // reported and counted like any other bad file instead of ending the whole run.
+    std::vector<std::string> found;
+    std::error_code error;
+    std::filesystem::recursive_directory_iterator entry(
+        directory, std::filesystem::directory_options::skip_permission_denied, error);
+    if (error) {
+        paths.emplace_back(directory);
+        return;
+    }
+    const std::filesystem::recursive_directory_iterator end;
+    while (entry != end) {
+        const std::string path = entry->path().string();
+        const bool regular = entry->is_regular_file(error);
+        // a dangling symlink is nothing to parse rather than a bad entry
+        if ((error && error != std::errc::no_such_file_or_directory)
+            || (regular && entry->path().extension() == ".tox")) {
+            found.emplace_back(path);
+        }
+        entry.increment(error);
+        if (error) {
+            // descending into path failed, and the iterator can't go on after that: the rest of the tree is left out
+            found.emplace_back(path);
+            break;
+        }
+    }
+    // directory order is arbitrary, keep runs over the same tree comparable
+    std::sort(found.begin(), found.end());
+    paths.insert(paths.end(), found.begin(), found.end());
+}
+
+void addInput(const std::string& input, std::vector<std::string>& paths)
+{
+    std::error_code error;
+    if (std::filesystem::is_directory(input, error)) {
+        addDirectory(input, paths);
+    } else {
+        paths.emplace_back(input);
+    }
+}
+}
+
+std::vector<std::string> collectProfilePaths(const std::vector<std::string>& inputs, bool readStdin)
+{
+    std::vector<std::string> paths;
+    for (const auto& input : inputs) {
+        addInput(input, paths);
+    }
+
+    if (readStdin) {
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            if (!line.empty()) {
+                addInput(line, paths);
+            }
+        }
+    }
+    return paths;
+}
+
+BatchResult runBatch(const std::vector<std::string>& profilePaths, OutputOptions options,
+                     const std::optional<std::string>& passphrase, ProfileCache* cache, StatsReport* stats)
+{
+    std::atomic<size_t> failed{0};
+    std::atomic<uint64_t> bytes{0};
+    std::mutex outputMutex;
+    // shared by the pool threads, which derive the keys of different salts in parallel
+    KeyCache keys;
+    OutputBuffer stdoutBuffer(1);
+    options.parallelSections = false;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    // One task per file; the pool hands out files as threads free up, so a few huge profiles don't hold back the
+    // rest. Sections within a file are decoded inline since every pool thread is already busy with a file.
+    blockingMap(profilePaths, [&](const std::string& path) {
+        PoolTaskTimer timer(stats ? &stats->addProfile() : nullptr);
+        // each pool thread keeps its buffer, so after the first few files nothing is allocated for output
+        thread_local OutputBuffer fileBuffer;
+        fileBuffer.clear();
+        try {
+            uint64_t size = 0;
+            if (cache && cache->write(path, options, fileBuffer, true, size)) {
+                bytes += size;
+            } else {
+                MappedFile file(path);
+                std::unique_ptr<DecryptedSave> decrypted;
+                writeProfileOutput(openSave(file.data(), file.size(), passphrase, keys, decrypted), options, fileBuffer,
+                                   path);
+                bytes += file.size();
+            }
+
+            std::lock_guard<std::mutex> lock(outputMutex);
+            stdoutBuffer.append(fileBuffer.data(), fileBuffer.size());
+        }
+        catch (const std::exception& e) {
+            ++failed;
+            std::lock_guard<std::mutex> lock(outputMutex);
+            std::cerr << path << ": " << e.what() << std::endl;
+        }
+    });
+    {
+        StatsScope scope(stats ? &stats->outsideProfiles() : nullptr);
+        stdoutBuffer.flush();
+    }
+
+    BatchResult result;
+    result.files = profilePaths.size();
+    result.failed = failed;
+    result.bytes = bytes;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (cache) {
+        result.cacheHits = cache->hits;
+        result.partialCacheHits = cache->partialHits;
+    }
+    return result;
+}
+
+void printBatchSummary(const BatchResult& result, std::ostream& out)
+{
+    const double seconds = result.seconds > 0 ? result.seconds : 1e-9;
+    out << "Parsed " << result.files - result.failed << "/" << result.files << " files ("
+        << result.failed << " failed), " << result.bytes << " bytes in " << result.seconds << " s: "
+        << result.files / seconds << " files/s, "
+        << result.bytes / seconds / (1024 * 1024) << " MiB/s";
+    if (result.cacheHits || result.partialCacheHits) {
+        out << ", " << result.cacheHits << " from cache, " << result.partialCacheHits << " partly from cache";
+    }
+    out << std::endl;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>  // for size_t
+#include <cstdint>  // for uint64_t
+#include <iosfwd>   // for ostream
+#include <optional>  // for optional
+#include <string>   // for string
+#include <vector>   // for vector
+#include "output.h"  // for OutputOptions
+
+class ProfileCache;
+class StatsReport;
+
+struct BatchResult {
+    size_t files = 0;
+    size_t failed = 0;
+    uint64_t bytes = 0;
+    double seconds = 0;
+    size_t cacheHits = 0;
+    size_t partialCacheHits = 0;
+};
+
+// Expands the command line inputs into a list of profiles: directories are searched recursively for *.tox files,
+// and with readStdin set a newline-separated list of paths is read from stdin as well. Subdirectories without read
+// permission are skipped; any other entry that can't be examined is listed anyway, so it fails like a bad file.
+std::vector<std::string> collectProfilePaths(const std::vector<std::string>& inputs, bool readStdin);
+
+// Parses every profile with whole files spread over the global thread pool, writing one {"File", "Profile"} document
+// per profile to stdout (one per line unless options.indented is set). A file that fails to open or parse is reported
+// on stderr and counted, but doesn't stop the batch. Encrypted profiles are decrypted with passphrase, deriving each
+// distinct salt's key once. With a cache, unchanged profiles are written from it instead of being decoded. With stats
+// every profile is counted into one of its ProfileStats.
+BatchResult runBatch(const std::vector<std::string>& profilePaths, OutputOptions options,
+                     const std::optional<std::string>& passphrase = std::nullopt, ProfileCache* cache = nullptr,
+                     StatsReport* stats = nullptr);
+
+void printBatchSummary(const BatchResult& result, std::ostream& out);
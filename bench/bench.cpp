@@ -0,0 +1,310 @@
+// Times each stage of parsing a generated save and counts the allocations it makes.
+// Usage: toxsave_bench [--friends N] [--dht-nodes N] [--tcp-relays N] [--path-nodes N] [--conferences N]
+//                      [--peers N] [--seed N] [--min-time ms] [--write file]
+// Without any shape option the preset shapes are run one after another. With --write the generated save is written
+// to file instead, e.g. to feed it to toxsaveparser.
+
+#include <stdio.h>          // for printf, fprintf, fopen, fwrite
+#include <stdlib.h>         // for malloc, free, strtoul, EXIT_FAILURE
+#include <string.h>         // for strcmp
+#include <atomic>           // for atomic
+#include <chrono>           // for steady_clock, duration
+#include <cstdint>          // for uint8_t, int64_t, uint64_t
+#include <map>              // for map
+#include <memory>           // for unique_ptr, make_unique
+#include <new>              // for bad_alloc
+#include <string>           // for string
+#include <vector>           // for vector
+#include "cursor.h"         // for Cursor
+#include "decoders.h"       // for writeSection, writeSortedProfile
+#include "jsonwriter.h"     // for JsonWriter
+#include "outputbuffer.h"   // for OutputBuffer
+#include "savegen.h"        // for SaveShape, generateSave
+#include "sections.h"       // for getAllSections, parseGlobalHeader, sectionToString
+#include "sectionscan.h"    // for MagicFinder, findSectionMagicScalar, magicFinderSse2, magicFinderAvx2
+#include "writer.h"         // for Writer
+
+#ifdef TOXSAVE_HAVE_QT
+#include <qbytearray.h>     // for QByteArray
+#include <qjsondocument.h>  // for QJsonDocument
+#include <qjsonobject.h>    // for QJsonObject
+#include "qtprofile.h"      // for convertSectionToJson, combineJson
+#endif
+
+namespace {
+std::atomic<uint64_t> allocationCount{0};
+std::atomic<uint64_t> allocatedBytes{0};
+}
+
+void* operator new(size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+namespace {
+// Swallows the events, so timing writeSection with it measures the decoders alone.
+class NullWriter : public Writer {
+public:
+    void beginObject() override { ++events; }
+    void endObject() override { ++events; }
+    void beginArray() override { ++events; }
+    void endArray() override { ++events; }
+    void key(const char*) override { ++events; }
+    void string(const char*, size_t) override { ++events; }
+    void number(int64_t) override { ++events; }
+    void hex(const uint8_t*, size_t) override { ++events; }
+    void timestamp(uint64_t) override { ++events; }
+    std::unique_ptr<Writer> fork(size_t) const override { return std::make_unique<NullWriter>(); }
+    void splice(Writer& fork) override { events += static_cast<NullWriter&>(fork).events; }
+
+    uint64_t events = 0;
+};
+
+volatile uint64_t sink;
+
+struct Measurement {
+    double nsPerIteration;
+    double allocationsPerIteration;
+    double allocatedBytesPerIteration;
+};
+
+// Runs stage until minTime has passed (at least once, after one warm up run).
+template <typename Stage>
+Measurement measure(std::chrono::milliseconds minTime, Stage stage)
+{
+    stage();
+
+    const uint64_t allocationsBefore = allocationCount;
+    const uint64_t bytesBefore = allocatedBytes;
+    const auto start = std::chrono::steady_clock::now();
+    long iterations = 0;
+    std::chrono::duration<double, std::nano> elapsed{0};
+    do {
+        stage();
+        ++iterations;
+        elapsed = std::chrono::steady_clock::now() - start;
+    } while (elapsed < minTime);
+
+    return {elapsed.count() / iterations,
+            static_cast<double>(allocationCount - allocationsBefore) / iterations,
+            static_cast<double>(allocatedBytes - bytesBefore) / iterations};
+}
+
+void printRow(const std::string& stage, size_t bytes, const Measurement& m)
+{
+    const double nsPerByte = bytes ? m.nsPerIteration / bytes : 0;
+    const double mibPerSecond = bytes / (m.nsPerIteration / 1e9) / (1024 * 1024);
+    printf("%-36s %10zu %12.0f %10.3f %10.1f %12.1f %14.0f\n", stage.c_str(), bytes, m.nsPerIteration, nsPerByte,
+           mibPerSecond, m.allocationsPerIteration, m.allocatedBytesPerIteration);
+}
+
+// The salvage scan on its own, per implementation.
+void runMagicFinder(const char* name, MagicFinder finder, const std::vector<uint8_t>& save,
+                    std::chrono::milliseconds minTime)
+{
+    if (!finder) {
+        return;
+    }
+    std::vector<size_t> magics;
+    printRow(std::string("findSectionMagic ") + name, save.size(), measure(minTime, [&] {
+        magics.clear();
+        finder(save.data(), save.size(), magics);
+        sink = magics.size();
+    }));
+}
+
+void runShape(const char* name, const SaveShape& shape, uint32_t seed, std::chrono::milliseconds minTime)
+{
+    const auto save = generateSave(shape, seed);
+    const Cursor file(save.data(), save.size());
+
+    printf("\n%s: %zu friends, %zu DHT nodes, %zu TCP relays, %zu path nodes, %zu conferences x %zu peers, %zu bytes\n",
+           name, shape.friends, shape.dhtNodes, shape.tcpRelays, shape.pathNodes, shape.conferences,
+           shape.peersPerConference, save.size());
+    printf("%-36s %10s %12s %10s %10s %12s %14s\n", "stage", "bytes", "ns/iter", "ns/byte", "MiB/s", "allocs/iter",
+           "alloc B/iter");
+
+    printRow("getAllSections", save.size(), measure(minTime, [&] {
+        Cursor data = file;
+        parseGlobalHeader(data);
+        sink = getAllSections(data).size();
+    }));
+
+    runMagicFinder("scalar", findSectionMagicScalar, save, minTime);
+    runMagicFinder("SSE2", magicFinderSse2(), save, minTime);
+    runMagicFinder("AVX2", magicFinderAvx2(), save, minTime);
+
+    Cursor data = file;
+    parseGlobalHeader(data);
+    const auto sections = getAllSections(data);
+
+    // same section type can appear more than once, so sum them per type
+    std::map<std::string, std::vector<SectionHeader>> byName;
+    for (const auto& section : sections) {
+        if (section.size > 0) {
+            byName[sectionToString(section.type)].push_back(section);
+        }
+    }
+    for (const auto& [sectionName, headers] : byName) {
+        size_t bytes = 0;
+        for (const auto& header : headers) {
+            bytes += header.size;
+        }
+        printRow("decode " + sectionName, bytes, measure(minTime, [&] {
+            NullWriter writer;
+            for (const auto& header : headers) {
+                writeSection(header, writer);
+            }
+            sink = writer.events;
+        }));
+#ifdef TOXSAVE_HAVE_QT
+        printRow("convertSectionToJson " + sectionName, bytes, measure(minTime, [&] {
+            for (const auto& header : headers) {
+                sink = convertSectionToJson(header).json.isNull();
+            }
+        }));
+#endif
+    }
+
+#ifdef TOXSAVE_HAVE_QT
+    // serialization: QJsonDocument of an already decoded tree on its own, while the streaming writer can't be separated
+    // from decoding (subtract the decode rows above)
+    QJsonObject root;
+    for (const auto& section : sections) {
+        combineJson(root, convertSectionToJson(section));
+    }
+    printRow("QJsonDocument::toJson", save.size(), measure(minTime, [&] {
+        sink = QJsonDocument{root}.toJson().size();
+    }));
+#endif
+
+    OutputBuffer out;
+    printRow("decode + Document + JsonWriter", save.size(), measure(minTime, [&] {
+        out.clear();
+        JsonWriter writer(out, true);
+        writeSortedProfile(file, writer, false);
+        sink = out.size();
+    }));
+    printRow("decode + JsonWriter", save.size(), measure(minTime, [&] {
+        out.clear();
+        JsonWriter writer(out, true);
+        writeProfile(file, writer);
+        sink = out.size();
+    }));
+    printRow("decode + JsonWriter (compact)", save.size(), measure(minTime, [&] {
+        out.clear();
+        JsonWriter writer(out, false);
+        writeProfile(file, writer);
+        sink = out.size();
+    }));
+}
+
+bool parseSize(const char* value, size_t& out)
+{
+    char* end = nullptr;
+    out = strtoul(value, &end, 10);
+    return *value && !*end;
+}
+}
+
+int main(int argc, char** argv)
+{
+    SaveShape shape;
+    bool customShape = false;
+    size_t seed = 1;
+    size_t minTimeMs = 300;
+    const char* writePath = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* option = argv[i];
+        if (i + 1 == argc) {
+            fprintf(stderr, "Missing value for %s\n", option);
+            return EXIT_FAILURE;
+        }
+        const char* value = argv[++i];
+        size_t* target = nullptr;
+        if (!strcmp(option, "--friends")) {
+            target = &shape.friends;
+        } else if (!strcmp(option, "--dht-nodes")) {
+            target = &shape.dhtNodes;
+        } else if (!strcmp(option, "--tcp-relays")) {
+            target = &shape.tcpRelays;
+        } else if (!strcmp(option, "--path-nodes")) {
+            target = &shape.pathNodes;
+        } else if (!strcmp(option, "--conferences")) {
+            target = &shape.conferences;
+        } else if (!strcmp(option, "--peers")) {
+            target = &shape.peersPerConference;
+        } else if (!strcmp(option, "--seed")) {
+            target = &seed;
+        } else if (!strcmp(option, "--min-time")) {
+            target = &minTimeMs;
+        } else if (!strcmp(option, "--write")) {
+            writePath = value;
+            continue;
+        } else {
+            fprintf(stderr, "Unknown option %s\n", option);
+            return EXIT_FAILURE;
+        }
+        if (!parseSize(value, *target)) {
+            fprintf(stderr, "Invalid value for %s: %s\n", option, value);
+            return EXIT_FAILURE;
+        }
+        customShape |= target != &seed && target != &minTimeMs;
+    }
+
+    if (writePath) {
+        const auto save = generateSave(shape, static_cast<uint32_t>(seed));
+        FILE* file = fopen(writePath, "wb");
+        if (!file || fwrite(save.data(), 1, save.size(), file) != save.size() || fclose(file) != 0) {
+            fprintf(stderr, "Couldn't write %s\n", writePath);
+            return EXIT_FAILURE;
+        }
+        return 0;
+    }
+
+    const std::chrono::milliseconds minTime(minTimeMs);
+    if (customShape) {
+        runShape("custom", shape, static_cast<uint32_t>(seed), minTime);
+        return 0;
+    }
+
+    SaveShape typical;
+    typical.friends = 50;
+    typical.dhtNodes = 100;
+    typical.tcpRelays = 10;
+    typical.pathNodes = 10;
+    typical.conferences = 3;
+    typical.peersPerConference = 10;
+    runShape("typical", typical, static_cast<uint32_t>(seed), minTime);
+
+    SaveShape friends;
+    friends.friends = 10000;
+    runShape("friends", friends, static_cast<uint32_t>(seed), minTime);
+
+    SaveShape nodes;
+    nodes.dhtNodes = 100000;
+    nodes.tcpRelays = 100000;
+    runShape("nodes", nodes, static_cast<uint32_t>(seed), minTime);
+
+    SaveShape conferences;
+    conferences.conferences = 1000;
+    conferences.peersPerConference = 200;
+    runShape("conferences", conferences, static_cast<uint32_t>(seed), minTime);
+    return 0;
+}
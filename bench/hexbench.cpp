@@ -0,0 +1,104 @@
+// Micro-benchmark of the hex encoders against the old sprintf based readHexData.
+// Usage: toxsave_hexbench [iterations]
+
+#include <stdio.h>    // for sprintf, printf
+#include <stdlib.h>   // for atol, EXIT_FAILURE
+#include <chrono>     // for steady_clock, duration
+#include <cstdint>    // for uint8_t
+#include <cstring>    // for memcmp
+#include <random>     // for mt19937
+#include <string>     // for string
+#include <vector>     // for vector
+#include "hex.h"      // for hexEncode, hexEncodeScalar, hexEncoderSse2, hexEncoderAvx2
+
+namespace {
+// readHexData before the SIMD encoder (plus room for the NUL sprintf writes after the last digit pair, which the
+// original overflowed into)
+std::string sprintfHex(const uint8_t* data, int size)
+{
+    std::vector<char> hexString(size*2 + 1, 0);
+
+    for (int i = 0; i < size; ++i)
+    {
+        sprintf(hexString.data()+i*2, "%02X", data[i]);
+    }
+
+    return {hexString.begin(), hexString.end() - 1};
+}
+
+volatile char sink;
+
+template <typename Encode>
+double nsPerByte(const std::vector<uint8_t>& input, size_t size, long iterations, Encode encode)
+{
+    const size_t records = input.size() / size;
+    const auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; ++i) {
+        sink = encode(input.data() + (i % records) * size, size);
+    }
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (static_cast<double>(iterations) * size);
+}
+}
+
+int main(int argc, char** argv)
+{
+    const long iterations = argc > 1 ? atol(argv[1]) : 200000;
+
+    std::vector<uint8_t> input(1 << 16);
+    std::mt19937 random(42);
+    for (auto& byte : input) {
+        byte = static_cast<uint8_t>(random());
+    }
+
+    struct Candidate {
+        const char* name;
+        HexEncoder encode;
+    };
+    std::vector<Candidate> candidates{{"scalar table", hexEncodeScalar}};
+    if (hexEncoderSse2()) {
+        candidates.push_back({"SSE2", hexEncoderSse2()});
+    }
+    if (hexEncoderAvx2()) {
+        candidates.push_back({"AVX2", hexEncoderAvx2()});
+    }
+    candidates.push_back({"hexEncode", hexEncode});
+
+    // check every implementation against sprintf before timing anything
+    for (const auto& candidate : candidates) {
+        for (size_t size = 0; size < 200; ++size) {
+            std::string out(size * 2, '\0');
+            candidate.encode(input.data() + size, size, &out[0]);
+            if (out != sprintfHex(input.data() + size, static_cast<int>(size))) {
+                fprintf(stderr, "%s produced wrong output for %zu bytes\n", candidate.name, size);
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    printf("hexEncode dispatches to %s\n", hexEncoderName());
+    printf("%-14s %10s %10s %10s %10s\n", "ns/byte", "4 B", "32 B", "1024 B", "64 KiB");
+    const size_t sizes[] = {4, 32, 1024, 1 << 16};
+
+    printf("%-14s", "sprintf");
+    for (auto size : sizes) {
+        const long scaled = std::max(1L, iterations * 32 / static_cast<long>(size) / 4);
+        printf(" %10.3f", nsPerByte(input, size, scaled, [](const uint8_t* data, size_t size) {
+            return sprintfHex(data, static_cast<int>(size))[0];
+        }));
+    }
+    printf("\n");
+
+    for (const auto& candidate : candidates) {
+        printf("%-14s", candidate.name);
+        for (auto size : sizes) {
+            const long scaled = std::max(1L, iterations * 32 / static_cast<long>(size));
+            std::vector<char> out(size * 2);
+            printf(" %10.3f", nsPerByte(input, size, scaled, [&](const uint8_t* data, size_t size) {
+                return *(candidate.encode(data, size, out.data()) - 1);
+            }));
+        }
+        printf("\n");
+    }
+    return 0;
+}
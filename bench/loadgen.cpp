@@ -0,0 +1,228 @@
+// Sends parse requests to a running toxsaveparser --serve and measures how fast they are answered.
+// Usage: toxsave_loadgen --socket path [--connections N] [--depth N] [--requests N] [--format name] [--select paths]
+//                        profile.tox...
+// Every connection keeps --depth requests in flight, cycling through the profiles, until it has had --requests
+// answered. Prints the requests/s, the answered MiB/s and the 50th, 90th and 99th percentile and maximum latency.
+
+#include <errno.h>       // for errno, EINTR
+#include <stdio.h>       // for printf, fprintf
+#include <stdlib.h>      // for strtoul, EXIT_FAILURE, EXIT_SUCCESS
+#include <string.h>      // for strcmp, strncmp, strerror, memcpy
+#include <sys/socket.h>  // for socket, connect, AF_UNIX, SOCK_STREAM
+#include <sys/un.h>      // for sockaddr_un
+#include <unistd.h>      // for read, write, close
+#include <algorithm>     // for sort
+#include <chrono>        // for steady_clock, duration
+#include <cstdint>       // for uint64_t
+#include <deque>         // for deque
+#include <functional>    // for ref, cref
+#include <string>        // for string
+#include <thread>        // for thread
+#include <vector>        // for vector
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string socketPath;
+    size_t connections = 4;
+    size_t depth = 16;
+    size_t requests = 10000;
+    std::vector<std::string> lines; // one request per profile
+};
+
+struct ConnectionResult {
+    std::vector<double> latencies; // in seconds
+    uint64_t bytes = 0;
+    size_t errors = 0;
+    bool failed = false;
+};
+
+bool parseSize(const char* value, size_t& size)
+{
+    char* end = nullptr;
+    size = strtoul(value, &end, 10);
+    return *value && *value != '-' && !*end;
+}
+
+bool writeAll(int fd, const char* data, size_t length)
+{
+    while (length > 0) {
+        const auto written = write(fd, data, length);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+void runConnection(const Options& options, size_t first, ConnectionResult& result)
+{
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, options.socketPath.c_str(), options.socketPath.size() + 1);
+    if (fd == -1 || connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == -1) {
+        fprintf(stderr, "Couldn't connect to %s: %s\n", options.socketPath.c_str(), strerror(errno));
+        result.failed = true;
+        if (fd != -1) {
+            close(fd);
+        }
+        return;
+    }
+
+    result.latencies.reserve(options.requests);
+    std::deque<Clock::time_point> inFlight;
+    std::string outgoing;
+    std::string incoming;
+    char buffer[64 * 1024];
+    size_t sent = 0;
+    size_t next = first;
+    while (result.latencies.size() < options.requests) {
+        outgoing.clear();
+        while (sent < options.requests && inFlight.size() < options.depth) {
+            outgoing += options.lines[next++ % options.lines.size()];
+            inFlight.push_back(Clock::now());
+            ++sent;
+        }
+        if (!outgoing.empty() && !writeAll(fd, outgoing.data(), outgoing.size())) {
+            fprintf(stderr, "Sending requests failed: %s\n", strerror(errno));
+            result.failed = true;
+            break;
+        }
+
+        const ssize_t length = read(fd, buffer, sizeof(buffer));
+        if (length < 0 && errno == EINTR) {
+            continue;
+        }
+        if (length <= 0) {
+            fprintf(stderr, "The server closed the connection\n");
+            result.failed = true;
+            break;
+        }
+        incoming.append(buffer, length);
+
+        // "OK <length>\n" or "ERROR <length>\n" and that many bytes
+        size_t begin = 0;
+        while (true) {
+            const size_t newline = incoming.find('\n', begin);
+            if (newline == std::string::npos) {
+                break;
+            }
+            const size_t space = incoming.find(' ', begin);
+            const size_t size = strtoul(incoming.c_str() + space + 1, nullptr, 10);
+            if (incoming.size() - newline - 1 < size) {
+                break;
+            }
+            if (incoming.compare(begin, 3, "OK ") != 0) {
+                if (result.errors++ == 0) {
+                    fprintf(stderr, "%.*s\n", static_cast<int>(size), incoming.c_str() + newline + 1);
+                }
+            }
+            result.latencies.push_back(std::chrono::duration<double>(Clock::now() - inFlight.front()).count());
+            inFlight.pop_front();
+            result.bytes += size;
+            begin = newline + 1 + size;
+        }
+        incoming.erase(0, begin);
+    }
+    close(fd);
+}
+
+double percentile(const std::vector<double>& sorted, double fraction)
+{
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()))];
+}
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    std::string format;
+    std::string select;
+    std::vector<std::string> profiles;
+    for (int i = 1; i < argc; ++i) {
+        const char* option = argv[i];
+        if (strncmp(option, "--", 2)) {
+            profiles.emplace_back(option);
+            continue;
+        }
+        if (i + 1 == argc) {
+            fprintf(stderr, "Missing value for %s\n", option);
+            return EXIT_FAILURE;
+        }
+        const char* value = argv[++i];
+        size_t* target = nullptr;
+        if (!strcmp(option, "--socket")) {
+            options.socketPath = value;
+            continue;
+        } else if (!strcmp(option, "--format")) {
+            format = value;
+            continue;
+        } else if (!strcmp(option, "--select")) {
+            select = value;
+            continue;
+        } else if (!strcmp(option, "--connections")) {
+            target = &options.connections;
+        } else if (!strcmp(option, "--depth")) {
+            target = &options.depth;
+        } else if (!strcmp(option, "--requests")) {
+            target = &options.requests;
+        } else {
+            fprintf(stderr, "Unknown option %s\n", option);
+            return EXIT_FAILURE;
+        }
+        if (!parseSize(value, *target) || *target == 0) {
+            fprintf(stderr, "Invalid value for %s: %s\n", option, value);
+            return EXIT_FAILURE;
+        }
+    }
+    if (options.socketPath.empty() || options.socketPath.size() >= sizeof(sockaddr_un::sun_path)
+        || profiles.empty()) {
+        fprintf(stderr, "Usage: toxsave_loadgen --socket path [--connections N] [--depth N] [--requests N] "
+                        "[--format name] [--select paths] profile.tox...\n");
+        return EXIT_FAILURE;
+    }
+    for (const auto& profile : profiles) {
+        options.lines.push_back(profile + "\t" + format + "\t" + select + "\n");
+    }
+
+    std::vector<ConnectionResult> results(options.connections);
+    std::vector<std::thread> threads;
+    const auto start = Clock::now();
+    for (size_t i = 0; i < options.connections; ++i) {
+        // each connection starts at another profile, so they don't all ask for the same one at once
+        threads.emplace_back(runConnection, std::cref(options), i, std::ref(results[i]));
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::vector<double> latencies;
+    uint64_t bytes = 0;
+    size_t errors = 0;
+    bool failed = false;
+    for (const auto& result : results) {
+        latencies.insert(latencies.end(), result.latencies.begin(), result.latencies.end());
+        bytes += result.bytes;
+        errors += result.errors;
+        failed |= result.failed;
+    }
+    if (latencies.empty()) {
+        return EXIT_FAILURE;
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    printf("%zu requests (%zu errors) over %zu connections, %zu in flight each, in %.3f s\n", latencies.size(), errors,
+           options.connections, options.depth, seconds);
+    printf("%.0f requests/s, %.1f MiB/s\n", latencies.size() / seconds, bytes / seconds / (1024 * 1024));
+    printf("latency p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us\n", percentile(latencies, 0.5) * 1e6,
+           percentile(latencies, 0.9) * 1e6, percentile(latencies, 0.99) * 1e6, latencies.back() * 1e6);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
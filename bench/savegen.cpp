@@ -0,0 +1,203 @@
+#include "savegen.h"
+#include <algorithm>  // for min
+#include <random>     // for mt19937
+#include <string>     // for string, to_string
+#include <utility>    // for move
+
+namespace {
+class SaveBuilder {
+public:
+    explicit SaveBuilder(uint32_t seed) : random(seed) {}
+
+    void byte(uint8_t value) { bytes.push_back(value); }
+    void zeros(size_t count) { bytes.insert(bytes.end(), count, 0); }
+    void randomBytes(size_t count)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            bytes.push_back(static_cast<uint8_t>(random()));
+        }
+    }
+    void text(const std::string& value) { bytes.insert(bytes.end(), value.begin(), value.end()); }
+
+    void little(uint64_t value, size_t size)
+    {
+        for (size_t i = 0; i < size; ++i) {
+            bytes.push_back(static_cast<uint8_t>(value >> 8*i));
+        }
+    }
+    void big(uint64_t value, size_t size)
+    {
+        for (size_t i = size; i-- > 0;) {
+            bytes.push_back(static_cast<uint8_t>(value >> 8*i));
+        }
+    }
+
+    // Starts a section; its size is filled in by endSection().
+    void beginSection(uint16_t type)
+    {
+        sectionStart = bytes.size();
+        little(0, 4);
+        little(type, 2);
+        little(0x01ce, 2);
+    }
+    void endSection()
+    {
+        const uint64_t size = bytes.size() - sectionStart - 8;
+        for (size_t i = 0; i < 4; ++i) {
+            bytes[sectionStart + i] = static_cast<uint8_t>(size >> 8*i);
+        }
+    }
+
+    uint32_t next() { return random(); }
+
+    std::vector<uint8_t> bytes;
+
+private:
+    std::mt19937 random;
+    size_t sectionStart = 0;
+};
+
+const char* const sampleWords[] = {"hello", "Tox", "\"quoted\"", "back\\slash", "tab\there", "Grüße", "日本語", "🙂"};
+
+std::string sampleText(SaveBuilder& save, size_t index, size_t maxLength)
+{
+    std::string text = std::to_string(index);
+    const size_t words = 1 + save.next() % 6;
+    for (size_t i = 0; i < words; ++i) {
+        text += ' ';
+        text += sampleWords[save.next() % (sizeof(sampleWords) / sizeof(sampleWords[0]))];
+    }
+    // cutting can split a UTF-8 sequence, which the decoders have to cope with anyway
+    return text.substr(0, std::min(text.size(), maxLength));
+}
+
+void node(SaveBuilder& save, size_t index, bool tcp)
+{
+    const bool ipv6 = index % 4 == 3;
+    save.byte((ipv6 ? 10 : 2) | (tcp ? 0x80 : 0));
+    save.randomBytes(ipv6 ? 16 : 4);
+    save.big(index % 2 ? 33445 : 443, 2);
+    save.randomBytes(32);
+}
+
+// Fixed-size text field followed by its big-endian length.
+void friendField(SaveBuilder& save, const std::string& value, size_t fieldSize)
+{
+    save.text(value);
+    save.zeros(fieldSize - value.size());
+}
+
+void friendRecord(SaveBuilder& save, size_t index)
+{
+    save.byte(index % 5);
+    save.randomBytes(32);
+
+    const auto request = sampleText(save, index, 1024);
+    friendField(save, request, 1024);
+    save.zeros(1);
+    save.big(request.size(), 2);
+
+    const auto name = sampleText(save, index, 128);
+    friendField(save, name, 128);
+    save.big(name.size(), 2);
+
+    const auto statusMessage = sampleText(save, index, 1007);
+    friendField(save, statusMessage, 1007);
+    save.zeros(1);
+    save.big(statusMessage.size(), 2);
+
+    save.byte(index % 3);
+    save.zeros(3);
+    save.randomBytes(4);
+    save.big(1500000000 + index * 60, 8);
+}
+
+void conference(SaveBuilder& save, size_t index, size_t peers)
+{
+    save.byte(index % 2);
+    save.randomBytes(32);
+    save.little(index * 7, 4);
+    save.little(index, 2);
+    save.little(0, 2);
+    save.little(peers, 4);
+    const auto title = sampleText(save, index, 255);
+    save.byte(static_cast<uint8_t>(title.size()));
+    save.text(title);
+
+    for (size_t i = 0; i < peers; ++i) {
+        save.randomBytes(64);
+        save.little(i, 2);
+        save.little(1500000000 + i, 8);
+        const auto nick = sampleText(save, i, 128);
+        save.byte(static_cast<uint8_t>(nick.size()));
+        save.text(nick);
+    }
+}
+}
+
+std::vector<uint8_t> generateSave(const SaveShape& shape, uint32_t seed)
+{
+    SaveBuilder save(seed);
+    save.little(0, 4);
+    save.little(0x15ed1b1f, 4);
+
+    save.beginSection(1);
+    save.randomBytes(4 + 32 + 32);
+    save.endSection();
+
+    // the DHT state cookie, then one inner section holding the nodes
+    save.beginSection(2);
+    save.little(0x0159000d, 4);
+    const size_t innerStart = save.bytes.size();
+    save.little(0, 4);
+    save.little(4, 2);
+    save.little(0x11ce, 2);
+    for (size_t i = 0; i < shape.dhtNodes; ++i) {
+        node(save, i, false);
+    }
+    const uint64_t innerSize = save.bytes.size() - innerStart - 8;
+    for (size_t i = 0; i < 4; ++i) {
+        save.bytes[innerStart + i] = static_cast<uint8_t>(innerSize >> 8*i);
+    }
+    save.endSection();
+
+    save.beginSection(3);
+    for (size_t i = 0; i < shape.friends; ++i) {
+        friendRecord(save, i);
+    }
+    save.endSection();
+
+    save.beginSection(4);
+    save.text("Bench Profile");
+    save.endSection();
+
+    save.beginSection(5);
+    save.text("Generated by toxsave_bench");
+    save.endSection();
+
+    save.beginSection(6);
+    save.byte(0);
+    save.endSection();
+
+    save.beginSection(10);
+    for (size_t i = 0; i < shape.tcpRelays; ++i) {
+        node(save, i, true);
+    }
+    save.endSection();
+
+    save.beginSection(11);
+    for (size_t i = 0; i < shape.pathNodes; ++i) {
+        node(save, i, i % 2);
+    }
+    save.endSection();
+
+    save.beginSection(20);
+    for (size_t i = 0; i < shape.conferences; ++i) {
+        conference(save, i, shape.peersPerConference);
+    }
+    save.endSection();
+
+    save.beginSection(255);
+    save.endSection();
+    return std::move(save.bytes);
+}
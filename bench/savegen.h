@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>  // for size_t
+#include <cstdint>  // for uint8_t, uint32_t
+#include <vector>   // for vector
+
+// How many records of each kind a generated save holds. The nospam/keys, name, status message and status sections are
+// always present.
+struct SaveShape {
+    size_t friends = 0;
+    size_t dhtNodes = 0;
+    size_t tcpRelays = 0;
+    size_t pathNodes = 0;
+    size_t conferences = 0;
+    size_t peersPerConference = 0;
+};
+
+// Builds a valid, unencrypted save with random keys and addresses. Names and messages mix plain ASCII with characters
+// that need escaping and multi-byte UTF-8, like real profiles do. The same seed always gives the same bytes.
+std::vector<uint8_t> generateSave(const SaveShape& shape, uint32_t seed = 1);
@@ -0,0 +1,133 @@
+#include "cborwriter.h"
+#include <string.h>        // for strlen
+#include <utility>         // for move
+#include "outputbuffer.h"  // for OutputBuffer
+#include "utils.h"         // for toValidUtf8
+
+namespace {
+const uint8_t unsignedInteger = 0;
+const uint8_t negativeInteger = 1;
+const uint8_t byteString = 2;
+const uint8_t textString = 3;
+const uint8_t tag = 6;
+
+const char beginIndefiniteMap = '\xbf';
+const char beginIndefiniteArray = '\x9f';
+const char breakCode = '\xff';
+const uint64_t epochTimeTag = 1;
+}
+
+CborWriter::CborWriter(OutputBuffer& out)
+    : out(out)
+{
+}
+
+CborWriter::~CborWriter() = default;
+
+CborWriter::CborWriter(std::unique_ptr<OutputBuffer> buffer)
+    : ownBuffer(std::move(buffer))
+    , out(*ownBuffer)
+{
+}
+
+std::unique_ptr<Writer> CborWriter::fork(size_t) const
+{
+    return std::unique_ptr<Writer>(new CborWriter(std::make_unique<OutputBuffer>(-1, 64 * 1024)));
+}
+
+// Indefinite length arrays have no count to update, the elements are just appended.
+void CborWriter::splice(Writer& fork)
+{
+    const auto& forked = static_cast<CborWriter&>(fork);
+    out.append(forked.out.data(), forked.out.size());
+}
+
+void CborWriter::beginObject()
+{
+    out.append(beginIndefiniteMap);
+}
+
+void CborWriter::endObject()
+{
+    out.append(breakCode);
+}
+
+void CborWriter::beginArray()
+{
+    out.append(beginIndefiniteArray);
+}
+
+void CborWriter::endArray()
+{
+    out.append(breakCode);
+}
+
+void CborWriter::key(const char* name)
+{
+    text(name, strlen(name));
+}
+
+void CborWriter::string(const char* data, size_t length)
+{
+    text(data, length);
+}
+
+void CborWriter::number(int64_t value)
+{
+    if (value >= 0) {
+        head(unsignedInteger, static_cast<uint64_t>(value));
+    } else {
+        head(negativeInteger, static_cast<uint64_t>(-1 - value));
+    }
+}
+
+void CborWriter::hex(const uint8_t* data, size_t length)
+{
+    head(byteString, length);
+    out.append(reinterpret_cast<const char*>(data), length);
+}
+
+void CborWriter::timestamp(uint64_t secondsSinceEpoch)
+{
+    head(tag, epochTimeTag);
+    head(unsignedInteger, secondsSinceEpoch);
+}
+
+// Initial byte plus the shortest big-endian argument that holds value.
+void CborWriter::head(uint8_t majorType, uint64_t value)
+{
+    char* const start = out.reserve(9);
+    char* pos = start;
+    const uint8_t major = majorType << 5;
+    size_t argumentSize;
+    if (value < 24) {
+        *pos++ = static_cast<char>(major | value);
+        argumentSize = 0;
+    } else if (value <= 0xff) {
+        *pos++ = static_cast<char>(major | 24);
+        argumentSize = 1;
+    } else if (value <= 0xffff) {
+        *pos++ = static_cast<char>(major | 25);
+        argumentSize = 2;
+    } else if (value <= 0xffffffff) {
+        *pos++ = static_cast<char>(major | 26);
+        argumentSize = 4;
+    } else {
+        *pos++ = static_cast<char>(major | 27);
+        argumentSize = 8;
+    }
+    for (size_t i = argumentSize; i-- > 0;) {
+        *pos++ = static_cast<char>(value >> 8*i);
+    }
+    out.commit(pos - start);
+}
+
+void CborWriter::text(const char* data, size_t length)
+{
+    if (!toValidUtf8(data, length, fixedText)) {
+        data = fixedText.data();
+        length = fixedText.size();
+    }
+    head(textString, length);
+    out.append(data, length);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>  // for size_t
+#include <cstdint>  // for int64_t, uint8_t, uint64_t
+#include <memory>   // for unique_ptr
+#include <string>   // for string
+#include "writer.h"
+
+class OutputBuffer;
+
+// Writes CBOR (RFC 8949) straight into an OutputBuffer. Objects and arrays are indefinite length, so nothing has to be
+// counted or buffered. Keys and ids are byte strings of the raw bytes, timestamps are integers tagged as epoch times
+// (tag 1), and text is UTF-8 with invalid bytes replaced like in the JSON output. Documents follow each other with
+// nothing in between (a CBOR sequence, RFC 8742).
+class CborWriter : public Writer {
+public:
+    explicit CborWriter(OutputBuffer& out);
+    ~CborWriter() override;
+
+    void beginObject() override;
+    void endObject() override;
+    void beginArray() override;
+    void endArray() override;
+    void key(const char* name) override;
+    void string(const char* data, size_t length) override;
+    void number(int64_t value) override;
+    void hex(const uint8_t* data, size_t length) override;
+    void timestamp(uint64_t secondsSinceEpoch) override;
+    using Writer::string;
+    std::unique_ptr<Writer> fork(size_t nested = 0) const override;
+    void splice(Writer& fork) override;
+
+private:
+    // A fork writes into a buffer of its own.
+    explicit CborWriter(std::unique_ptr<OutputBuffer> buffer);
+
+    void head(uint8_t majorType, uint64_t value);
+    void text(const char* data, size_t length);
+
+    std::unique_ptr<OutputBuffer> ownBuffer; // only set in forks, out refers to it
+    OutputBuffer& out;
+    std::string fixedText;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <errno.h>          // for errno
+#include <fcntl.h>          // for open, O_CREAT, O_TRUNC, O_WRONLY, O_CLOEXEC
+#include <string.h>         // for strerror
+#include <unistd.h>         // for close
+#include <cstddef>          // for size_t
+#include <cstdint>          // for uint8_t
+#include <stdexcept>        // for runtime_error
+#include <string>           // for string
+#include "outputbuffer.h"   // for OutputBuffer
+#include "utils.h"          // for storeNumber, Endianness
+
+// One output file of fixed-size little-endian values, written through its own buffer.
+class ColumnFile {
+public:
+    ColumnFile(const std::string& directory, const char* name)
+        : path(directory + "/" + name)
+        , fd(open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644))
+        , out(fd)
+    {
+        if (fd < 0) {
+            throw std::runtime_error("Couldn't create " + path + ": " + strerror(errno));
+        }
+    }
+    ~ColumnFile()
+    {
+        out.clear();
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    ColumnFile(const ColumnFile&) = delete;
+    ColumnFile& operator=(const ColumnFile&) = delete;
+
+    void append(const void* data, size_t length) { out.append(static_cast<const char*>(data), length); }
+    template <typename T>
+    void appendNumber(T value)
+    {
+        uint8_t bytes[sizeof(T)];
+        storeNumber<Endianness::little>(bytes, value);
+        append(bytes, sizeof(bytes));
+    }
+
+    // Writes out what's buffered and closes the file. Throws std::runtime_error on failure.
+    void finish()
+    {
+        out.flush();
+        const int result = close(fd);
+        fd = -1;
+        if (result != 0) {
+            throw std::runtime_error("Couldn't write " + path + ": " + strerror(errno));
+        }
+    }
+
+private:
+    std::string path;
+    int fd;
+    OutputBuffer out;
+};
@@ -0,0 +1,186 @@
+#include "commandline.h"
+#include <stdlib.h>  // for exit, EXIT_FAILURE
+#include <iostream>  // for cout, cerr, endl, ostream
+#include <utility>   // for move
+
+namespace {
+// same column and wrapping as QCommandLineParser's help
+const size_t descriptionColumn = 29;
+const size_t lineWidth = 79;
+
+void writeEntry(std::ostream& out, const std::string& names, const std::string& description)
+{
+    std::string line = "  " + names;
+    if (line.size() + 1 > descriptionColumn) {
+        out << line << "\n";
+        line.clear();
+    }
+    line.resize(descriptionColumn, ' ');
+
+    // word wrapped into the description column
+    size_t pos = 0;
+    while (pos < description.size()) {
+        size_t end = description.size();
+        if (end - pos > lineWidth - descriptionColumn) {
+            end = description.rfind(' ', pos + lineWidth - descriptionColumn);
+            if (end == std::string::npos || end <= pos) {
+                end = pos + lineWidth - descriptionColumn;
+            }
+        }
+        out << line << description.substr(pos, end - pos) << "\n";
+        line.assign(descriptionColumn, ' ');
+        pos = end;
+        while (pos < description.size() && description[pos] == ' ') {
+            ++pos;
+        }
+    }
+}
+}
+
+CommandLineOption::CommandLineOption(std::string name, std::string description, std::string valueName,
+                                     std::string defaultValue)
+    : name(std::move(name))
+    , description(std::move(description))
+    , valueName(std::move(valueName))
+    , defaultValue(std::move(defaultValue))
+{
+}
+
+void CommandLineParser::setApplicationDescription(const std::string& description)
+{
+    this->description = description;
+}
+
+void CommandLineParser::addHelpOption()
+{
+    helpOption = true;
+}
+
+void CommandLineParser::addPositionalArgument(const std::string& name, const std::string& description,
+                                              const std::string& syntax)
+{
+    positionalDefinitions.push_back({name, description, syntax.empty() ? name : syntax});
+}
+
+void CommandLineParser::addOption(const CommandLineOption& option)
+{
+    options.push_back(option);
+}
+
+void CommandLineParser::process(int argc, char** argv)
+{
+    program = argc > 0 ? argv[0] : "";
+    bool optionsEnded = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string argument = argv[i];
+        if (optionsEnded || argument == "-" || argument.empty() || argument[0] != '-') {
+            positional.push_back(argument);
+            continue;
+        }
+        if (argument == "--") {
+            optionsEnded = true;
+            continue;
+        }
+        if (helpOption && (argument == "-h" || argument == "--help" || argument == "-?")) {
+            showHelp();
+        }
+        if (argument.compare(0, 2, "--") != 0) {
+            // short options can't take values or be compacted here, none are defined
+            fail("Unknown option '" + argument.substr(1) + "'.");
+        }
+
+        const size_t equals = argument.find('=');
+        const std::string name = argument.substr(2, equals == std::string::npos ? std::string::npos : equals - 2);
+        const CommandLineOption* option = find(name);
+        if (!option) {
+            fail("Unknown option '" + name + "'.");
+        }
+        if (option->valueName.empty()) {
+            if (equals != std::string::npos) {
+                fail("Unexpected value after '--" + name + "'.");
+            }
+            given.push_back({name, {}});
+        } else if (equals != std::string::npos) {
+            given.push_back({name, argument.substr(equals + 1)});
+        } else if (i + 1 < argc) {
+            given.push_back({name, argv[++i]});
+        } else {
+            fail("Missing value after '--" + name + "'.");
+        }
+    }
+}
+
+bool CommandLineParser::isSet(const CommandLineOption& option) const
+{
+    for (const auto& value : given) {
+        if (value.name == option.name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string CommandLineParser::value(const CommandLineOption& option) const
+{
+    const auto all = values(option);
+    return all.empty() ? option.defaultValue : all.back();
+}
+
+std::vector<std::string> CommandLineParser::values(const CommandLineOption& option) const
+{
+    std::vector<std::string> result;
+    for (const auto& value : given) {
+        if (value.name == option.name) {
+            result.push_back(value.value);
+        }
+    }
+    return result;
+}
+
+void CommandLineParser::showHelp(int exitCode) const
+{
+    auto& out = std::cout;
+    out << "Usage: " << program;
+    if (!options.empty() || helpOption) {
+        out << " [options]";
+    }
+    for (const auto& argument : positionalDefinitions) {
+        out << " " << argument.syntax;
+    }
+    out << "\n";
+    if (!description.empty()) {
+        out << description << "\n";
+    }
+    out << "\nOptions:\n";
+    if (helpOption) {
+        writeEntry(out, "-?, -h, --help", "Displays help on commandline options.");
+    }
+    for (const auto& option : options) {
+        writeEntry(out, "--" + option.name + (option.valueName.empty() ? "" : " <" + option.valueName + ">"),
+                   option.description);
+    }
+    if (!positionalDefinitions.empty()) {
+        out << "\nArguments:\n";
+        for (const auto& argument : positionalDefinitions) {
+            writeEntry(out, argument.name, argument.description);
+        }
+    }
+    out.flush();
+    exit(exitCode);
+}
+
+const CommandLineOption* CommandLineParser::find(const std::string& name) const
+{
+    for (const auto& option : options) {
+        if (option.name == name) {
+            return &option;
+        }
+    }
+    return nullptr;
+}
+
+void CommandLineParser::fail(const std::string& message) const
+{
+    std::cerr << message << std::endl;
+    exit(EXIT_FAILURE);
+}
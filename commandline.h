@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>  // for string
+#include <vector>  // for vector
+
+struct CommandLineOption {
+    CommandLineOption(std::string name, std::string description, std::string valueName = {},
+                      std::string defaultValue = {});
+
+    std::string name;
+    std::string description;
+    // empty for a flag
+    std::string valueName;
+    std::string defaultValue;
+};
+
+// The subset of QCommandLineParser the command line tool uses, with the same syntax, messages and help layout:
+// "--name value" or "--name=value" for options taking a value, "-h"/"--help", "--" ending the options, and "-" on
+// its own as a positional argument.
+class CommandLineParser {
+public:
+    void setApplicationDescription(const std::string& description);
+    void addHelpOption();
+    void addPositionalArgument(const std::string& name, const std::string& description, const std::string& syntax);
+    void addOption(const CommandLineOption& option);
+
+    // Parses the arguments, printing the help and exiting for --help and printing an error and exiting for anything
+    // it doesn't know.
+    void process(int argc, char** argv);
+
+    bool isSet(const CommandLineOption& option) const;
+    // The last value given for option, or its default.
+    std::string value(const CommandLineOption& option) const;
+    // Every value given for option, in order.
+    std::vector<std::string> values(const CommandLineOption& option) const;
+    const std::vector<std::string>& positionalArguments() const { return positional; }
+
+    [[noreturn]] void showHelp(int exitCode = 0) const;
+
+private:
+    struct Positional {
+        std::string name;
+        std::string description;
+        std::string syntax;
+    };
+    struct Value {
+        std::string name;
+        std::string value;
+    };
+
+    const CommandLineOption* find(const std::string& name) const;
+    [[noreturn]] void fail(const std::string& message) const;
+
+    std::string program;
+    std::string description;
+    bool helpOption = false;
+    std::vector<CommandLineOption> options;
+    std::vector<Positional> positionalDefinitions;
+    // flags with an empty value
+    std::vector<Value> given;
+    std::vector<std::string> positional;
+};
@@ -0,0 +1,17 @@
+#include "conferenceindex.h"
+
+ConferenceIndex::ConferenceIndex(Cursor data)
+    : section(data.data())
+    , sectionSize(static_cast<uint32_t>(data.remaining()))
+{
+    // bounded by the section size rather than the peer counts, which aren't checked yet
+    peerOffsets.reserve(data.remaining() / peerFixedSize);
+    walk(
+        data,
+        [this](uint32_t offset) {
+            conferenceOffsets.push_back(offset);
+            firstPeer.push_back(static_cast<uint32_t>(peerOffsets.size()));
+        },
+        [this](uint32_t offset) { peerOffsets.push_back(offset); });
+    firstPeer.push_back(static_cast<uint32_t>(peerOffsets.size()));
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>  // for size_t
+#include <cstdint>  // for uint8_t, uint32_t
+#include <vector>   // for vector
+#include "cursor.h"  // for Cursor
+#include "utils.h"   // for loadNumber, Endianness
+
+// Where every conference and conference peer record of a Conferences section starts. Both have variable size (title
+// and name lengths, peer count), so finding record n normally means walking the ones before it; the index is built in
+// one pass that only reads those length fields and checks each record's bounds, and then gives constant time access
+// to any conference or peer. The records themselves can then be decoded in any order or on several threads.
+class ConferenceIndex {
+public:
+    // type, id, message number, lossy message number, peer number, peer count, title length
+    static constexpr size_t conferenceFixedSize = 1 + 32 + 4 + 2 + 2 + 4 + 1;
+    // keys, peer number, timestamp, name length
+    static constexpr size_t peerFixedSize = 32 + 32 + 2 + 8 + 1;
+
+    // Indexes a Conferences section payload, which has to be consumed exactly. Throws std::runtime_error if a record
+    // runs past its end.
+    explicit ConferenceIndex(Cursor section);
+
+    // The pass the index is built with, for checking a section without keeping the index: calls onConference with the
+    // offset of every conference record and onPeer with that of each of its peers, after checking their bounds.
+    template<typename OnConference, typename OnPeer>
+    static void walk(Cursor section, OnConference onConference, OnPeer onPeer);
+
+    size_t size() const { return conferenceOffsets.size(); }
+    const uint8_t* conference(size_t index) const { return section + conferenceOffsets[index]; }
+    // The whole record, its peers included.
+    size_t conferenceSize(size_t index) const
+    {
+        return (index + 1 < size() ? conferenceOffsets[index + 1] : sectionSize) - conferenceOffsets[index];
+    }
+
+    // Peers actually stored, 0 for a conference whose peer count is negative.
+    size_t peerCount(size_t conference) const { return firstPeer[conference + 1] - firstPeer[conference]; }
+    const uint8_t* peer(size_t conference, size_t index) const
+    {
+        return section + peerOffsets[firstPeer[conference] + index];
+    }
+    size_t totalPeers() const { return peerOffsets.size(); }
+
+private:
+    const uint8_t* section;
+    uint32_t sectionSize;
+    std::vector<uint32_t> conferenceOffsets;
+    std::vector<uint32_t> firstPeer; // into peerOffsets, one per conference plus the end
+    std::vector<uint32_t> peerOffsets;
+};
+
+template<typename OnConference, typename OnPeer>
+void ConferenceIndex::walk(Cursor data, OnConference onConference, OnPeer onPeer)
+{
+    const uint8_t* const start = data.data();
+    while (!data.atEnd()) {
+        onConference(static_cast<uint32_t>(data.data() - start));
+        data.require(conferenceFixedSize, "conference");
+        const size_t titleLength = data.data()[conferenceFixedSize - 1];
+        const auto peerCount = loadNumber<Endianness::little, int32_t>(data.data() + conferenceFixedSize - 5);
+        data.require(conferenceFixedSize + titleLength, "conference title");
+        data.advance(conferenceFixedSize + titleLength);
+
+        // a bogus count fails at the first missing peer
+        for (int32_t i = 0; i < peerCount; ++i) {
+            onPeer(static_cast<uint32_t>(data.data() - start));
+            data.require(peerFixedSize, "conference peer");
+            const size_t nameLength = data.data()[peerFixedSize - 1];
+            data.require(peerFixedSize + nameLength, "conference peer name");
+            data.advance(peerFixedSize + nameLength);
+        }
+    }
+}
@@ -0,0 +1,9 @@
+#include "cursor.h"
+#include <stdexcept>  // for runtime_error
+#include <string>     // for string, to_string
+
+void Cursor::fail(size_t size, const char* what) const
+{
+    throw std::runtime_error(std::string("Truncated ") + what + ": needs " + std::to_string(size)
+                             + " bytes, " + std::to_string(remaining()) + " left.");
+}
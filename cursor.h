@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>  // for size_t
+#include <cstdint>  // for uint8_t
+#include "utils.h"  // for dataToNumber, Endianness
+
+// Read position in a save that knows where its buffer ends. Decoders check bounds once per record with require() or
+// take(), then decode the record with the unchecked accessors, so malformed input fails with an exception instead of
+// reading past the mapping, without paying for a check on every byte.
+class Cursor {
+public:
+    Cursor() = default;
+    Cursor(const uint8_t* begin, const uint8_t* end) : pos(begin), end(end) {}
+    Cursor(const uint8_t* begin, size_t size) : pos(begin), end(begin + size) {}
+
+    const uint8_t* data() const { return pos; }
+    size_t remaining() const { return end - pos; }
+    bool atEnd() const { return pos == end; }
+
+    // Throws std::runtime_error naming what if fewer than size bytes are left.
+    void require(size_t size, const char* what) const
+    {
+        if (remaining() < size) {
+            fail(size, what);
+        }
+    }
+
+    // The next size bytes as their own cursor, checked.
+    Cursor take(size_t size, const char* what)
+    {
+        require(size, what);
+        Cursor sub(pos, pos + size);
+        pos += size;
+        return sub;
+    }
+
+    // Unchecked, only for bytes a previous require() covered.
+    uint8_t peek() const { return *pos; }
+    const uint8_t* advance(size_t size)
+    {
+        const uint8_t* start = pos;
+        pos += size;
+        return start;
+    }
+    template <typename T>
+    T read() { return dataToNumber<Endianness::little, T>(pos); }
+    template <Endianness E, typename T>
+    T read() { return dataToNumber<E, T>(pos); }
+
+private:
+    [[noreturn]] void fail(size_t size, const char* what) const;
+
+    const uint8_t* pos = nullptr;
+    const uint8_t* end = nullptr;
+};
@@ -0,0 +1,631 @@
+#include "decoders.h"
+#include <string.h>              // for strcmp
+#include <algorithm>             // for count, min, sort
+#include <cstdint>               // for uint8_t, uint16_t, uint32_t, uint64_t
+#include <exception>             // for exception_ptr, current_exception, rethrow_exception
+#include <memory>                // for unique_ptr
+#include <stdexcept>             // for runtime_error, invalid_argument
+#include <string>                // for string
+#include <utility>               // for move
+#include <vector>                // for vector
+#include "conferenceindex.h"     // for ConferenceIndex
+#include "cursor.h"              // for Cursor
+#include "document.h"            // for Arena, DocumentNode, DocumentWriter, writeDocument
+#include "executionplan.h"       // for minimumRecordsPerTask, planSections
+#include "friendrecord.h"        // for FriendRecordLayout
+#include "nodeinfo.h"            // for getNodeInfos
+#include "sections.h"            // for SectionHeader, SectionType, sectionT...
+#include "selection.h"           // for Selection, SelectionWriter
+#include "stats.h"               // for StageTimer, SectionTimer, PoolTaskTimer, countRecords, curren...
+#include "threadpool.h"          // for ThreadPool, blockingMap
+#include "utils.h"               // for userStatusToString, FriendStatusToSt...
+
+void addDataToArray(Cursor& data, int size, Writer& out)
+{
+    data.require(size, "hex data");
+    writeHex(data, size, out);
+}
+
+void getNoSpamKeys(Cursor& data, Writer& out)
+{
+    data.require(4 + 32 + 32, "nospam and keys");
+    out.beginObject();
+    out.key("Nospam");
+    writeHex(data, 4, out);
+    out.key("Long term public key");
+    writeHex(data, 32, out);
+    out.key("Long term secret key");
+    writeHex(data, 32, out);
+    out.endObject();
+}
+
+uint32_t readDhtHeader(Cursor& data)
+{
+    data.require(4, "DHT state cookie");
+    if (data.read<uint32_t>() != dhtStateCookie) {
+        throw std::invalid_argument("Invalid DHT section header");
+    }
+    data.require(8, "DHT section header");
+    const auto nodesSize = data.read<uint32_t>();
+    const auto type = data.read<uint16_t>();
+    if (data.read<uint16_t>() != dhtInnerSectionMagic) {
+        throw std::runtime_error("Couldn't parse DHT state cookie.");
+    }
+    if (type != dhtNodesSectionType) {
+        throw std::runtime_error("Unknown DHT section");
+    }
+    return nodesSize;
+}
+
+Cursor getDhtNodes(Cursor& data)
+{
+    const auto nodesSize = readDhtHeader(data);
+    return data.take(nodesSize, "DHT section");
+}
+
+void getDht(Cursor& data, Writer& out)
+{
+    Cursor nodes = getDhtNodes(data);
+    getNodeInfos(nodes, out);
+}
+
+void writeConferencePeer(const uint8_t* record, Writer& out)
+{
+    const int nickLen = record[ConferenceIndex::peerFixedSize - 1];
+
+    out.beginObject();
+    out.key("Long term public key");
+    out.hex(record, 32);
+    out.key("DHT public key");
+    out.hex(record + 32, 32);
+    out.key("Peer number");
+    out.number(loadNumber<Endianness::little, uint16_t>(record + 64));
+
+    out.key("Last active timestamp");
+    out.timestamp(loadNumber<Endianness::little, uint64_t>(record + 66));
+
+    out.key("Name length");
+    out.number(nickLen);
+
+    out.key("Name");
+    writeString(record + ConferenceIndex::peerFixedSize, nickLen, out);
+    out.endObject();
+}
+
+void beginConference(const uint8_t* record, Writer& out)
+{
+    const int titleLen = record[ConferenceIndex::conferenceFixedSize - 1];
+
+    out.beginObject();
+    out.key("Groupchat type");
+    out.number(record[0]);
+    out.key("Groupchat id");
+    out.hex(record + 1, 32);
+    out.key("Message number");
+    out.number(loadNumber<Endianness::little, int32_t>(record + 33));
+    out.key("Lossy message number");
+    out.number(loadNumber<Endianness::little, uint16_t>(record + 37));
+    out.key("Peer number");
+    out.number(loadNumber<Endianness::little, uint16_t>(record + 39));
+
+    out.key("Number of peers");
+    out.number(loadNumber<Endianness::little, int32_t>(record + 41));
+
+    out.key("Title length");
+    out.number(titleLen);
+
+    out.key("Title");
+    writeString(record + ConferenceIndex::conferenceFixedSize, titleLen, out);
+
+    out.key("List of peers");
+    out.beginArray();
+}
+
+void endConference(Writer& out)
+{
+    out.endArray();
+    out.endObject();
+}
+
+namespace {
+void writeConferencePeers(const ConferenceIndex& index, size_t conference, size_t first, size_t count, Writer& out)
+{
+    for (size_t i = first; i < first + count; ++i) {
+        writeConferencePeer(index.peer(conference, i), out);
+    }
+}
+
+// Either a run of whole conferences, or a range of the peers of one large conference.
+struct ConferenceTask {
+    size_t conference;
+    size_t conferenceCount; // 0 for a peer range
+    size_t firstPeer;
+    size_t peerCount;
+    std::unique_ptr<Writer> writer;
+    std::exception_ptr error;
+};
+
+// Splits the indexed conferences into tasks of at least as many peers as the planner finds worth a task, decoded on
+// the global thread pool into forks of out and spliced back in order. Small conferences are grouped into runs decoded
+// as a whole, large ones have their peers split into ranges while their other fields are written here. Returns false
+// without writing anything if out can't be forked (or not for a nested array, when a conference is split) or it isn't
+// worth it. sectionSize is the size of the whole section, for the planner's estimate.
+bool writeConferencesInParallel(const ConferenceIndex& index, size_t sectionSize, Writer& out)
+{
+    if (index.totalPeers() == 0) {
+        return false;
+    }
+    const size_t minConferencePeersPerTask
+        = minimumRecordsPerTask(SectionType::conferences, sectionSize / index.totalPeers());
+    if (minConferencePeersPerTask == 0 || index.totalPeers() < 2 * minConferencePeersPerTask) {
+        return false;
+    }
+    const size_t maxTasks = static_cast<size_t>(ThreadPool::global().maxThreadCount()) * 4;
+    if (!out.fork()) {
+        return false;
+    }
+
+    std::vector<ConferenceTask> tasks;
+    size_t runStart = 0;
+    size_t runWeight = 0;
+    auto endRun = [&](size_t end) {
+        if (end > runStart) {
+            tasks.push_back({runStart, end - runStart, 0, 0, out.fork(), nullptr});
+        }
+        runStart = end;
+        runWeight = 0;
+    };
+    for (size_t i = 0; i < index.size(); ++i) {
+        const size_t peers = index.peerCount(i);
+        if (peers < 2 * minConferencePeersPerTask) {
+            // the conference's own fields count as a peer
+            runWeight += peers + 1;
+            if (runWeight >= minConferencePeersPerTask) {
+                endRun(i + 1);
+            }
+            continue;
+        }
+
+        endRun(i);
+        runStart = i + 1;
+        const size_t ranges = std::min(peers / minConferencePeersPerTask, maxTasks);
+        size_t first = 0;
+        for (size_t range = 0; range < ranges; ++range) {
+            const size_t count = peers / ranges + (range < peers % ranges ? 1 : 0);
+            // spliced into the conference's peer array, two levels below the array of conferences
+            tasks.push_back({i, 0, first, count, out.fork(2), nullptr});
+            first += count;
+        }
+    }
+    endRun(index.size());
+    for (const auto& task : tasks) {
+        // a writer may only be able to fork the array that's open in it
+        if (!task.writer) {
+            return false;
+        }
+    }
+
+    const auto stats = currentStatsContext();
+    blockingMap(tasks, [&index, &stats](ConferenceTask& task) {
+        PoolTaskTimer timer(stats);
+        try {
+            if (task.conferenceCount == 0) {
+                writeConferencePeers(index, task.conference, task.firstPeer, task.peerCount, *task.writer);
+                return;
+            }
+            for (size_t i = task.conference; i < task.conference + task.conferenceCount; ++i) {
+                beginConference(index.conference(i), *task.writer);
+                writeConferencePeers(index, i, 0, index.peerCount(i), *task.writer);
+                endConference(*task.writer);
+            }
+        }
+        catch (...) {
+            task.error = std::current_exception();
+        }
+    });
+
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        const auto& task = tasks[i];
+        if (task.error) {
+            std::rethrow_exception(task.error);
+        }
+        if (task.conferenceCount > 0) {
+            out.splice(*task.writer);
+            continue;
+        }
+        if (task.firstPeer == 0) {
+            beginConference(index.conference(task.conference), out);
+        }
+        out.splice(*task.writer);
+        if (task.firstPeer + task.peerCount == index.peerCount(task.conference)) {
+            endConference(out);
+        }
+    }
+    return true;
+}
+}
+
+void getConferencePeer(Cursor& data, Writer& out)
+{
+    data.require(ConferenceIndex::peerFixedSize, "conference peer");
+    const size_t nickLen = data.data()[ConferenceIndex::peerFixedSize - 1];
+    data.require(ConferenceIndex::peerFixedSize + nickLen, "conference peer name");
+    writeConferencePeer(data.advance(ConferenceIndex::peerFixedSize + nickLen), out);
+}
+
+void getConference(Cursor& data, Writer& out)
+{
+    data.require(ConferenceIndex::conferenceFixedSize, "conference");
+    const size_t titleLen = data.data()[ConferenceIndex::conferenceFixedSize - 1];
+    data.require(ConferenceIndex::conferenceFixedSize + titleLen, "conference title");
+
+    const uint8_t* const record = data.advance(ConferenceIndex::conferenceFixedSize + titleLen);
+    beginConference(record, out);
+    const auto numPeers = loadNumber<Endianness::little, int32_t>(record + 41);
+    for (int i = 0; i < numPeers; ++i) {
+        getConferencePeer(data, out);
+    }
+    endConference(out);
+}
+
+void writeConference(const ConferenceIndex& index, size_t conference, Writer& out)
+{
+    beginConference(index.conference(conference), out);
+    writeConferencePeers(index, conference, 0, index.peerCount(conference), out);
+    endConference(out);
+}
+
+std::string getStatus(Cursor& data)
+{
+    data.require(1, "status");
+    auto status = static_cast<UserStatus>(data.peek());
+    data.advance(1);
+    return userStatusToString(status);
+}
+
+namespace {
+void writeFriendMembers(const uint8_t* record, Writer& out)
+{
+    using Layout = FriendRecordLayout;
+
+    out.key("Status");
+    out.string(FriendStatusToString(static_cast<FriendStatus>(record[Layout::status])));
+    out.key("Long term public key");
+    out.hex(record + Layout::publicKey, 32);
+
+    // the lengths follow their fixed-size fields, and are clamped to them so a bogus one can't leave the record
+    const auto infoSize = loadNumber<Endianness::big, uint16_t>(record + Layout::requestMessageLength);
+    out.key("Size of the friend request message");
+    out.number(infoSize);
+    out.key("Friend request message as a byte string");
+    writeString(record + Layout::requestMessage, std::min(size_t{infoSize}, Layout::requestMessageMaxLength), out);
+
+    const auto nameLength = loadNumber<Endianness::big, uint16_t>(record + Layout::nameLength);
+    out.key("Size of the name");
+    out.number(nameLength);
+    out.key("Name as a byte string");
+    writeString(record + Layout::name, std::min(size_t{nameLength}, Layout::nameMaxLength), out);
+
+    const auto statusMessageLength = loadNumber<Endianness::big, uint16_t>(record + Layout::statusMessageLength);
+    out.key("Size of the status message");
+    out.number(statusMessageLength);
+    out.key("Status message as a byte string");
+    writeString(record + Layout::statusMessage, std::min(size_t{statusMessageLength}, Layout::statusMessageMaxLength),
+                out);
+
+    out.key("User status");
+    out.string(userStatusToString(static_cast<UserStatus>(record[Layout::userStatus])));
+
+    out.key("Nospam (only used for sending a friend request)");
+    out.hex(record + Layout::nospam, 4);
+
+    out.key("Last seen time");
+    out.timestamp(loadNumber<Endianness::big, uint64_t>(record + Layout::lastSeen));
+}
+
+void writeFriendRange(const uint8_t* records, size_t count, Writer& out)
+{
+    for (size_t i = 0; i < count; ++i) {
+        out.beginObject();
+        writeFriendMembers(records + i * FriendRecordLayout::size, out);
+        out.endObject();
+    }
+}
+
+struct FriendRange {
+    const uint8_t* records;
+    size_t count;
+    std::unique_ptr<Writer> writer;
+    std::exception_ptr error;
+};
+
+// Splits the records into ranges decoded on the global thread pool, each into a fork of out, and splices them back in
+// order. Returns false without writing anything if out can't be forked or it isn't worth it.
+bool writeFriendsInParallel(const uint8_t* records, size_t count, Writer& out)
+{
+    const size_t minFriendsPerTask = minimumRecordsPerTask(SectionType::friends, FriendRecordLayout::size);
+    if (minFriendsPerTask == 0) {
+        return false;
+    }
+    const size_t tasks
+        = std::min(count / minFriendsPerTask, static_cast<size_t>(ThreadPool::global().maxThreadCount()) * 4);
+    if (tasks < 2) {
+        return false;
+    }
+    auto first = out.fork();
+    if (!first) {
+        return false;
+    }
+
+    std::vector<FriendRange> ranges(tasks);
+    size_t begin = 0;
+    for (size_t i = 0; i < tasks; ++i) {
+        const size_t rangeCount = count / tasks + (i < count % tasks ? 1 : 0);
+        ranges[i].records = records + begin * FriendRecordLayout::size;
+        ranges[i].count = rangeCount;
+        ranges[i].writer = i == 0 ? std::move(first) : out.fork();
+        begin += rangeCount;
+    }
+
+    const auto stats = currentStatsContext();
+    blockingMap(ranges, [&stats](FriendRange& range) {
+        PoolTaskTimer timer(stats);
+        try {
+            writeFriendRange(range.records, range.count, *range.writer);
+        }
+        catch (...) {
+            range.error = std::current_exception();
+        }
+    });
+
+    for (auto& range : ranges) {
+        // the first failing record, as in a sequential decode
+        if (range.error) {
+            std::rethrow_exception(range.error);
+        }
+        out.splice(*range.writer);
+    }
+    return true;
+}
+}
+
+void addFriend(Cursor& data, Writer& out)
+{
+    data.require(FriendRecordLayout::size, "friend record");
+    writeFriendMembers(data.advance(FriendRecordLayout::size), out);
+}
+
+void getFriends(Cursor& data, Writer& out)
+{
+    // every record has the same size, so the section can be split by index without walking it
+    if (data.remaining() % FriendRecordLayout::size != 0) {
+        throw std::runtime_error("Friends section size isn't a multiple of the friend record size");
+    }
+    const size_t count = data.remaining() / FriendRecordLayout::size;
+    const uint8_t* const records = data.advance(data.remaining());
+    countRecords(count);
+
+    out.beginArray();
+    if (!writeFriendsInParallel(records, count, out)) {
+        writeFriendRange(records, count, out);
+    }
+    out.endArray();
+}
+
+void getConferences(Cursor& data, Writer& out)
+{
+    // first pass: find and bounds check every record, so the second can decode them in any order
+    const size_t sectionSize = data.remaining();
+    const ConferenceIndex index(data);
+    data.advance(data.remaining());
+    countRecords(index.size() + index.totalPeers());
+
+    out.beginArray();
+    if (!writeConferencesInParallel(index, sectionSize, out)) {
+        for (size_t i = 0; i < index.size(); ++i) {
+            writeConference(index, i, out);
+        }
+    }
+    out.endArray();
+}
+
+void writeSection(SectionHeader sectionHeader, Writer& out)
+{
+    SectionTimer timer(sectionHeader);
+    // the decoders can't read past the section, only stop short of its end
+    Cursor data = sectionHeader.payload();
+
+    switch (sectionHeader.type)
+    {
+    case SectionType::nospamkeys:
+        getNoSpamKeys(data, out);
+        break;
+    case SectionType::dht:
+        getDht(data, out);
+        break;
+    case SectionType::friends:
+        getFriends(data, out);
+        break;
+    case SectionType::name:
+        writeString(data, sectionHeader.size, out);
+        break;
+    case SectionType::statusmessage:
+        writeString(data, sectionHeader.size, out);
+        break;
+    case SectionType::status:
+        out.string(getStatus(data));
+        break;
+    case SectionType::tcpRelay:
+    case SectionType::pathNode:
+        getNodeInfos(data, out);
+        break;
+    case SectionType::conferences:
+        getConferences(data, out);
+        break;
+    default :
+        // unknown section
+        out.number(static_cast<int>(sectionHeader.type));
+        data.advance(sectionHeader.size);
+    }
+
+    if (!data.atEnd())
+    {
+        throw std::runtime_error("Section contents didn't match section size.");
+    }
+}
+
+namespace {
+// Sections decoded one after another on a pool thread, into an arena of their own.
+struct SectionTask {
+    std::vector<size_t> sections;
+    Arena arena;
+    std::exception_ptr error;
+    size_t failed = 0; // the section that threw error
+};
+
+// The part of the selection for each section, nullptr where the whole section is selected. Sections with nothing
+// selected, and sections replaced by a later one with the same name, are removed from sections, so they aren't
+// decoded at all.
+std::vector<const Selection::Node*> selectSections(std::vector<SectionHeader>& sections, const Selection* selection)
+{
+    const auto replaced = replacedSections(sections);
+    std::vector<const Selection::Node*> selected(sections.size());
+    size_t kept = 0;
+    for (size_t i = 0; i < sections.size(); ++i) {
+        if (replaced[i]) {
+            continue;
+        }
+        if (!selection) {
+            sections[kept++] = sections[i];
+            continue;
+        }
+        const Selection::Node* node = selection->root().member(sectionName(sections[i].type));
+        if (node) {
+            selected[kept] = node->all ? nullptr : node;
+            sections[kept++] = sections[i];
+        }
+    }
+    sections.resize(kept);
+    selected.resize(kept);
+    return selected;
+}
+
+// nullptr if nothing of the section was selected
+const DocumentNode* decodeSection(SectionHeader section, const Selection::Node* selected, Arena& arena,
+                                  const uint8_t* source, size_t sourceSize)
+{
+    DocumentWriter document(arena, source, sourceSize);
+    if (selected) {
+        SelectionWriter writer(document, *selected);
+        writeSection(section, writer);
+    } else {
+        writeSection(section, document);
+    }
+    return document.result();
+}
+}
+
+void writeSortedProfile(Cursor data, Writer& out, bool parallel, const Selection* selection)
+{
+    // strings in the save are referenced by the documents rather than copied
+    const uint8_t* const source = data.data();
+    const size_t sourceSize = data.remaining();
+    std::vector<SectionHeader> sections;
+    std::vector<const Selection::Node*> selected;
+    {
+        StageTimer timer(Stage::sections);
+        parseGlobalHeader(data);
+        sections = getAllSections(data);
+        selected = selectSections(sections, selection);
+    }
+
+    std::vector<const DocumentNode*> roots(sections.size());
+    std::vector<SectionTask> tasks;
+    {
+        StageTimer decodeTimer(Stage::decode);
+        const auto spread = parallel ? planSections(sections) : std::vector<bool>(sections.size(), false);
+        const size_t spreadCount = std::count(spread.begin(), spread.end(), true);
+        if (spreadCount > 0) {
+            // a task for each section worth one, and one more for all the others
+            tasks = std::vector<SectionTask>(spreadCount + (spreadCount < sections.size() ? 1 : 0));
+            size_t next = 0;
+            for (size_t i = 0; i < sections.size(); ++i) {
+                tasks[spread[i] ? next++ : tasks.size() - 1].sections.push_back(i);
+            }
+            const auto stats = currentStatsContext();
+            blockingMap(tasks, [&sections, &selected, &roots, source, sourceSize, &stats](SectionTask& task) {
+                PoolTaskTimer timer(stats);
+                try {
+                    for (const size_t i : task.sections) {
+                        task.failed = i;
+                        roots[i] = decodeSection(sections[i], selected[i], task.arena, source, sourceSize);
+                    }
+                }
+                catch (...) {
+                    task.error = std::current_exception();
+                }
+            });
+            // the first failing section, as in a sequential decode
+            const SectionTask* failed = nullptr;
+            for (const auto& task : tasks) {
+                if (task.error && (!failed || task.failed < failed->failed)) {
+                    failed = &task;
+                }
+            }
+            if (failed) {
+                std::rethrow_exception(failed->error);
+            }
+        } else {
+            // in batch mode each pool thread reuses its arena from file to file
+            thread_local Arena arena;
+            arena.reset();
+            for (size_t i = 0; i < sections.size(); ++i) {
+                roots[i] = decodeSection(sections[i], selected[i], arena, source, sourceSize);
+            }
+        }
+    }
+
+    StageTimer timer(Stage::serialize);
+    // sorted like QJsonObject keys, the section names are unique once selectSections() has dropped replaced ones
+    std::vector<size_t> order(sections.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&sections](size_t a, size_t b) {
+        return strcmp(sectionName(sections[a].type), sectionName(sections[b].type)) < 0;
+    });
+    out.beginObject();
+    for (const size_t i : order) {
+        if (roots[i]) {
+            out.key(sectionName(sections[i].type));
+            writeDocument(*roots[i], out, true);
+        }
+    }
+    out.endObject();
+}
+
+void writeProfile(Cursor data, Writer& out, const Selection* selection)
+{
+    std::vector<SectionHeader> sections;
+    std::vector<const Selection::Node*> selected;
+    {
+        StageTimer timer(Stage::sections);
+        parseGlobalHeader(data);
+        sections = getAllSections(data);
+        selected = selectSections(sections, selection);
+    }
+
+    StageTimer timer(Stage::decode);
+    out.beginObject();
+    for (size_t i = 0; i < sections.size(); ++i) {
+        const char* name = sectionName(sections[i].type);
+        if (selected[i]) {
+            SelectionWriter writer(out, *selected[i], name);
+            writeSection(sections[i], writer);
+        } else {
+            out.key(name);
+            writeSection(sections[i], out);
+        }
+    }
+    out.endObject();
+}
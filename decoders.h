@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>     // for size_t
+#include <cstdint>     // for uint8_t, uint16_t, uint32_t
+#include <string>      // for string
+#include "cursor.h"    // for Cursor
+#include "sections.h"  // for SectionHeader
+#include "writer.h"    // for Writer
+
+class ConferenceIndex;
+class Selection;
+
+// Each decoder checks the bounds of a whole record against data before decoding it, and throws
+// std::runtime_error if the record doesn't fit. The list decoders consume data to its end.
+void getNoSpamKeys(Cursor& data, Writer& out);
+void getDht(Cursor& data, Writer& out);
+
+// A DHT section's payload starts with the state cookie and then wraps its nodes in an inner section with a header of
+// its own: the nodes' size, the inner section type and its magic.
+constexpr uint32_t dhtStateCookie = 0x0159000d;
+constexpr uint16_t dhtNodesSectionType = 4;
+constexpr uint16_t dhtInnerSectionMagic = 0x11ce;
+constexpr size_t dhtHeaderSize = 12;
+// Reads and checks the DHT header at the start of data and returns the size of the node records that follow it, for
+// callers that check that size themselves.
+uint32_t readDhtHeader(Cursor& data);
+// The node records of the DHT section at data, after which data is left. Throws for a bad header like getDht().
+Cursor getDhtNodes(Cursor& data);
+void getConferencePeer(Cursor& data, Writer& out);
+void getConference(Cursor& data, Writer& out);
+std::string getStatus(Cursor& data);
+void addFriend(Cursor& data, Writer& out);
+void getFriends(Cursor& data, Writer& out);
+void getConferences(Cursor& data, Writer& out);
+// Decodes one conference of an indexed Conferences section, without walking the ones before it.
+void writeConference(const ConferenceIndex& index, size_t conference, Writer& out);
+// The parts of a conference record whose bounds have been checked, for decoding one record at a time:
+// beginConference() opens the conference's object and writes everything up to its open "List of peers" array, which
+// takes a writeConferencePeer() per peer, and endConference() closes both.
+void beginConference(const uint8_t* record, Writer& out);
+void writeConferencePeer(const uint8_t* record, Writer& out);
+void endConference(Writer& out);
+
+// Decodes one section's payload as a single value.
+void writeSection(SectionHeader sectionHeader, Writer& out);
+
+// Streams a whole mapped save into out as one object keyed by section name, in file order. Of sections with the same
+// name only the last is written, as in parseProfile(). With a selection only the selected fields are written: other sections aren't even decoded, and other fields are dropped before being encoded.
+void writeProfile(Cursor data, Writer& out, const Selection* selection = nullptr);
+// Writes the same document as parseProfile() (qtprofile.h) to out: the members of every object sorted by key, and of
+// sections with the same name only the last. The sections are decoded into DocumentNodes in an arena (one per thread,
+// or per section with parallel set, spreading them over the global thread pool) and then written out sorted, so
+// unlike a QJsonObject tree nothing is allocated per field. A selection works as for writeProfile().
+void writeSortedProfile(Cursor data, Writer& out, bool parallel = true, const Selection* selection = nullptr);
@@ -0,0 +1,252 @@
+#include "document.h"
+#include <string.h>   // for memcpy, strcmp
+#include <algorithm>  // for max, sort
+#include <iterator>   // for make_move_iterator
+#include <new>        // for placement new
+#include <utility>    // for move, swap
+
+void Arena::reset()
+{
+    current = 0;
+    pos = chunks.empty() ? nullptr : chunks.front().data.get();
+    end = chunks.empty() ? nullptr : pos + chunks.front().size;
+}
+
+void Arena::nextChunk(size_t minimumSize)
+{
+    // reuse the chunks kept by reset() first, skipping any too small for this allocation
+    const size_t next = pos ? current + 1 : 0;
+    for (size_t i = next; i < chunks.size(); ++i) {
+        if (chunks[i].size >= minimumSize) {
+            std::swap(chunks[next], chunks[i]);
+            break;
+        }
+    }
+    if (next == chunks.size() || chunks[next].size < minimumSize) {
+        // grow geometrically, so a large document takes few chunks
+        const size_t size = std::max({minimumSize, chunkSize, chunks.empty() ? 0 : chunks.back().size * 2});
+        chunks.insert(chunks.begin() + next, Chunk{std::unique_ptr<char[]>(new char[size]), size});
+    }
+    current = next;
+    pos = chunks[current].data.get();
+    end = pos + chunks[current].size;
+}
+
+void Arena::adopt(Arena& other)
+{
+    if (!other.pos) {
+        return;
+    }
+    // in front of the current chunk, where reset() finds them again but allocating never reuses them
+    const size_t count = other.current + 1;
+    const size_t at = pos ? current : 0;
+    chunks.insert(chunks.begin() + at, std::make_move_iterator(other.chunks.begin()),
+                  std::make_move_iterator(other.chunks.begin() + count));
+    current = at + count;
+    other.chunks.erase(other.chunks.begin(), other.chunks.begin() + count);
+    other.reset();
+    if (!pos) {
+        // nothing allocated here yet, allocating starts in the chunk after them
+        current = count - 1;
+        pos = end = chunks[current].data.get() + chunks[current].size;
+    }
+}
+
+DocumentWriter::DocumentWriter(Arena& arena, const uint8_t* source, size_t sourceSize)
+    : arena(arena)
+    , sourceBegin(reinterpret_cast<const char*>(source))
+    , sourceEnd(reinterpret_cast<const char*>(source) + sourceSize)
+{
+}
+
+DocumentWriter::DocumentWriter(std::unique_ptr<Arena> ownArena, const char* sourceBegin, const char* sourceEnd)
+    : ownArena(std::move(ownArena))
+    , arena(*this->ownArena)
+    , sourceBegin(sourceBegin)
+    , sourceEnd(sourceEnd)
+{
+}
+
+void DocumentWriter::beginObject()
+{
+    DocumentNode* node = add(DocumentNode::Kind::object);
+    node->next = open;
+    open = node;
+}
+
+void DocumentWriter::endObject()
+{
+    DocumentNode* node = open;
+    open = node->next;
+    node->next = nullptr;
+}
+
+void DocumentWriter::beginArray()
+{
+    DocumentNode* node = add(DocumentNode::Kind::array);
+    node->next = open;
+    open = node;
+}
+
+void DocumentWriter::endArray()
+{
+    endObject();
+}
+
+void DocumentWriter::key(const char* name)
+{
+    pendingKey = name;
+}
+
+void DocumentWriter::string(const char* data, size_t length)
+{
+    DocumentNode* node = add(DocumentNode::Kind::string);
+    node->text = {keep(data, length), length};
+}
+
+void DocumentWriter::number(int64_t value)
+{
+    add(DocumentNode::Kind::number)->number = value;
+}
+
+void DocumentWriter::hex(const uint8_t* data, size_t length)
+{
+    DocumentNode* node = add(DocumentNode::Kind::bytes);
+    node->text = {keep(reinterpret_cast<const char*>(data), length), length};
+}
+
+void DocumentWriter::timestamp(uint64_t secondsSinceEpoch)
+{
+    add(DocumentNode::Kind::timestamp)->seconds = secondsSinceEpoch;
+}
+
+std::unique_ptr<Writer> DocumentWriter::fork(size_t nested) const
+{
+    if (nested == 0 && (!open || open->kind != DocumentNode::Kind::array)) {
+        return nullptr;
+    }
+    std::unique_ptr<DocumentWriter> forked(new DocumentWriter(std::make_unique<Arena>(), sourceBegin, sourceEnd));
+    // collects the elements in an array of its own, whose children splice() links in
+    forked->beginArray();
+    return forked;
+}
+
+void DocumentWriter::splice(Writer& fork)
+{
+    auto& forked = static_cast<DocumentWriter&>(fork);
+    const auto& elements = forked.root->children;
+    if (!elements.first) {
+        return;
+    }
+    if (open->children.last) {
+        open->children.last->next = elements.first;
+    } else {
+        open->children.first = elements.first;
+    }
+    open->children.last = elements.last;
+    arena.adopt(*forked.ownArena);
+}
+
+DocumentNode* DocumentWriter::add(DocumentNode::Kind kind)
+{
+    auto* node = new (arena.allocate(sizeof(DocumentNode), alignof(DocumentNode))) DocumentNode;
+    node->kind = kind;
+    node->children = {nullptr, nullptr};
+    if (!open) {
+        root = node;
+        return node;
+    }
+    if (open->kind == DocumentNode::Kind::object) {
+        node->key = pendingKey;
+    }
+    if (open->children.last) {
+        open->children.last->next = node;
+    } else {
+        open->children.first = node;
+    }
+    open->children.last = node;
+    return node;
+}
+
+const char* DocumentWriter::keep(const char* data, size_t length)
+{
+    if (data >= sourceBegin && data + length <= sourceEnd) {
+        return data;
+    }
+    auto* copy = static_cast<char*>(arena.allocate(length, 1));
+    memcpy(copy, data, length);
+    return copy;
+}
+
+namespace {
+struct Member {
+    const DocumentNode* node;
+    size_t order;
+};
+
+// members of the objects being written, one range per level of nesting, so sorting doesn't allocate per object
+void writeNode(const DocumentNode& node, Writer& out, bool sortKeys, std::vector<Member>& members)
+{
+    switch (node.kind) {
+    case DocumentNode::Kind::object: {
+        out.beginObject();
+        if (!sortKeys) {
+            for (const DocumentNode* child = node.children.first; child; child = child->next) {
+                out.key(child->key);
+                writeNode(*child, out, sortKeys, members);
+            }
+            out.endObject();
+            break;
+        }
+
+        const size_t first = members.size();
+        for (const DocumentNode* child = node.children.first; child; child = child->next) {
+            members.push_back({child, members.size() - first});
+        }
+        std::sort(members.begin() + first, members.end(), [](const Member& a, const Member& b) {
+            const int order = strcmp(a.node->key, b.node->key);
+            return order != 0 ? order < 0 : a.order < b.order;
+        });
+        // by index, the nested objects append to members
+        const size_t last = members.size();
+        for (size_t i = first; i < last; ++i) {
+            const DocumentNode* child = members[i].node;
+            if (i + 1 < last && strcmp(child->key, members[i + 1].node->key) == 0) {
+                continue; // replaced by a later member with the same key
+            }
+            out.key(child->key);
+            writeNode(*child, out, sortKeys, members);
+        }
+        members.resize(first);
+        out.endObject();
+        break;
+    }
+    case DocumentNode::Kind::array:
+        out.beginArray();
+        for (const DocumentNode* child = node.children.first; child; child = child->next) {
+            writeNode(*child, out, sortKeys, members);
+        }
+        out.endArray();
+        break;
+    case DocumentNode::Kind::string:
+        out.string(node.text.data, node.text.length);
+        break;
+    case DocumentNode::Kind::number:
+        out.number(node.number);
+        break;
+    case DocumentNode::Kind::bytes:
+        out.hex(reinterpret_cast<const uint8_t*>(node.text.data), node.text.length);
+        break;
+    case DocumentNode::Kind::timestamp:
+        out.timestamp(node.seconds);
+        break;
+    }
+}
+}
+
+void writeDocument(const DocumentNode& node, Writer& out, bool sortKeys)
+{
+    thread_local std::vector<Member> members;
+    members.clear();
+    writeNode(node, out, sortKeys, members);
+}
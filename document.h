@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>  // for size_t, max_align_t
+#include <cstdint>  // for int64_t, uint8_t, uint64_t, uintptr_t
+#include <memory>   // for unique_ptr
+#include <vector>   // for vector
+#include "writer.h"
+
+// Bump allocator for DocumentNodes. Memory is handed out from large chunks and only given back all at once
+// by reset(), which keeps the chunks, so an arena reused for parse after parse stops allocating once it has grown to
+// the largest one.
+class Arena {
+public:
+    explicit Arena(size_t chunkSize = 64 * 1024) : chunkSize(chunkSize) {}
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+    {
+        auto address = (reinterpret_cast<uintptr_t>(pos) + alignment - 1) & ~(alignment - 1);
+        if (!pos || address + size > reinterpret_cast<uintptr_t>(end)) {
+            nextChunk(size + alignment);
+            address = (reinterpret_cast<uintptr_t>(pos) + alignment - 1) & ~(alignment - 1);
+        }
+        pos = reinterpret_cast<char*>(address + size);
+        return reinterpret_cast<void*>(address);
+    }
+
+    // Forgets everything allocated so far, keeping the memory for what comes next.
+    void reset();
+    // Takes over other's memory, with what was allocated from it, until the next reset(). other is left empty.
+    void adopt(Arena& other);
+
+private:
+    struct Chunk {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    void nextChunk(size_t minimumSize);
+
+    const size_t chunkSize;
+    std::vector<Chunk> chunks;
+    size_t current = 0; // chunk pos points into
+    char* pos = nullptr;
+    char* end = nullptr;
+};
+
+// A decoded value, allocated in an Arena. Objects and arrays link their children, so appending never moves anything.
+struct DocumentNode {
+    enum class Kind : uint8_t {
+        object,
+        array,
+        string,
+        number,
+        bytes,
+        timestamp,
+    };
+
+    Kind kind;
+    const char* key = nullptr;  // member name in an object, as passed to Writer::key
+    DocumentNode* next = nullptr; // next sibling; while a container is being written, its parent
+    union {
+        struct {
+            DocumentNode* first;
+            DocumentNode* last;
+        } children;
+        struct {
+            const char* data;
+            size_t length;
+        } text; // string or bytes
+        int64_t number;
+        uint64_t seconds;
+    };
+};
+
+// Builds a tree of DocumentNodes from the Writer events, to be written out later (e.g. with sorted keys) by
+// writeDocument(). Nothing is allocated outside of the arena: keys are kept as the pointers passed to key(), and
+// strings and byte strings that lie within source (normally the mapped save) are referenced rather than copied, so
+// source and the arena have to outlive the result. Other strings are copied into the arena.
+class DocumentWriter : public Writer {
+public:
+    DocumentWriter(Arena& arena, const uint8_t* source, size_t sourceSize);
+
+    void beginObject() override;
+    void endObject() override;
+    void beginArray() override;
+    void endArray() override;
+    void key(const char* name) override;
+    void string(const char* data, size_t length) override;
+    void number(int64_t value) override;
+    void hex(const uint8_t* data, size_t length) override;
+    void timestamp(uint64_t secondsSinceEpoch) override;
+    using Writer::string;
+    // A fork allocates from an arena of its own, which the writer it's spliced into adopts.
+    std::unique_ptr<Writer> fork(size_t nested = 0) const override;
+    void splice(Writer& fork) override;
+
+    // The value written, or nullptr before one has been completed.
+    const DocumentNode* result() const { return open == nullptr ? root : nullptr; }
+
+private:
+    DocumentWriter(std::unique_ptr<Arena> ownArena, const char* sourceBegin, const char* sourceEnd);
+    DocumentNode* add(DocumentNode::Kind kind);
+    const char* keep(const char* data, size_t length);
+
+    std::unique_ptr<Arena> ownArena; // only set in forks, arena refers to it
+    Arena& arena;
+    const char* sourceBegin;
+    const char* sourceEnd;
+    const char* pendingKey = nullptr;
+    DocumentNode* root = nullptr;
+    DocumentNode* open = nullptr; // innermost open container
+};
+
+// Writes node and everything below it to out. With sortKeys the members of every object are written ordered by key,
+// and of members with the same key only the last one, like a QJsonObject holds them.
+void writeDocument(const DocumentNode& node, Writer& out, bool sortKeys = false);
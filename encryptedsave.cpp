@@ -0,0 +1,151 @@
+#include "encryptedsave.h"
+#include <stdlib.h>   // for getenv
+#include <string.h>   // for memcmp
+#include <fstream>    // for ifstream
+#include <stdexcept>  // for runtime_error
+#include <utility>    // for move
+#include "stats.h"    // for StageTimer
+
+#ifdef TOXSAVE_HAVE_SODIUM
+#include <sodium.h>
+#endif
+
+namespace {
+const char encryptedSaveMagic[encryptedSaveMagicSize + 1] = "toxEsave";
+
+#ifdef TOXSAVE_HAVE_SODIUM
+void initSodium()
+{
+    static const int result = sodium_init();
+    if (result < 0) {
+        throw std::runtime_error("Couldn't initialize libsodium.");
+    }
+}
+
+// Same derivation as toxencryptsave: scrypt over the SHA-256 of the passphrase.
+SaveKey deriveKey(const uint8_t* passphraseHash, const uint8_t* salt)
+{
+    SaveKey key;
+    if (crypto_pwhash_scryptsalsa208sha256(key.data(), key.size(), reinterpret_cast<const char*>(passphraseHash),
+                                           crypto_hash_sha256_BYTES, salt,
+                                           crypto_pwhash_scryptsalsa208sha256_OPSLIMIT_INTERACTIVE * 2,
+                                           crypto_pwhash_scryptsalsa208sha256_MEMLIMIT_INTERACTIVE) != 0) {
+        throw std::runtime_error("Key derivation failed, out of memory?");
+    }
+    return key;
+}
+#endif
+}
+
+bool isEncryptedSave(const uint8_t* data, size_t size)
+{
+    return size >= encryptedSaveMagicSize && memcmp(data, encryptedSaveMagic, encryptedSaveMagicSize) == 0;
+}
+
+#ifdef TOXSAVE_HAVE_SODIUM
+SaveKey KeyCache::key(const std::string& passphrase, const uint8_t* salt)
+{
+    initSodium();
+    uint8_t passphraseHash[crypto_hash_sha256_BYTES];
+    crypto_hash_sha256(passphraseHash, reinterpret_cast<const uint8_t*>(passphrase.data()), passphrase.size());
+
+    std::string cacheKey(reinterpret_cast<const char*>(passphraseHash), sizeof(passphraseHash));
+    cacheKey.append(reinterpret_cast<const char*>(salt), encryptedSaveSaltSize);
+
+    std::promise<SaveKey> promise;
+    std::shared_future<SaveKey> derived;
+    bool derive = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = keys.find(cacheKey);
+        if (found == keys.end()) {
+            derived = promise.get_future().share();
+            keys.emplace(std::move(cacheKey), derived);
+            derive = true;
+        } else {
+            derived = found->second;
+        }
+    }
+
+    // derived outside the lock, so other files' keys are derived at the same time
+    if (derive) {
+        try {
+            promise.set_value(deriveKey(passphraseHash, salt));
+        }
+        catch (...) {
+            promise.set_exception(std::current_exception());
+        }
+    }
+    sodium_memzero(passphraseHash, sizeof(passphraseHash));
+    return derived.get();
+}
+
+DecryptedSave::DecryptedSave(const uint8_t* data, size_t size, const std::string& passphrase, KeyCache* cache)
+{
+    if (!isEncryptedSave(data, size) || size < encryptedSaveOverhead) {
+        throw std::runtime_error("Not an encrypted tox save, or truncated.");
+    }
+    const uint8_t* salt = data + encryptedSaveMagicSize;
+    const uint8_t* nonce = salt + encryptedSaveSaltSize;
+    const uint8_t* ciphertext = nonce + encryptedSaveNonceSize;
+    const size_t ciphertextSize = size - (ciphertext - data);
+
+    KeyCache localCache;
+    SaveKey key = (cache ? *cache : localCache).key(passphrase, salt);
+
+    plain.resize(ciphertextSize - crypto_secretbox_MACBYTES);
+    const int result = crypto_secretbox_open_easy(plain.data(), ciphertext, ciphertextSize, nonce, key.data());
+    sodium_memzero(key.data(), key.size());
+    if (result != 0) {
+        plain.clear();
+        throw std::runtime_error("Couldn't decrypt the profile. Wrong passphrase?");
+    }
+}
+
+DecryptedSave::~DecryptedSave()
+{
+    sodium_memzero(plain.data(), plain.size());
+}
+#else
+SaveKey KeyCache::key(const std::string&, const uint8_t*)
+{
+    throw std::runtime_error("Built without libsodium, can't decrypt encrypted profiles.");
+}
+
+DecryptedSave::DecryptedSave(const uint8_t*, size_t, const std::string&, KeyCache*)
+{
+    throw std::runtime_error("Built without libsodium, can't decrypt encrypted profiles.");
+}
+
+DecryptedSave::~DecryptedSave() = default;
+#endif
+
+std::optional<std::string> readPassphrase(const std::string& passphraseFile)
+{
+    if (!passphraseFile.empty()) {
+        std::ifstream file(passphraseFile);
+        std::string passphrase;
+        if (!file || !std::getline(file, passphrase)) {
+            throw std::runtime_error("Couldn't read the passphrase from " + passphraseFile);
+        }
+        return passphrase;
+    }
+    if (const char* passphrase = getenv("TOXSAVE_PASSPHRASE")) {
+        return std::string(passphrase);
+    }
+    return std::nullopt;
+}
+
+Cursor openSave(const uint8_t* data, size_t size, const std::optional<std::string>& passphrase, KeyCache& cache,
+                std::unique_ptr<DecryptedSave>& decrypted)
+{
+    if (!isEncryptedSave(data, size)) {
+        return Cursor(data, size);
+    }
+    if (!passphrase) {
+        throw std::runtime_error("Profile is encrypted, pass its passphrase with --passphrase-file or TOXSAVE_PASSPHRASE.");
+    }
+    StageTimer timer(Stage::open);
+    decrypted.reset(new DecryptedSave(data, size, *passphrase, &cache));
+    return Cursor(decrypted->data(), decrypted->size());
+}
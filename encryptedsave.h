@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>     // for array
+#include <cstddef>   // for size_t
+#include <cstdint>   // for uint8_t
+#include <future>    // for shared_future
+#include <map>       // for map
+#include <memory>    // for unique_ptr
+#include <mutex>     // for mutex
+#include <optional>  // for optional
+#include <string>    // for string
+#include <vector>    // for vector
+#include "cursor.h"  // for Cursor
+
+// Passphrase encrypted saves as written by toxencryptsave: the "toxEsave" magic, the 32 byte key derivation salt, the
+// 24 byte nonce, then the plain save sealed with crypto_secretbox (its 16 byte MAC first). Decrypting needs libsodium,
+// without it (TOXSAVE_HAVE_SODIUM unset) encrypted saves are only recognized.
+
+constexpr size_t encryptedSaveMagicSize = 8;
+constexpr size_t encryptedSaveSaltSize = 32;
+constexpr size_t encryptedSaveNonceSize = 24;
+constexpr size_t encryptedSaveMacSize = 16;
+constexpr size_t encryptedSaveOverhead = encryptedSaveMagicSize + encryptedSaveSaltSize + encryptedSaveNonceSize
+    + encryptedSaveMacSize;
+
+using SaveKey = std::array<uint8_t, 32>;
+
+bool isEncryptedSave(const uint8_t* data, size_t size);
+
+// Derived keys by passphrase and salt. The key derivation (scrypt) takes far longer than parsing, so a batch shouldn't
+// redo it for every file that shares a passphrase and salt. Safe to share between threads: different keys are derived
+// concurrently, and a thread asking for a key that is still being derived waits for it instead of deriving it again.
+class KeyCache {
+public:
+    SaveKey key(const std::string& passphrase, const uint8_t* salt);
+
+private:
+    std::mutex mutex;
+    // keyed by sha256(passphrase) + salt, so the passphrases themselves aren't kept around
+    std::map<std::string, std::shared_future<SaveKey>> keys;
+};
+
+// The decrypted contents of an encrypted save. They only ever live in this buffer, which is wiped on destruction.
+class DecryptedSave {
+public:
+    // Throws std::runtime_error if the passphrase is wrong, the data is damaged or decryption isn't compiled in.
+    DecryptedSave(const uint8_t* data, size_t size, const std::string& passphrase, KeyCache* cache = nullptr);
+    ~DecryptedSave();
+    DecryptedSave(const DecryptedSave&) = delete;
+    DecryptedSave& operator=(const DecryptedSave&) = delete;
+
+    const uint8_t* data() const { return plain.data(); }
+    size_t size() const { return plain.size(); }
+
+private:
+    std::vector<uint8_t> plain;
+};
+
+// Passphrase for encrypted saves: the first line of passphraseFile if one is given, else $TOXSAVE_PASSPHRASE. It is
+// never taken from the command line, where other users could read it.
+std::optional<std::string> readPassphrase(const std::string& passphraseFile);
+
+// The save in data, decrypting it into decrypted first if it is encrypted.
+Cursor openSave(const uint8_t* data, size_t size, const std::optional<std::string>& passphrase, KeyCache& cache,
+                std::unique_ptr<DecryptedSave>& decrypted);
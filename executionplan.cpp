@@ -0,0 +1,112 @@
+#include "executionplan.h"
+#include <algorithm>     // for max
+#include <atomic>        // for atomic
+#include <stdexcept>     // for invalid_argument
+#include "threadpool.h"  // for ThreadPool
+
+namespace {
+std::atomic<ExecutionPolicy> policy{ExecutionPolicy::automatic};
+
+// Below this a task costs more to hand over than it saves: a worker's wake-up, and the forked writer's output being
+// copied back when it's spliced. The estimates below put it at about 256 friends or 500 conference peers.
+const uint64_t minTaskCost = 500 * 1000;
+// headers, the writer's bookkeeping
+const uint64_t sectionOverhead = 200;
+
+// Measured with --stats over generated saves, decoding plus writing JSON, in tenths of a nanosecond per byte. Nodes
+// are small records that each format an address; a friend record is mostly fixed size fields that are never printed.
+uint64_t costPerByte(SectionType type)
+{
+    switch (type) {
+    case SectionType::dht:
+    case SectionType::tcpRelay:
+    case SectionType::pathNode:
+        return 350;
+    case SectionType::friends:
+        return 10;
+    case SectionType::conferences:
+        return 100;
+    case SectionType::nospamkeys:
+    case SectionType::name:
+    case SectionType::statusmessage:
+    case SectionType::status:
+        return 50;
+    case SectionType::eof:
+        break;
+    }
+    // unknown sections are skipped
+    return 0;
+}
+
+bool poolAvailable()
+{
+    // in batch mode every pool thread already has a file of its own
+    return !ThreadPool::global().busy();
+}
+}
+
+ExecutionPolicy executionPolicyFromString(const std::string& name)
+{
+    if (name == "auto") {
+        return ExecutionPolicy::automatic;
+    }
+    if (name == "serial") {
+        return ExecutionPolicy::serial;
+    }
+    if (name == "parallel") {
+        return ExecutionPolicy::parallel;
+    }
+    throw std::invalid_argument("Unknown execution policy " + name + ", expected auto, serial or parallel.");
+}
+
+void setExecutionPolicy(ExecutionPolicy newPolicy)
+{
+    policy = newPolicy;
+}
+
+ExecutionPolicy executionPolicy()
+{
+    return policy;
+}
+
+uint64_t estimateSectionCost(const SectionHeader& section)
+{
+    return sectionOverhead + section.size * costPerByte(section.type) / 10;
+}
+
+std::vector<bool> planSections(const std::vector<SectionHeader>& sections)
+{
+    std::vector<bool> spread(sections.size(), false);
+    const auto current = executionPolicy();
+    if (current == ExecutionPolicy::serial || sections.size() < 2 || !poolAvailable()) {
+        return spread;
+    }
+    if (current == ExecutionPolicy::parallel) {
+        spread.assign(sections.size(), true);
+        return spread;
+    }
+
+    size_t large = 0;
+    for (size_t i = 0; i < sections.size(); ++i) {
+        spread[i] = estimateSectionCost(sections[i]) >= minTaskCost;
+        large += spread[i];
+    }
+    // one large section only keeps the calling thread waiting for it, splitting its records does better
+    if (large < 2) {
+        spread.assign(sections.size(), false);
+    }
+    return spread;
+}
+
+size_t minimumRecordsPerTask(SectionType type, size_t recordSize)
+{
+    const auto current = executionPolicy();
+    if (current == ExecutionPolicy::serial || !poolAvailable()) {
+        return 0;
+    }
+    if (current == ExecutionPolicy::parallel) {
+        return 1;
+    }
+    const uint64_t recordCost = std::max<uint64_t>(1, recordSize * costPerByte(type) / 10);
+    return std::max<uint64_t>(1, minTaskCost / recordCost);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>     // for size_t
+#include <cstdint>     // for uint64_t
+#include <string>      // for string
+#include <vector>      // for vector
+#include "sections.h"  // for SectionHeader, SectionType
+
+// When decoding leaves the calling thread for the global thread pool. Handing work to another thread costs a wake-up
+// and cold caches, more than decoding a small profile takes, so the planner estimates what each section costs from
+// its type and size and only spreads work that is big enough to pay for it. A single large section is split into
+// ranges of its records instead of being left to one thread.
+enum class ExecutionPolicy {
+    automatic, // parallel where the estimate says it pays off
+    serial,    // everything on the calling thread
+    parallel,  // every section and list that can be spread is, however small (to compare against automatic)
+};
+
+// Throws std::invalid_argument for unknown names.
+ExecutionPolicy executionPolicyFromString(const std::string& name);
+
+// Process wide, like the pool it plans for. automatic unless set.
+void setExecutionPolicy(ExecutionPolicy policy);
+ExecutionPolicy executionPolicy();
+
+// Estimated nanoseconds to decode a section and encode it, from measured costs per byte of each section type.
+uint64_t estimateSectionCost(const SectionHeader& section);
+
+// Which sections are worth decoding as pool tasks of their own while the rest are decoded together: all false when
+// decoding everything on the calling thread is faster, e.g. for a small profile, a single large section (which is
+// split by record instead) or a pool that's busy with other profiles.
+std::vector<bool> planSections(const std::vector<SectionHeader>& sections);
+
+// The fewest records of recordSize bytes of a section of type worth a pool task, or 0 if the list shouldn't be split
+// at all.
+size_t minimumRecordsPerTask(SectionType type, size_t recordSize);
@@ -0,0 +1,328 @@
+#include "friendgraph.h"
+#include <string.h>             // for memcpy, memcmp
+#include <algorithm>            // for min, sort, unique, binary_search, partial_sort
+#include <chrono>               // for steady_clock, duration
+#include <exception>            // for exception
+#include <filesystem>           // for create_directories
+#include <iostream>             // for cerr, ostream, endl
+#include <memory>               // for unique_ptr
+#include <stdexcept>            // for runtime_error
+#include "columnfile.h"         // for ColumnFile
+#include "conferenceindex.h"    // for ConferenceIndex
+#include "cursor.h"             // for Cursor
+#include "encryptedsave.h"      // for DecryptedSave, KeyCache, openSave
+#include "friendrecord.h"       // for FriendRecordLayout
+#include "hash.h"               // for hashBytes
+#include "interntable.h"        // for InternTable
+#include "mappedfile.h"         // for MappedFile
+#include "nodeinfo.h"           // for CRYPTO_PUBLIC_KEY_SIZE
+#include "sections.h"           // for SectionHeader, SectionType, getAllSections, parseGlobalHeader
+#include "threadpool.h"         // for orderedMap
+#include "utils.h"              // for FriendStatus
+#include "writer.h"             // for Writer
+
+namespace {
+// nospam before the public key in the Nospam and Keys section
+const size_t ownKeyOffset = 4;
+const uint32_t noKey = 0xffffffff;
+
+enum class EdgeKind : uint8_t {
+    friendKey,
+    conferencePeer,
+};
+
+struct KeyRecord {
+    uint8_t bytes[CRYPTO_PUBLIC_KEY_SIZE];
+
+    bool operator==(const KeyRecord& other) const { return memcmp(bytes, other.bytes, sizeof(bytes)) == 0; }
+};
+
+struct KeySighting {
+    KeyRecord key;
+    uint64_t hash;
+    EdgeKind kind;
+};
+
+struct ProfileKeys {
+    KeySighting own;
+    std::vector<KeySighting> listed;
+    uint64_t bytes = 0;
+    std::string error;
+};
+
+KeySighting sighting(const uint8_t* key, EdgeKind kind)
+{
+    KeySighting sighting;
+    memcpy(sighting.key.bytes, key, CRYPTO_PUBLIC_KEY_SIZE);
+    sighting.hash = hashBytes(key, CRYPTO_PUBLIC_KEY_SIZE);
+    sighting.kind = kind;
+    return sighting;
+}
+
+// One profile's own key and the keys it lists, copied and hashed on a pool thread so interning them is cheap.
+struct ReadKeys {
+    ProfileKeys operator()(const std::string& path) const
+    {
+        ProfileKeys keys;
+        try {
+            MappedFile file(path);
+            std::unique_ptr<DecryptedSave> decrypted;
+            Cursor data = openSave(file.data(), file.size(), *passphrase, *keyCache, decrypted);
+            parseGlobalHeader(data);
+            bool hasOwnKey = false;
+            for (const auto& header : getAllSections(data)) {
+                switch (header.type) {
+                case SectionType::nospamkeys:
+                    header.payload().require(ownKeyOffset + CRYPTO_PUBLIC_KEY_SIZE, "Nospam and Keys section");
+                    keys.own = sighting(header.data + ownKeyOffset, EdgeKind::friendKey);
+                    hasOwnKey = true;
+                    break;
+                case SectionType::friends:
+                    if (header.size % FriendRecordLayout::size != 0) {
+                        throw std::runtime_error("Friends section size isn't a multiple of the friend record size");
+                    }
+                    for (size_t offset = 0; offset < header.size; offset += FriendRecordLayout::size) {
+                        const uint8_t* record = header.data + offset;
+                        const auto status = static_cast<FriendStatus>(record[FriendRecordLayout::status]);
+                        if (status != FriendStatus::notAFriend) {
+                            keys.listed.push_back(
+                                sighting(record + FriendRecordLayout::publicKey, EdgeKind::friendKey));
+                        }
+                    }
+                    break;
+                case SectionType::conferences: {
+                    const ConferenceIndex index(header.payload());
+                    for (size_t conference = 0; conference < index.size(); ++conference) {
+                        for (size_t peer = 0; peer < index.peerCount(conference); ++peer) {
+                            // the peer record starts with its long term public key
+                            const uint8_t* record = index.peer(conference, peer);
+                            keys.listed.push_back(sighting(record, EdgeKind::conferencePeer));
+                        }
+                    }
+                    break;
+                }
+                default:
+                    break;
+                }
+            }
+            if (!hasOwnKey) {
+                throw std::runtime_error("No Nospam and Keys section");
+            }
+            keys.bytes = file.size();
+        }
+        catch (const std::exception& e) {
+            keys.listed.clear();
+            keys.error = path + ": " + e.what();
+        }
+        return keys;
+    }
+
+    const std::optional<std::string>* passphrase;
+    KeyCache* keyCache;
+};
+
+// nearest rank, of a sorted list
+uint32_t percentile(const std::vector<uint32_t>& sorted, size_t percent)
+{
+    const size_t rank = (percent * sorted.size() + 99) / 100;
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+void writeDistribution(std::vector<uint32_t>& values, Writer& out)
+{
+    std::sort(values.begin(), values.end());
+    out.beginObject();
+    if (!values.empty()) {
+        out.key("p50");
+        out.number(percentile(values, 50));
+        out.key("p90");
+        out.number(percentile(values, 90));
+        out.key("p99");
+        out.number(percentile(values, 99));
+        out.key("Max");
+        out.number(values.back());
+    }
+    out.endObject();
+}
+}
+
+FriendGraphResult buildFriendGraph(const std::vector<std::string>& profilePaths, const std::string& directory,
+                                   Writer& summary, const std::optional<std::string>& passphrase, size_t topKeys)
+{
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        throw std::runtime_error("Couldn't create " + directory + ": " + error.message());
+    }
+
+    ColumnFile profiles(directory, "profiles.txt");
+    ColumnFile ownKeys(directory, "profiles.key");
+    ColumnFile edgesFrom(directory, "edges.from");
+    ColumnFile edgesTo(directory, "edges.to");
+    ColumnFile edgesKind(directory, "edges.kind");
+    ColumnFile edgesProfile(directory, "edges.profile");
+
+    InternTable<KeyRecord> table;
+    // by key row: profiles that list the key at all, profiles that list it as a friend, and the last profile (plus
+    // one) that counted it, so a key listed several times by one profile counts once
+    std::vector<uint32_t> seenBy;
+    std::vector<uint32_t> friendOf;
+    std::vector<uint32_t> lastSeen;
+    // (owner row << 32) | friend row, kept for finding the mutual ones
+    std::vector<uint64_t> friendships;
+    std::vector<uint32_t> friendsPerProfile;
+    std::vector<uint64_t> targets;
+    KeyCache keys;
+    uint32_t profileId = 0;
+    const auto start = std::chrono::steady_clock::now();
+
+    auto intern = [&](const KeySighting& sighting, uint32_t profile) {
+        const uint32_t row = table.insert(sighting.key, sighting.hash);
+        if (row == seenBy.size()) {
+            seenBy.push_back(0);
+            friendOf.push_back(0);
+            lastSeen.push_back(0);
+        }
+        if (lastSeen[row] != profile + 1) {
+            lastSeen[row] = profile + 1;
+            ++seenBy[row];
+        }
+        return row;
+    };
+
+    // merged in input order, so profile ids are input positions
+    FriendGraphResult result;
+    auto merge = [&](const ProfileKeys& read) {
+        const uint32_t profile = profileId++;
+        ++result.files;
+        if (!read.error.empty()) {
+            ++result.failed;
+            std::cerr << read.error << std::endl;
+        }
+        result.bytes += read.bytes;
+        profiles.append(profilePaths[profile].data(), profilePaths[profile].size());
+        profiles.append("\n", 1);
+        if (!read.error.empty()) {
+            ownKeys.appendNumber(noKey);
+            return;
+        }
+        const uint32_t own = intern(read.own, profile);
+        ownKeys.appendNumber(own);
+
+        // kind in the high half, so after sorting each edge is written once and friends come first
+        targets.clear();
+        for (const auto& sighting : read.listed) {
+            const uint32_t row = intern(sighting, profile);
+            if (row != own) {
+                targets.push_back(static_cast<uint64_t>(sighting.kind) << 32 | row);
+            }
+        }
+        std::sort(targets.begin(), targets.end());
+        targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+
+        uint32_t friends = 0;
+        for (const auto target : targets) {
+            const auto kind = static_cast<EdgeKind>(target >> 32);
+            const auto row = static_cast<uint32_t>(target);
+            edgesFrom.appendNumber(own);
+            edgesTo.appendNumber(row);
+            edgesKind.appendNumber(static_cast<uint8_t>(kind));
+            edgesProfile.appendNumber(profile);
+            if (kind == EdgeKind::friendKey) {
+                ++friends;
+                ++friendOf[row];
+                friendships.push_back(static_cast<uint64_t>(own) << 32 | row);
+            } else {
+                ++result.conferenceEdges;
+            }
+        }
+        friendsPerProfile.push_back(friends);
+    };
+    orderedMap(profilePaths, ReadKeys{&passphrase, &keys}, merge);
+
+    ColumnFile keyBytes(directory, "keys.key");
+    ColumnFile keyProfiles(directory, "keys.profiles");
+    for (uint32_t row = 0; row < table.rows().size(); ++row) {
+        keyBytes.append(table.rows()[row].bytes, CRYPTO_PUBLIC_KEY_SIZE);
+        keyProfiles.appendNumber(seenBy[row]);
+    }
+    for (auto* file : {&profiles, &ownKeys, &edgesFrom, &edgesTo, &edgesKind, &edgesProfile, &keyBytes,
+                       &keyProfiles}) {
+        file->finish();
+    }
+
+    // several profiles of the same account list the same friends
+    std::sort(friendships.begin(), friendships.end());
+    friendships.erase(std::unique(friendships.begin(), friendships.end()), friendships.end());
+    uint64_t mutual = 0;
+    for (const auto friendship : friendships) {
+        const auto from = static_cast<uint32_t>(friendship >> 32);
+        const auto to = static_cast<uint32_t>(friendship);
+        const uint64_t reverse = static_cast<uint64_t>(to) << 32 | from;
+        if (from < to && std::binary_search(friendships.begin(), friendships.end(), reverse)) {
+            ++mutual;
+        }
+    }
+
+    std::vector<uint32_t> listedAsFriend;
+    for (const auto count : friendOf) {
+        if (count > 0) {
+            listedAsFriend.push_back(count);
+        }
+    }
+    std::vector<uint32_t> mostSeen(table.rows().size());
+    for (uint32_t row = 0; row < mostSeen.size(); ++row) {
+        mostSeen[row] = row;
+    }
+    const size_t top = std::min(topKeys, mostSeen.size());
+    // ties go to the key seen first, so the list is the same on every run
+    std::partial_sort(mostSeen.begin(), mostSeen.begin() + top, mostSeen.end(), [&seenBy](uint32_t a, uint32_t b) {
+        return seenBy[a] != seenBy[b] ? seenBy[a] > seenBy[b] : a < b;
+    });
+
+    summary.beginObject();
+    summary.key("Profiles");
+    summary.number(static_cast<int64_t>(result.files - result.failed));
+    summary.key("Keys");
+    summary.number(static_cast<int64_t>(table.rows().size()));
+    summary.key("Friend edges");
+    summary.number(static_cast<int64_t>(friendships.size()));
+    summary.key("Conference edges");
+    summary.number(static_cast<int64_t>(result.conferenceEdges));
+    summary.key("Mutual friendships");
+    summary.number(static_cast<int64_t>(mutual));
+    summary.key("Friends per profile");
+    writeDistribution(friendsPerProfile, summary);
+    summary.key("Profiles per friend");
+    writeDistribution(listedAsFriend, summary);
+    summary.key("Most seen keys");
+    summary.beginArray();
+    for (size_t i = 0; i < top; ++i) {
+        const uint32_t row = mostSeen[i];
+        summary.beginObject();
+        summary.key("Key");
+        summary.hex(table.rows()[row].bytes, CRYPTO_PUBLIC_KEY_SIZE);
+        summary.key("Profiles");
+        summary.number(seenBy[row]);
+        summary.key("Friend of");
+        summary.number(friendOf[row]);
+        summary.endObject();
+    }
+    summary.endArray();
+    summary.endObject();
+
+    result.uniqueKeys = table.rows().size();
+    result.friendEdges = friendships.size();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+void printFriendGraphSummary(const FriendGraphResult& result, std::ostream& out)
+{
+    const double seconds = result.seconds > 0 ? result.seconds : 1e-9;
+    out << "Built a graph of " << result.uniqueKeys << " keys, " << result.friendEdges << " friend and "
+        << result.conferenceEdges << " conference edges from " << result.files - result.failed << "/"
+        << result.files << " files (" << result.failed << " failed), " << result.bytes << " bytes in "
+        << result.seconds << " s: " << result.files / seconds << " files/s, "
+        << result.bytes / seconds / (1024 * 1024) << " MiB/s" << std::endl;
+}
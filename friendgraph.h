@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>   // for size_t
+#include <cstdint>   // for uint64_t
+#include <iosfwd>    // for ostream
+#include <optional>  // for optional
+#include <string>    // for string
+#include <vector>    // for vector
+
+class Writer;
+
+struct FriendGraphResult {
+    size_t files = 0;
+    size_t failed = 0;
+    uint64_t bytes = 0;
+    uint64_t uniqueKeys = 0;
+    uint64_t friendEdges = 0;     // distinct (owner, friend) pairs
+    uint64_t conferenceEdges = 0; // (owner, peer) pairs, one per profile however many conferences they share
+    double seconds = 0;
+};
+
+// Builds the graph of who is friends with whom over every profile. Every public key, the profiles' own (from Nospam
+// and Keys), their friends' and their conference peers', is interned as its raw 32 bytes, so memory grows with the
+// distinct keys and the edges rather than with the profiles. Writes the graph into directory as column files like
+// exportNodes():
+//
+//   keys.key           32 bytes  public key
+//   keys.profiles      u32       profiles listing the key as their own, a friend or a conference peer
+//   edges.from         u32       row in the keys.* files of the profile's own key
+//   edges.to           u32       row of the friend or conference peer
+//   edges.kind         u8        0 friend, 1 conference peer
+//   edges.profile      u32       line in profiles.txt
+//   profiles.key       u32       row of the profile's own key, 0xffffffff if it failed to parse
+//   profiles.txt                 every input path, one per line
+//
+// Keys are numbered by first appearance, profiles read in parallel and merged in input order. Friend records with the
+// "Not a friend" status are left out. Also writes a summary to summary: how many friends each profile has, how many
+// profiles list each key as a friend (p50, p90, p99 and maximum of both), how many pairs of keys are both in the
+// fleet and each other's friends, and the topKeys keys seen in the most profiles. A profile that fails to parse is
+// reported on stderr and has no edges. Throws std::runtime_error if the output files can't be written.
+FriendGraphResult buildFriendGraph(const std::vector<std::string>& profilePaths, const std::string& directory,
+                                   Writer& summary, const std::optional<std::string>& passphrase = std::nullopt,
+                                   size_t topKeys = 20);
+
+void printFriendGraphSummary(const FriendGraphResult& result, std::ostream& out);
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>  // for size_t
+
+// Layout of a friend record in the Friends section. Every record has the same size, with the text fields stored in
+// fixed-size buffers followed by their big-endian uint16 length, so record i starts at i * size and any field can be
+// read without looking at the records before it. The offsets are from the start of a record.
+struct FriendRecordLayout {
+    static constexpr size_t requestMessageMaxLength = 1024;
+    static constexpr size_t nameMaxLength = 128;
+    static constexpr size_t statusMessageMaxLength = 1007;
+
+    static constexpr size_t status = 0;
+    static constexpr size_t publicKey = status + 1;
+    static constexpr size_t requestMessage = publicKey + 32;
+    static constexpr size_t requestMessageLength = requestMessage + requestMessageMaxLength + 1; // after 1 padding byte
+    static constexpr size_t name = requestMessageLength + 2;
+    static constexpr size_t nameLength = name + nameMaxLength;
+    static constexpr size_t statusMessage = nameLength + 2;
+    static constexpr size_t statusMessageLength = statusMessage + statusMessageMaxLength + 1; // after 1 padding byte
+    static constexpr size_t userStatus = statusMessageLength + 2;
+    static constexpr size_t nospam = userStatus + 1 + 3; // after 3 padding bytes
+    static constexpr size_t lastSeen = nospam + 4;
+    static constexpr size_t size = lastSeen + 8;
+};
+
+static_assert(FriendRecordLayout::size == 2216, "friend record layout");
@@ -0,0 +1,80 @@
+#include "hash.h"
+#include <bit>      // for rotl
+#include "utils.h"  // for loadNumber, Endianness
+
+namespace {
+constexpr uint64_t prime1 = 11400714785074694791ULL;
+constexpr uint64_t prime2 = 14029467366897019727ULL;
+constexpr uint64_t prime3 = 1609587929392839161ULL;
+constexpr uint64_t prime4 = 9650029242287828579ULL;
+constexpr uint64_t prime5 = 2870177450012600261ULL;
+
+uint64_t lane(uint64_t accumulator, uint64_t input)
+{
+    accumulator += input * prime2;
+    return std::rotl(accumulator, 31) * prime1;
+}
+
+uint64_t mergeRound(uint64_t hash, uint64_t accumulator)
+{
+    hash ^= lane(0, accumulator);
+    return hash * prime1 + prime4;
+}
+
+uint64_t read64(const uint8_t* data)
+{
+    return loadNumber<Endianness::little, uint64_t>(data);
+}
+}
+
+uint64_t hashBytes(const uint8_t* data, size_t length, uint64_t seed)
+{
+    const uint8_t* const end = data + length;
+    uint64_t hash;
+
+    if (length >= 32) {
+        // four independent lanes over 32 byte stripes
+        uint64_t v1 = seed + prime1 + prime2;
+        uint64_t v2 = seed + prime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - prime1;
+        const uint8_t* const lastStripe = end - 32;
+        do {
+            v1 = lane(v1, read64(data));
+            v2 = lane(v2, read64(data + 8));
+            v3 = lane(v3, read64(data + 16));
+            v4 = lane(v4, read64(data + 24));
+            data += 32;
+        } while (data <= lastStripe);
+
+        hash = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+        hash = mergeRound(hash, v1);
+        hash = mergeRound(hash, v2);
+        hash = mergeRound(hash, v3);
+        hash = mergeRound(hash, v4);
+    } else {
+        hash = seed + prime5;
+    }
+    hash += length;
+
+    for (; end - data >= 8; data += 8) {
+        hash ^= lane(0, read64(data));
+        hash = std::rotl(hash, 27) * prime1 + prime4;
+    }
+    if (end - data >= 4) {
+        hash ^= loadNumber<Endianness::little, uint32_t>(data) * prime1;
+        hash = std::rotl(hash, 23) * prime2 + prime3;
+        data += 4;
+    }
+    for (; data < end; ++data) {
+        hash ^= *data * prime5;
+        hash = std::rotl(hash, 11) * prime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime3;
+    hash ^= hash >> 32;
+    return hash;
+}
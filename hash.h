@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstddef>  // for size_t
+#include <cstdint>  // for uint8_t, uint64_t
+
+// XXH64 of data. Not cryptographic: meant for telling apart changed and unchanged sections quickly, at several GB/s.
+uint64_t hashBytes(const uint8_t* data, size_t length, uint64_t seed = 0);
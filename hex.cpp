@@ -0,0 +1,139 @@
+#include "hex.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>  // for __m256i, _mm256_*
+#include <emmintrin.h>  // for __m128i, _mm_*
+#define TOXSAVE_HEX_X86 1
+#endif
+
+namespace {
+struct HexTable {
+    char digits[256][2];
+
+    constexpr HexTable()
+        : digits()
+    {
+        constexpr char hex[] = "0123456789ABCDEF";
+        for (int i = 0; i < 256; ++i) {
+            digits[i][0] = hex[i >> 4];
+            digits[i][1] = hex[i & 0xf];
+        }
+    }
+};
+
+constexpr HexTable hexTable;
+
+#ifdef TOXSAVE_HEX_X86
+// nibble -> '0'..'9', 'A'..'F': add '0', plus 7 more for the letters
+__attribute__((target("sse2")))
+inline __m128i nibblesToAscii(__m128i nibbles)
+{
+    const __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)), _mm_set1_epi8('A' - '0' - 10));
+    return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letters);
+}
+
+__attribute__((target("sse2")))
+char* hexEncodeSse2(const uint8_t* data, size_t length, char* out)
+{
+    const __m128i lowMask = _mm_set1_epi8(0x0f);
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        const __m128i high = nibblesToAscii(_mm_and_si128(_mm_srli_epi16(bytes, 4), lowMask));
+        const __m128i low = nibblesToAscii(_mm_and_si128(bytes, lowMask));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi8(high, low));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16), _mm_unpackhi_epi8(high, low));
+        out += 32;
+    }
+    return hexEncodeScalar(data + i, length - i, out);
+}
+
+__attribute__((target("avx2")))
+char* hexEncodeAvx2(const uint8_t* data, size_t length, char* out)
+{
+    const __m256i lowMask = _mm256_set1_epi8(0x0f);
+    const __m256i nine = _mm256_set1_epi8(9);
+    const __m256i zero = _mm256_set1_epi8('0');
+    const __m256i letterOffset = _mm256_set1_epi8('A' - '0' - 10);
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i high = _mm256_and_si256(_mm256_srli_epi16(bytes, 4), lowMask);
+        __m256i low = _mm256_and_si256(bytes, lowMask);
+        high = _mm256_add_epi8(_mm256_add_epi8(high, zero), _mm256_and_si256(_mm256_cmpgt_epi8(high, nine), letterOffset));
+        low = _mm256_add_epi8(_mm256_add_epi8(low, zero), _mm256_and_si256(_mm256_cmpgt_epi8(low, nine), letterOffset));
+        // unpack works within 128 bit lanes, so the halves come out as bytes 0-7|16-23 and 8-15|24-31
+        const __m256i first = _mm256_unpacklo_epi8(high, low);
+        const __m256i second = _mm256_unpackhi_epi8(high, low);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 32), _mm256_permute2x128_si256(first, second, 0x31));
+        out += 64;
+    }
+    return hexEncodeSse2(data + i, length - i, out);
+}
+#endif
+
+HexEncoder pickHexEncoder()
+{
+    if (auto avx2 = hexEncoderAvx2()) {
+        return avx2;
+    }
+    if (auto sse2 = hexEncoderSse2()) {
+        return sse2;
+    }
+    return hexEncodeScalar;
+}
+}
+
+char* hexEncodeScalar(const uint8_t* data, size_t length, char* out)
+{
+    for (size_t i = 0; i < length; ++i) {
+        out[0] = hexTable.digits[data[i]][0];
+        out[1] = hexTable.digits[data[i]][1];
+        out += 2;
+    }
+    return out;
+}
+
+HexEncoder hexEncoderSse2()
+{
+#ifdef TOXSAVE_HEX_X86
+    // part of the x86-64 baseline, but not of 32 bit x86
+    if (__builtin_cpu_supports("sse2")) {
+        return hexEncodeSse2;
+    }
+#endif
+    return nullptr;
+}
+
+HexEncoder hexEncoderAvx2()
+{
+#ifdef TOXSAVE_HEX_X86
+    if (__builtin_cpu_supports("avx2")) {
+        return hexEncodeAvx2;
+    }
+#endif
+    return nullptr;
+}
+
+const char* hexEncoderName()
+{
+    if (hexEncoderAvx2()) {
+        return "AVX2";
+    }
+    if (hexEncoderSse2()) {
+        return "SSE2";
+    }
+    return "scalar";
+}
+
+char* hexEncode(const uint8_t* data, size_t length, char* out)
+{
+    static const HexEncoder bestHexEncoder = pickHexEncoder();
+
+    // short inputs (nospam) aren't worth the call through the pointer
+    if (length < 16) {
+        return hexEncodeScalar(data, length, out);
+    }
+    return bestHexEncoder(data, length, out);
+}
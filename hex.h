@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>  // for size_t
+#include <cstdint>  // for uint8_t
+
+// Writes the 2 * length upper case hex digits of data to out (not NUL terminated) and returns the end of them.
+// Picks the widest of AVX2, SSE2 and a table lookup that the CPU supports, once at startup.
+char* hexEncode(const uint8_t* data, size_t length, char* out);
+
+// The individual implementations, exposed for the benchmark. The SIMD ones are null when not compiled in or not
+// supported by the CPU.
+using HexEncoder = char* (*)(const uint8_t* data, size_t length, char* out);
+char* hexEncodeScalar(const uint8_t* data, size_t length, char* out);
+HexEncoder hexEncoderSse2();
+HexEncoder hexEncoderAvx2();
+const char* hexEncoderName();
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>  // for uint32_t, uint64_t
+#include <vector>   // for vector
+#include "hash.h"   // for hashBytes
+
+// Numbers distinct fixed-size records in order of first insertion. Record is a plain struct with a bytes array and an
+// operator==, and the hash passed to insert() has to be hashBytes() of those bytes.
+//
+// Open addressing with linear probing over slots that hold a row and 32 bits of its hash, so most mismatches are
+// rejected without touching the row. Kept at most 70% full, it costs about 12 bytes per record on top of the rows
+// themselves.
+template <typename Record>
+class InternTable {
+public:
+    // Returns the row of record, adding it if it's new.
+    uint32_t insert(const Record& record, uint64_t hash)
+    {
+        if ((records.size() + 1) * 10 > slots.size() * 7) {
+            grow();
+        }
+        const size_t mask = slots.size() - 1;
+        const auto tag = static_cast<uint32_t>(hash >> 32);
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            Slot& slot = slots[i];
+            if (slot.row == 0) {
+                records.push_back(record);
+                slot = {tag, static_cast<uint32_t>(records.size())};
+                return slot.row - 1;
+            }
+            if (slot.tag == tag && records[slot.row - 1] == record) {
+                return slot.row - 1;
+            }
+        }
+    }
+
+    const std::vector<Record>& rows() const { return records; }
+
+private:
+    struct Slot {
+        uint32_t tag;
+        uint32_t row; // row + 1, 0 for an empty slot
+    };
+
+    void grow()
+    {
+        std::vector<Slot> larger(slots.empty() ? 1024 : slots.size() * 2, Slot{0, 0});
+        const size_t mask = larger.size() - 1;
+        for (uint32_t row = 0; row < records.size(); ++row) {
+            const uint64_t hash = hashBytes(records[row].bytes, sizeof(records[row].bytes));
+            size_t i = hash & mask;
+            while (larger[i].row != 0) {
+                i = (i + 1) & mask;
+            }
+            larger[i] = {static_cast<uint32_t>(hash >> 32), row + 1};
+        }
+        slots.swap(larger);
+    }
+
+    std::vector<Slot> slots;
+    std::vector<Record> records;
+};
@@ -0,0 +1,267 @@
+#include "jsonwriter.h"
+#include <stdio.h>         // for snprintf
+#include <string.h>        // for memset, strlen
+#include <time.h>          // for localtime_r, time_t, tm
+#include <charconv>        // for to_chars
+#include <utility>         // for move
+#include "hex.h"           // for hexEncode
+#include "outputbuffer.h"  // for OutputBuffer
+#include "utils.h"         // for utf8SequenceLength
+
+namespace {
+bool needsEscaping(unsigned char c)
+{
+    return c < 0x20 || c == '"' || c == '\\' || c >= 0x80;
+}
+
+char* writeDigits(char* out, int value, int width)
+{
+    for (int i = width - 1; i >= 0; --i) {
+        out[i] = '0' + value % 10;
+        value /= 10;
+    }
+    return out + width;
+}
+}
+
+JsonWriter::JsonWriter(OutputBuffer& out, bool indented, size_t depth)
+    : out(out)
+    , indented(indented)
+    , baseDepth(depth)
+{
+}
+
+JsonWriter::~JsonWriter() = default;
+
+JsonWriter::JsonWriter(std::unique_ptr<OutputBuffer> buffer, bool indented, size_t depth)
+    : ownBuffer(std::move(buffer))
+    , out(*ownBuffer)
+    , indented(indented)
+    , baseDepth(depth)
+{
+}
+
+void JsonWriter::beginObject()
+{
+    beginContainer('{');
+}
+
+void JsonWriter::endObject()
+{
+    endContainer('}');
+}
+
+void JsonWriter::beginArray()
+{
+    beginContainer('[');
+}
+
+void JsonWriter::endArray()
+{
+    endContainer(']');
+}
+
+void JsonWriter::key(const char* name)
+{
+    if (hasMembers.back()) {
+        out.append(indented ? ",\n" : ",", indented ? 2 : 1);
+    }
+    hasMembers.back() = true;
+    indent(baseDepth + hasMembers.size());
+    out.append('"');
+    escaped(name, strlen(name));
+    out.append(indented ? "\": " : "\":", indented ? 3 : 2);
+    afterKey = true;
+}
+
+void JsonWriter::string(const char* data, size_t length)
+{
+    beginValue();
+    out.append('"');
+    escaped(data, length);
+    out.append('"');
+}
+
+void JsonWriter::number(int64_t value)
+{
+    beginValue();
+    char* const start = out.reserve(24);
+    out.commit(std::to_chars(start, start + 24, value).ptr - start);
+}
+
+void JsonWriter::hex(const uint8_t* data, size_t length)
+{
+    beginValue();
+    char* const start = out.reserve(length * 2 + 2);
+    char* pos = start;
+    *pos++ = '"';
+    pos = hexEncode(data, length, pos);
+    *pos++ = '"';
+    out.commit(pos - start);
+}
+
+void JsonWriter::timestamp(uint64_t secondsSinceEpoch)
+{
+    beginValue();
+
+    // same as QDateTime::toString(Qt::ISODate) for local time: yyyy-MM-ddTHH:mm:ss
+    const time_t time = static_cast<time_t>(secondsSinceEpoch);
+    struct tm local = {};
+    localtime_r(&time, &local);
+    const int year = local.tm_year + 1900;
+
+    char* const start = out.reserve(64);
+    char* pos = start;
+    *pos++ = '"';
+    if (year >= 0 && year <= 9999) {
+        pos = writeDigits(pos, year, 4);
+        *pos++ = '-';
+        pos = writeDigits(pos, local.tm_mon + 1, 2);
+        *pos++ = '-';
+        pos = writeDigits(pos, local.tm_mday, 2);
+        *pos++ = 'T';
+        pos = writeDigits(pos, local.tm_hour, 2);
+        *pos++ = ':';
+        pos = writeDigits(pos, local.tm_min, 2);
+        *pos++ = ':';
+        pos = writeDigits(pos, local.tm_sec, 2);
+    } else {
+        pos += snprintf(pos, 60, "%d-%02d-%02dT%02d:%02d:%02d", year, local.tm_mon + 1, local.tm_mday,
+                        local.tm_hour, local.tm_min, local.tm_sec);
+    }
+    *pos++ = '"';
+    out.commit(pos - start);
+}
+
+void JsonWriter::raw(const char* json, size_t length)
+{
+    beginValue();
+    out.append(json, length);
+}
+
+std::unique_ptr<Writer> JsonWriter::fork(size_t nested) const
+{
+    // starts out inside an array of its own at the depth of the one it's spliced into, so its elements are formatted
+    // the same way and only the separator before the first one is left to splice()
+    const size_t depth = baseDepth + hasMembers.size() - 1 + nested;
+    std::unique_ptr<JsonWriter> forked(new JsonWriter(std::make_unique<OutputBuffer>(-1, 64 * 1024), indented, depth));
+    forked->hasMembers.push_back(false);
+    return forked;
+}
+
+void JsonWriter::splice(Writer& fork)
+{
+    auto& forked = static_cast<JsonWriter&>(fork);
+    if (!forked.hasMembers.front()) {
+        return;
+    }
+    if (hasMembers.back()) {
+        out.append(indented ? ",\n" : ",", indented ? 2 : 1);
+    }
+    hasMembers.back() = true;
+    out.append(forked.out.data(), forked.out.size());
+}
+
+void JsonWriter::beginValue()
+{
+    if (afterKey) {
+        afterKey = false;
+        return;
+    }
+    if (hasMembers.empty()) {
+        return; // document root
+    }
+
+    // array element
+    if (hasMembers.back()) {
+        out.append(indented ? ",\n" : ",", indented ? 2 : 1);
+    }
+    hasMembers.back() = true;
+    indent(baseDepth + hasMembers.size());
+}
+
+void JsonWriter::beginContainer(char open)
+{
+    beginValue();
+    out.append(open);
+    if (indented) {
+        out.append('\n');
+    }
+    hasMembers.push_back(false);
+}
+
+void JsonWriter::endContainer(char close)
+{
+    const bool hadMembers = hasMembers.back();
+    hasMembers.pop_back();
+    if (indented && hadMembers) {
+        out.append('\n');
+    }
+    indent(baseDepth + hasMembers.size());
+    out.append(close);
+    if (indented && hasMembers.empty() && baseDepth == 0) {
+        out.append('\n');
+    }
+}
+
+void JsonWriter::indent(size_t depth)
+{
+    if (!indented) {
+        return;
+    }
+    memset(out.reserve(depth * 4), ' ', depth * 4);
+    out.commit(depth * 4);
+}
+
+void JsonWriter::escaped(const char* data, size_t length)
+{
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+    size_t i = 0;
+    while (i < length) {
+        // copy the plain run in one go
+        size_t run = i;
+        while (run < length && !needsEscaping(bytes[run])) {
+            ++run;
+        }
+        out.append(data + i, run - i);
+        i = run;
+        if (i == length) {
+            break;
+        }
+
+        const unsigned char c = bytes[i];
+        if (c >= 0x80) {
+            const auto sequence = utf8SequenceLength(bytes + i, length - i);
+            if (sequence == 0) {
+                out.append("\xEF\xBF\xBD", 3); // U+FFFD
+                ++i;
+            } else {
+                out.append(data + i, sequence);
+                i += sequence;
+            }
+            continue;
+        }
+
+        char escape[6] = {'\\', 0, 0, 0, 0, 0};
+        size_t escapeLength = 2;
+        switch (c) {
+        case '"': escape[1] = '"'; break;
+        case '\\': escape[1] = '\\'; break;
+        case '\b': escape[1] = 'b'; break;
+        case '\f': escape[1] = 'f'; break;
+        case '\n': escape[1] = 'n'; break;
+        case '\r': escape[1] = 'r'; break;
+        case '\t': escape[1] = 't'; break;
+        default:
+            // QJsonDocument uses lower case here
+            escape[1] = 'u';
+            escape[2] = '0';
+            escape[3] = '0';
+            escape[4] = "0123456789abcdef"[c >> 4];
+            escape[5] = "0123456789abcdef"[c & 0xf];
+            escapeLength = 6;
+        }
+        out.append(escape, escapeLength);
+        ++i;
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>  // for size_t
+#include <cstdint>  // for int64_t, uint8_t, uint64_t
+#include <memory>   // for unique_ptr
+#include <vector>   // for vector
+#include "writer.h"
+
+class OutputBuffer;
+
+// Writes JSON straight into an OutputBuffer, formatted the same way as QJsonDocument::toJson() (Indented or
+// Compact), except that members keep the order of the save instead of being sorted by key.
+class JsonWriter : public Writer {
+public:
+    // With depth > 0 the output is a value nested that deep in an indented document rather than a document of its own.
+    JsonWriter(OutputBuffer& out, bool indented, size_t depth = 0);
+    ~JsonWriter() override;
+
+    void beginObject() override;
+    void endObject() override;
+    void beginArray() override;
+    void endArray() override;
+    void key(const char* name) override;
+    void string(const char* data, size_t length) override;
+    void number(int64_t value) override;
+    void hex(const uint8_t* data, size_t length) override;
+    void timestamp(uint64_t secondsSinceEpoch) override;
+    using Writer::string;
+    std::unique_ptr<Writer> fork(size_t nested = 0) const override;
+    void splice(Writer& fork) override;
+
+    // Writes a value that a JsonWriter with the same settings already serialized at this depth.
+    void raw(const char* json, size_t length);
+
+private:
+    // A fork writes into a buffer of its own.
+    JsonWriter(std::unique_ptr<OutputBuffer> buffer, bool indented, size_t depth);
+
+    void beginValue();
+    void beginContainer(char open);
+    void endContainer(char close);
+    void indent(size_t depth);
+    void escaped(const char* data, size_t length);
+
+    std::unique_ptr<OutputBuffer> ownBuffer; // only set in forks, out refers to it
+    OutputBuffer& out;
+    const bool indented;
+    const size_t baseDepth;
+    bool afterKey = false;
+    std::vector<bool> hasMembers; // one per open object/array
+};
@@ -1,388 +1,438 @@
 #include <bits/exception.h>      // for exception
+#include <errno.h>               // for errno
 #include <fcntl.h>               // for open, O_RDONLY
-#include <qbytearray.h>          // for QByteArray
-#include <qcommandlineparser.h>  // for QCommandLineParser
-#include <qcoreapplication.h>    // for QCoreApplication
-#include <qdatetime.h>           // for QDateTime
-#include <qglobal.h>             // for qSwap
-#include <qjsonarray.h>          // for QJsonArray
-#include <qjsondocument.h>       // for QJsonDocument, QJsonDocument::Indented
-#include <qjsonobject.h>         // for QJsonObject
-#include <qjsonvalue.h>          // for QJsonValue
-#include <qnamespace.h>          // for ISODate
-#include <qstring.h>             // for QString
-#include <qstringlist.h>         // for QStringList
-#include <qtconcurrentmap.h>     // for blockingMappedReduced
-#include <stdio.h>               // for perror, fprintf, sprintf, stderr
-#include <stdlib.h>              // for exit, EXIT_FAILURE
-#include <sys/mman.h>            // for mmap, munmap, MAP_FAILED, MAP_SHARED
-#include <sys/stat.h>            // for stat, fstat, mode_t
-#include <unistd.h>              // for close
-#include <cstdint>               // for uint8_t, uint16_t, uint32_t, uint64_t
+#include <stdlib.h>              // for EXIT_FAILURE, EXIT_SUCCESS, strtoul
+#include <string.h>              // for strerror
+#include <unistd.h>              // for close, STDIN_FILENO
+#include <filesystem>            // for is_directory
 #include <iostream>              // for endl, operator<<, basic_ostream, ost...
-#include <iterator>              // for advance
-#include <stdexcept>             // for runtime_error, invalid_argument
+#include <memory>                // for unique_ptr
+#include <optional>              // for optional
+#include <sstream>               // for istringstream
+#include <stdexcept>             // for invalid_argument
 #include <string>                // for string, operator<<
+#include <utility>               // for move
 #include <vector>                // for vector
-#include "nodeinfo.h"            // for getNodeInfos
-#include "sections.h"            // for SectionHeader, SectionType, sectionT...
-#include "utils.h"               // for dataToNumber, readString, readHexData
-
-enum class DhtSection {
-    nodes = 4
-};
-
-DhtSection getDhtSectionType(uint8_t*& data)
+#include "batch.h"               // for collectProfilePaths, runBatch, printB...
+#include "commandline.h"         // for CommandLineParser, CommandLineOption
+#include "cursor.h"              // for Cursor
+#include "encryptedsave.h"       // for DecryptedSave, KeyCache, openSave, readPassphrase
+#include "executionplan.h"       // for executionPolicyFromString, setExecutionPolicy
+#include "friendgraph.h"         // for buildFriendGraph, printFriendGraphSummary
+#include "jsonwriter.h"          // for JsonWriter
+#include "mappedfile.h"          // for MappedFile
+#include "nodeexport.h"          // for exportNodes, printNodeExportSummary
+#include "output.h"              // for OutputOptions, writeProfileOutput
+#include "outputbuffer.h"        // for OutputBuffer
+#include "profile.h"             // for Profile
+#include "profilecache.h"        // for ProfileCache
+#include "profilediff.h"         // for writeProfileDiff
+#include "selection.h"           // for Selection
+#include "serve.h"               // for runServe
+#include "shrink.h"              // for ShrinkOptions, shrinkProfiles, printShrinkSummary
+#include "stats.h"               // for StatsReport, StatsScope, statsAvailable
+#include "streaminput.h"         // for runTarStream, writeStreamedProfile
+#include "threadpool.h"          // for ThreadPool
+#include "watch.h"               // for runWatch
+
+namespace {
+bool parseCount(const std::string& value, size_t& count)
 {
-    static const uint16_t dhtInnerSectionHeader = 0x11ce;
-    auto sectionVal = dataToNumber<uint16_t>(data);
-    auto header = dataToNumber<uint16_t>(data);
-
-    if (header != dhtInnerSectionHeader) {
-        throw std::runtime_error("Couldn't parse DHT state cookie.");
-    }
-    return static_cast<DhtSection>(sectionVal);
+    char* end = nullptr;
+    count = strtoul(value.c_str(), &end, 10);
+    return !value.empty() && value[0] != '-' && !*end;
 }
 
-void addDataToArray(uint8_t*& data, int size, QJsonArray& node)
-{
-    std::vector<char> hexString(size*2, 0);
-
-    for (int i = 0; i < size; ++i)
+// A mapped (and if need be decrypted) save with its section table.
+struct Snapshot {
+    Snapshot(const std::string& path, const std::optional<std::string>& passphrase, KeyCache& keys)
+        : path(path)
+        , file(path)
     {
-        sprintf(hexString.data()+i*2, "%02X", data[0]);
-        data++;
+        const auto contents = openSave(file.data(), file.size(), passphrase, keys, decrypted);
+        profile.reset(new Profile(contents.data(), contents.remaining()));
     }
 
-    std::string str(hexString.begin(), hexString.end());
-    node.append(str.c_str());
-}
-
-QJsonObject getNoSpamKeys(uint8_t*& data)
-{
-    QJsonObject node;
-    node.insert("Nospam", readHexData(data, 4).c_str());
-    node.insert("Long term public key", readHexData(data, 32).c_str());
-    node.insert("Long term secret key", readHexData(data, 32).c_str());
-    return node;
-}
+    std::string path;
+    MappedFile file;
+    std::unique_ptr<DecryptedSave> decrypted;
+    std::unique_ptr<Profile> profile;
+};
 
-QJsonArray getDhtSection(uint8_t*& data)
+// Diffs each snapshot against the one before it, so a whole history can be given at once. Every save is only mapped
+// once, and sections that hash the same as in the previous snapshot aren't decoded.
+int runDiff(const std::vector<std::string>& paths, bool indented, const std::optional<std::string>& passphrase)
 {
-    DhtSection sectionType;
-    uint32_t sectionSize;
-
-    sectionSize = dataToNumber<uint32_t>(data);
-    sectionType = getDhtSectionType(data);
-    uint8_t* const startOfSection = data;
-    QJsonArray nodes;
-
-    switch (sectionType)
-    {
-    case DhtSection::nodes:
-        nodes = getNodeInfos(data, sectionSize);
-        break;
-    default:
-        throw std::runtime_error("Unknown DHT section");
+    if (paths.size() < 2) {
+        std::cerr << "--diff needs at least two profiles." << std::endl;
+        return EXIT_FAILURE;
     }
 
-    if ((data - startOfSection) != sectionSize)
-    {
-        throw std::runtime_error("Section isn't the expected size.");
+    KeyCache keys;
+    OutputBuffer out(1);
+    std::unique_ptr<Snapshot> previous;
+    try {
+        previous.reset(new Snapshot(paths.front(), passphrase, keys));
+        for (size_t i = 1; i < paths.size(); ++i) {
+            std::unique_ptr<Snapshot> current(new Snapshot(paths[i], passphrase, keys));
+
+            JsonWriter writer(out, indented);
+            writer.beginObject();
+            writer.key("From");
+            writer.string(previous->path);
+            writer.key("To");
+            writer.string(current->path);
+            writer.key("Changes");
+            writeProfileDiff(*previous->profile, *current->profile, writer);
+            writer.endObject();
+            out.append('\n');
+
+            previous = std::move(current);
+        }
     }
-
-    return nodes;
-}
-
-QJsonArray getDht(uint8_t*& data)
-{
-    QJsonObject node;
-    const static uint32_t dhtSectionHeader = 0x0159000d;
-
-    auto dhtStateCookie = dataToNumber<uint32_t>(data);
-    if (dhtStateCookie != dhtSectionHeader) {
-        throw std::invalid_argument("Invalid DHT section header");
+    catch (const std::exception& e) {
+        out.flush();
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
     }
-
-    return getDhtSection(data);
-}
-
-QJsonObject getConferencePeer(uint8_t*& data)
-{
-    QJsonObject node;
-    node.insert("Long term public key", readHexData(data, 32).c_str());
-    node.insert("DHT public key", readHexData(data, 32).c_str());
-    node.insert("Peer number", dataToNumber<uint16_t>(data));
-
-    uint64_t timeStamp = dataToNumber<uint64_t>(data);;
-    QDateTime timestamp;
-    timestamp.setTime_t(timeStamp);
-    node.insert("Last active timestamp", timestamp.toString(Qt::ISODate).toLocal8Bit().constData());
-
-    int nickLen = data[0];
-    node.insert("Name length", nickLen);
-    data++;
-
-    node.insert("Name", readString(data, nickLen).c_str());
-    return node;
+    return EXIT_SUCCESS;
 }
 
-QJsonObject getConference(uint8_t*& data)
+// Audits every profile in the tar archives, "-" reading one from stdin.
+int runTarArchives(const std::vector<std::string>& archives, const OutputOptions& options)
 {
-    QJsonObject node;
-    node.insert("Groupchat type", data[0]);
-    data += 1;
-    node.insert("Groupchat id", readHexData(data, 32).c_str());
-    node.insert("Message number", static_cast<int>(dataToNumber<uint32_t>(data)));
-    node.insert("Lossy message number", dataToNumber<uint16_t>(data));
-    node.insert("Peer number", dataToNumber<uint16_t>(data));\
-
-    auto numPeers = dataToNumber<int>(data);
-    node.insert("Number of peers", static_cast<int>(numPeers));
-
-    int titleLen = data[0];
-    node.insert("Title length", titleLen);
-    data += 1;
-
-    node.insert("Title", readString(data, titleLen).c_str());
-
-    QJsonArray peers;
-    for (int i = 0; i < numPeers; ++i) {
-        peers.append(getConferencePeer(data));
+    BatchResult total;
+    for (const auto& archive : archives) {
+        const bool fromStdin = archive == "-";
+        const int fd = fromStdin ? STDIN_FILENO : open(archive.c_str(), O_RDONLY);
+        if (fd == -1) {
+            std::cerr << "Error opening " << archive << ": " << strerror(errno) << std::endl;
+            ++total.files;
+            ++total.failed;
+            continue;
+        }
+        const auto result = runTarStream(fd, fromStdin ? "stdin" : archive, options);
+        if (!fromStdin) {
+            close(fd);
+        }
+        total.files += result.files;
+        total.failed += result.failed;
+        total.bytes += result.bytes;
+        total.seconds += result.seconds;
     }
-    node.insert("List of peers", peers);
-
-    return node;
+    printBatchSummary(total, std::cerr);
+    return total.failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
-std::string getStatus(uint8_t*& data)
+void printStats(const StatsReport& stats, bool indented)
 {
-    auto status = static_cast<UserStatus>(data[0]);
-    data++;
-    return userStatusToString(status);
+    OutputBuffer out(2);
+    JsonWriter writer(out, indented);
+    stats.write(writer, ThreadPool::global().maxThreadCount());
+    out.append('\n');
 }
-
-void addFriend(uint8_t*& data, QJsonObject& node)
-{
-    node.insert("Status", FriendStatusToString(static_cast<FriendStatus>(dataToNumber<uint8_t>(data))).c_str());
-    node.insert("Long term public key", readHexData(data, 32).c_str());
-
-    auto friendRequestInfoStart = data;
-    static const int friendRequestMessageMaxLength = 1024;
-    data += friendRequestMessageMaxLength;
-    ++data; // padding
-
-    auto infoSize = dataToNumber<uint16_t>(data, Endianness::big);
-    node.insert("Size of the friend request message", infoSize);
-    node.insert("Friend request message as a byte string", readString(friendRequestInfoStart, infoSize).c_str());
-
-    auto nameStart = data;
-    static const int nameMaxLength = 128;
-    data += nameMaxLength;
-
-    auto nameLength = dataToNumber<uint16_t>(data, Endianness::big);
-    node.insert("Size of the name", nameLength);
-    node.insert("Name as a byte string", readString(nameStart, nameLength).c_str());
-
-    auto statusMessageStart = data;
-    static const int statusMessageMaxLength = 1007;
-    data += statusMessageMaxLength;
-    data++; // padding
-
-    auto statusMessageLength = dataToNumber<uint16_t>(data, Endianness::big);
-    node.insert("Size of the status message", statusMessageLength);
-    node.insert("Status message as a byte string", readString(statusMessageStart, statusMessageLength).c_str());
-
-    node.insert("User status", getStatus(data).c_str());
-    data += 3; // padding
-
-    node.insert("Nospam (only used for sending a friend request)", readHexData(data, 4).c_str());
-
-    QDateTime timestamp;
-    timestamp.setTime_t(dataToNumber<uint64_t>(data, Endianness::big));
-    node.insert("Last seen time", timestamp.toString(Qt::ISODate).toLocal8Bit().constData());
 }
 
-QJsonArray getFriends(uint8_t*& data, int sectionSize)
+int main(int argc, char** argv)
 {
-    uint8_t* const initialPoint = data;
-
-    QJsonArray friends;
-    while ((data - initialPoint) < sectionSize)
-    {
-        QJsonObject friendJson;
-        addFriend(data, friendJson);
-        friends.append(friendJson);
+    CommandLineParser parser;
+    parser.setApplicationDescription("Test helper");
+    parser.addHelpOption();
+    parser.addPositionalArgument("profile.tox", "Tox profiles or directories of profiles to parse, or - to decode one profile from stdin as it arrives.", "[profile.tox...]");
+    CommandLineOption stdinOption("stdin", "Also parse the newline-separated profile paths read from stdin.");
+    parser.addOption(stdinOption);
+    CommandLineOption formatOption("format", "Output format: json (streamed, save order), qjson (sorted keys, as QJsonDocument), cbor or msgpack.", "format", "json");
+    parser.addOption(formatOption);
+    CommandLineOption compactOption("compact", "Print compact instead of indented JSON.");
+    parser.addOption(compactOption);
+    CommandLineOption passphraseFileOption("passphrase-file", "Decrypt encrypted profiles with the passphrase on the first line of file (default: $TOXSAVE_PASSPHRASE).", "file");
+    parser.addOption(passphraseFileOption);
+    CommandLineOption diffOption("diff", "Print what changed between consecutive profiles instead of parsing them.");
+    parser.addOption(diffOption);
+    CommandLineOption cacheOption("cache", "Keep decoded profiles in directory and only decode what changed since the last run (json format).", "directory");
+    parser.addOption(cacheOption);
+    CommandLineOption watchOption("watch", "Keep running and print the sections that changed whenever a profile is saved.");
+    parser.addOption(watchOption);
+    CommandLineOption exportNodesOption("export-nodes", "Write the deduplicated DHT, TCP relay and path nodes of all profiles as column files into directory instead of printing JSON.", "directory");
+    parser.addOption(exportNodesOption);
+    CommandLineOption friendGraphOption("friend-graph", "Write the friend and conference peer graph of all profiles as column files into directory and print statistics about it instead of JSON.", "directory");
+    parser.addOption(friendGraphOption);
+    CommandLineOption salvageOption("salvage", "Search damaged profiles for every section that still decodes, and list the byte ranges skipped.");
+    parser.addOption(salvageOption);
+    CommandLineOption shrinkOption("shrink", "Rewrite the profiles in place without duplicate nodes (and the sections and nodes dropped by the options below) instead of printing JSON.");
+    parser.addOption(shrinkOption);
+    CommandLineOption maxNodesOption("max-nodes", "With --shrink, keep at most n nodes in each DHT, TCP relay and path node list.", "n");
+    parser.addOption(maxNodesOption);
+    CommandLineOption dropSectionsOption("drop-sections", "With --shrink, drop the comma-separated sections, named as in the output (\"Unknown Section\" for all unknown ones).", "names");
+    parser.addOption(dropSectionsOption);
+    CommandLineOption dropEmptyOption("drop-empty", "With --shrink, drop empty sections.");
+    parser.addOption(dropEmptyOption);
+    CommandLineOption statsOption("stats", "Print the time, allocations and thread pool use of each stage and section type as JSON on stderr.");
+    parser.addOption(statsOption);
+    CommandLineOption selectOption("select", "Only decode and print the fields on path, e.g. \"Friends[].Long term public key\". Can be given more than once, or with several comma-separated paths.", "path");
+    parser.addOption(selectOption);
+    CommandLineOption tarOption("tar", "Read the inputs as uncompressed tar archives (- for stdin) and parse every profile in them in one pass, without unpacking.");
+    parser.addOption(tarOption);
+    CommandLineOption threadsOption("threads", "Use at most n threads, counting the main thread (default: one per core).", "n");
+    parser.addOption(threadsOption);
+    CommandLineOption policyOption("policy", "When to decode in parallel: auto (large sections and lists only), serial or parallel (whatever can be split).", "policy", "auto");
+    parser.addOption(policyOption);
+    CommandLineOption serveOption("serve", "Keep running and answer parse requests on the Unix socket at path instead of parsing the given profiles.", "path");
+    parser.addOption(serveOption);
+    CommandLineOption serveCacheOption("serve-cache", "With --serve, keep up to n MiB of answers in memory for unchanged profiles.", "n", "256");
+    parser.addOption(serveCacheOption);
+    parser.process(argc, argv);
+    const bool readStdin = parser.isSet(stdinOption);
+
+    OutputOptions outputOptions;
+    try {
+        outputOptions.format = outputFormatFromString(parser.value(formatOption));
     }
-
-    return friends;
-}
-
-QJsonArray getConferences(uint8_t*& data, int sectionSize)
-{
-    const uint8_t* startPos = data;
-    QJsonArray groups;
-    while (data - startPos < sectionSize)
-    {
-        groups.append(getConference(data));
+    catch (const std::invalid_argument& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
     }
-    return groups;
-}
-
-void parseGlobalHeader(uint8_t*& data)
-{
-    const static uint32_t globalHeader1 = 0x0;
-    const static uint32_t globalHeader2 = 0x15ed1b1f;
-
-    if (globalHeader1 != dataToNumber<uint32_t>(data) || globalHeader2 != dataToNumber<uint32_t>(data)) {
-        throw std::runtime_error("Couldn't parse global header. Is this a tox save?");
+    outputOptions.indented = !parser.isSet(compactOption);
+    outputOptions.salvage = parser.isSet(salvageOption);
+
+    if (parser.isSet(threadsOption)) {
+        size_t threads = 0;
+        if (!parseCount(parser.value(threadsOption), threads) || threads == 0) {
+            std::cerr << "--threads needs a positive number." << std::endl;
+            return EXIT_FAILURE;
+        }
+        ThreadPool::global().setMaxThreadCount(threads);
     }
-}
-
-uint8_t* mapFile(std::string profileLocation, struct stat& fileInfo, int& fd)
-{
-    fd = open(profileLocation.c_str(), O_RDONLY, (mode_t)0600);
-
-    if (fd == -1)
-    {
-        perror("Error opening file for writing");
-        exit(EXIT_FAILURE);
+    try {
+        setExecutionPolicy(executionPolicyFromString(parser.value(policyOption)));
     }
-
-    fileInfo = {};
-
-    if (fstat(fd, &fileInfo) == -1)
-    {
-        perror("Error getting the file size");
-        exit(EXIT_FAILURE);
+    catch (const std::invalid_argument& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
     }
 
-    if (fileInfo.st_size == 0)
-    {
-        fprintf(stderr, "Error: File is empty, nothing to do\n");
-        exit(EXIT_FAILURE);
+    std::unique_ptr<Selection> selection;
+    if (parser.isSet(selectOption)) {
+        if (parser.isSet(diffOption) || parser.isSet(watchOption) || parser.isSet(exportNodesOption)
+            || parser.isSet(friendGraphOption) || parser.isSet(shrinkOption) || parser.isSet(salvageOption)) {
+            std::cerr << "--select can't be combined with --diff, --watch, --export-nodes, --friend-graph, --shrink "
+                         "or --salvage."
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+        try {
+            selection.reset(new Selection);
+            for (const auto& paths : parser.values(selectOption)) {
+                selection->add(paths);
+            }
+        }
+        catch (const std::invalid_argument& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+        outputOptions.selection = selection.get();
     }
 
-    uint8_t* const map = static_cast<uint8_t*>(mmap(0, fileInfo.st_size, PROT_READ, MAP_SHARED, fd, 0));
-    if (map == MAP_FAILED)
-    {
-        close(fd);
-        perror("Error mmapping the file");
-        exit(EXIT_FAILURE);
+    std::unique_ptr<StatsReport> stats;
+    if (parser.isSet(statsOption)) {
+        if (!statsAvailable) {
+            std::cerr << "--stats isn't available, this build has TOXSAVE_WITH_STATS turned off." << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (parser.isSet(diffOption) || parser.isSet(watchOption) || parser.isSet(exportNodesOption)
+            || parser.isSet(friendGraphOption) || parser.isSet(shrinkOption)) {
+            std::cerr << "--stats can't be combined with --diff, --watch, --export-nodes, --friend-graph or --shrink."
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+        stats.reset(new StatsReport);
     }
-    return map;
-}
 
-void cleanupFile(uint8_t* map, struct stat fileInfo, int fd)
-{
-    if (munmap(map, fileInfo.st_size) == -1)
-    {
-        close(fd);
-        perror("Error un-mmapping the file");
+    std::optional<std::string> passphrase;
+    try {
+        passphrase = readPassphrase(parser.value(passphraseFileOption));
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
     }
 
-    close(fd);
-}
-
-struct parsedSection {
-    QJsonValue json;
-    SectionHeader header;
-    std::string sectionName;
-};
+    const auto& inputs = parser.positionalArguments();
+
+    if (parser.isSet(serveOption)) {
+        if (!inputs.empty() || readStdin || parser.isSet(diffOption) || parser.isSet(watchOption)
+            || parser.isSet(exportNodesOption) || parser.isSet(friendGraphOption) || parser.isSet(shrinkOption)
+            || parser.isSet(salvageOption) || parser.isSet(cacheOption) || parser.isSet(selectOption)
+            || parser.isSet(statsOption) || parser.isSet(tarOption)) {
+            std::cerr << "--serve takes no profiles and can't be combined with --stdin, --diff, --watch, "
+                         "--export-nodes, --friend-graph, --shrink, --salvage, --cache, --select, --stats or --tar."
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+        size_t cacheMiB = 0;
+        if (!parseCount(parser.value(serveCacheOption), cacheMiB)) {
+            std::cerr << "--serve-cache needs a number." << std::endl;
+            return EXIT_FAILURE;
+        }
+        return runServe(parser.value(serveOption), outputOptions, cacheMiB << 20, passphrase);
+    }
 
-parsedSection convertSectionToJson(SectionHeader sectionHeader)
-{
-    const auto sectionDataStart = sectionHeader.data;
+    if (inputs.empty() && !readStdin) {
+        parser.showHelp();
+    }
 
-    parsedSection ret;
-    ret.header = sectionHeader;
-    ret.sectionName = sectionToString(sectionHeader.type);
+    // decoded as the input arrives rather than from a mapped save
+    const bool streamed = parser.isSet(tarOption) || (inputs.size() == 1 && inputs.front() == "-" && !readStdin);
+    if (streamed) {
+        if (parser.isSet(diffOption) || parser.isSet(watchOption) || parser.isSet(exportNodesOption)
+            || parser.isSet(friendGraphOption) || parser.isSet(shrinkOption) || parser.isSet(salvageOption)
+            || parser.isSet(cacheOption) || parser.isSet(selectOption) || parser.isSet(statsOption) || readStdin) {
+            std::cerr << "Profiles from stdin or --tar can't be combined with --diff, --watch, --export-nodes, "
+                         "--friend-graph, --shrink, --salvage, --cache, --select, --stats or --stdin."
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (outputOptions.format == OutputFormat::qjson) {
+            std::cerr << "Profiles from stdin or --tar can't be sorted, use --format=json." << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (parser.isSet(tarOption)) {
+            return runTarArchives(inputs, outputOptions);
+        }
+        OutputBuffer out(1);
+        try {
+            writeStreamedProfile(STDIN_FILENO, outputOptions, out);
+            out.flush();
+        }
+        catch (const std::exception& e) {
+            // what decoded before the error has already been written, finish that part and report it
+            out.flush();
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
 
-    switch (sectionHeader.type)
-    {
-    case SectionType::nospamkeys:
-        ret.json = getNoSpamKeys(sectionHeader.data);
-        break;
-    case SectionType::dht:
-        ret.json = getDht(sectionHeader.data);
-        break;
-    case SectionType::friends:
-        ret.json = getFriends(sectionHeader.data, sectionHeader.size);
-        break;
-    case SectionType::name:
-        ret.json = readString(sectionHeader.data, sectionHeader.size).c_str();
-        break;
-    case SectionType::statusmessage:
-        ret.json = readString(sectionHeader.data, sectionHeader.size).c_str();
-        break;
-    case SectionType::status:
-        ret.json = getStatus(sectionHeader.data).c_str();
-        break;
-    case SectionType::tcpRelay:
-    case SectionType::pathNode:
-        ret.json = getNodeInfos(sectionHeader.data, sectionHeader.size);
-        break;
-    case SectionType::conferences:
-        ret.json = getConferences(sectionHeader.data, sectionHeader.size);
-        break;
-    default :
-        // unknown section
-        ret.json = static_cast<int>(sectionHeader.type);
-        sectionHeader.data += sectionHeader.size;
+    if (parser.isSet(diffOption)) {
+        return runDiff(inputs, outputOptions.indented, passphrase);
     }
 
-    if (sectionHeader.data - sectionDataStart != sectionHeader.size)
-    {
-        throw std::runtime_error("Section contents didn't match section size.");
+    if (parser.isSet(watchOption)) {
+        return runWatch(inputs, outputOptions.indented, passphrase);
     }
 
-    return ret;
-}
+    if (parser.isSet(exportNodesOption)) {
+        try {
+            const auto result = exportNodes(collectProfilePaths(inputs, readStdin),
+                                            parser.value(exportNodesOption), passphrase);
+            printNodeExportSummary(result, std::cerr);
+            return result.failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
 
-void combineJson(QJsonObject &rootNode, const parsedSection &node)
-{
-    rootNode.insert(sectionToString(node.header.type).c_str(), node.json);
-}
+    if (parser.isSet(friendGraphOption)) {
+        OutputBuffer out(1);
+        try {
+            JsonWriter writer(out, outputOptions.indented);
+            const auto result = buildFriendGraph(collectProfilePaths(inputs, readStdin),
+                                                 parser.value(friendGraphOption), writer, passphrase);
+            out.append('\n');
+            out.flush();
+            printFriendGraphSummary(result, std::cerr);
+            return result.failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        catch (const std::exception& e) {
+            out.clear();
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
 
-int main(int argc, char** argv)
-{
-    QCoreApplication app(argc, argv);
-    QCoreApplication::setApplicationName("ToxSaveParser");
+    if (parser.isSet(shrinkOption)) {
+        ShrinkOptions shrinkOptions;
+        if (parser.isSet(maxNodesOption)
+            && (!parseCount(parser.value(maxNodesOption), shrinkOptions.maxNodes)
+                || shrinkOptions.maxNodes == 0)) {
+            std::cerr << "--max-nodes needs a positive number." << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::istringstream dropSections(parser.value(dropSectionsOption));
+        for (std::string name; std::getline(dropSections, name, ',');) {
+            if (!name.empty()) {
+                shrinkOptions.dropSections.push_back(name);
+            }
+        }
+        shrinkOptions.dropEmpty = parser.isSet(dropEmptyOption);
+        try {
+            const auto result = shrinkProfiles(collectProfilePaths(inputs, readStdin), shrinkOptions);
+            printShrinkSummary(result, std::cerr);
+            return result.failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
 
-    QCommandLineParser parser;
-    parser.setApplicationDescription("Test helper");
-    parser.addHelpOption();
-    parser.addPositionalArgument("profile.tox", QCoreApplication::translate("main", "Tox profile to parse."));
-    parser.process(app);
-    const auto args = parser.positionalArguments();
+    std::unique_ptr<ProfileCache> cache;
+    if (parser.isSet(cacheOption)) {
+        try {
+            cache.reset(new ProfileCache(parser.value(cacheOption)));
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
 
-    if (args.size() != 1) {
-        parser.showHelp();
+    std::error_code error;
+    const bool batchMode = readStdin || inputs.size() > 1 || std::filesystem::is_directory(inputs.front(), error);
+    if (batchMode) {
+        // one profile per line
+        outputOptions.indented = false;
+        const auto result = runBatch(collectProfilePaths(inputs, readStdin), outputOptions, passphrase, cache.get(),
+                                     stats.get());
+        printBatchSummary(result, std::cerr);
+        if (stats) {
+            printStats(*stats, !parser.isSet(compactOption));
+        }
+        return result.failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
     }
 
-    const auto profileLocation = args.at(0).toStdString();
-    struct stat fileInfo;
-    int fd;
+    StatsScope statsScope(stats ? &stats->addProfile() : nullptr);
 
     // map because mmap is fun
-    auto data = mapFile(profileLocation, fileInfo, fd);
-
-    uint8_t* curPlace = data;
+    std::unique_ptr<MappedFile> file;
     try {
-        parseGlobalHeader(curPlace);
-
-        // why map-reduce parsing a 1KB file? https://www.youtube.com/watch?v=b2F-DItXtZs
-        auto sections = getAllSections(curPlace);
-        auto result = QtConcurrent::blockingMappedReduced<QJsonObject>(sections.begin(), sections.end(), convertSectionToJson, combineJson);
-        QJsonDocument doc{result};
-        std::cout << doc.toJson(QJsonDocument::Indented).toStdString() << std::endl;
+        file.reset(new MappedFile(inputs.front()));
     }
     catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
     }
 
-    // TODO: make this RAII
-    cleanupFile(data, fileInfo, fd);
+    OutputBuffer out(1);
+    try {
+        uint64_t size;
+        if (!cache || !cache->write(inputs.front(), outputOptions, out, false, size)) {
+            KeyCache keys;
+            std::unique_ptr<DecryptedSave> decrypted;
+            writeProfileOutput(openSave(file->data(), file->size(), passphrase, keys, decrypted), outputOptions, out);
+        }
+        out.flush();
+    }
+    catch (const std::exception& e) {
+        // drop whatever part of the document hasn't been flushed yet
+        out.clear();
+        std::cerr << e.what() << std::endl;
+    }
 
+    if (stats) {
+        printStats(*stats, outputOptions.indented);
+    }
     return 0;
 }
@@ -0,0 +1,71 @@
+#include "mappedfile.h"
+#include <errno.h>     // for errno
+#include <fcntl.h>     // for open, O_RDONLY
+#include <stdio.h>     // for perror
+#include <string.h>    // for strerror
+#include <sys/mman.h>  // for mmap, munmap, MAP_FAILED, MAP_SHARED
+#include <unistd.h>    // for close
+#include <stdexcept>   // for runtime_error
+#include "stats.h"     // for StageTimer
+
+namespace {
+std::runtime_error systemError(const std::string& what, const std::string& profileLocation)
+{
+    return std::runtime_error(what + " " + profileLocation + ": " + strerror(errno));
+}
+}
+
+uint8_t* mapFile(std::string profileLocation, struct stat& fileInfo, int& fd)
+{
+    StageTimer timer(Stage::open);
+    fd = open(profileLocation.c_str(), O_RDONLY, (mode_t)0600);
+
+    if (fd == -1)
+    {
+        throw systemError("Error opening", profileLocation);
+    }
+
+    fileInfo = {};
+
+    if (fstat(fd, &fileInfo) == -1)
+    {
+        auto error = systemError("Error getting the file size of", profileLocation);
+        close(fd);
+        throw error;
+    }
+
+    if (fileInfo.st_size == 0)
+    {
+        close(fd);
+        throw std::runtime_error("Error: " + profileLocation + " is empty, nothing to do");
+    }
+
+    uint8_t* const map = static_cast<uint8_t*>(mmap(0, fileInfo.st_size, PROT_READ, MAP_SHARED, fd, 0));
+    if (map == MAP_FAILED)
+    {
+        auto error = systemError("Error mmapping", profileLocation);
+        close(fd);
+        throw error;
+    }
+    return map;
+}
+
+void cleanupFile(uint8_t* map, struct stat fileInfo, int fd)
+{
+    if (munmap(map, fileInfo.st_size) == -1)
+    {
+        perror("Error un-mmapping the file");
+    }
+
+    close(fd);
+}
+
+MappedFile::MappedFile(const std::string& profileLocation)
+    : map(mapFile(profileLocation, fileInfo, fd))
+{
+}
+
+MappedFile::~MappedFile()
+{
+    cleanupFile(map, fileInfo, fd);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <sys/stat.h>  // for stat
+#include <cstddef>     // for size_t
+#include <cstdint>     // for uint8_t
+#include <string>      // for string
+
+// Both throw std::runtime_error instead of exiting, so one bad file doesn't take down a batch run.
+uint8_t* mapFile(std::string profileLocation, struct stat& fileInfo, int& fd);
+void cleanupFile(uint8_t* map, struct stat fileInfo, int fd);
+
+// Read-only mapping of a whole profile, unmapped on destruction.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& profileLocation);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    uint8_t* data() const { return map; }
+    size_t size() const { return static_cast<size_t>(fileInfo.st_size); }
+    // from fstat() on the descriptor that was mapped, so it describes these bytes even if the path was replaced since
+    const struct stat& info() const { return fileInfo; }
+
+private:
+    struct stat fileInfo;
+    int fd;
+    uint8_t* map;
+};
@@ -0,0 +1,226 @@
+#include "msgpackwriter.h"
+#include <string.h>        // for memmove, strlen
+#include "outputbuffer.h"  // for OutputBuffer
+#include "utils.h"         // for toValidUtf8
+
+namespace {
+// map32 / array32: type byte plus a 4 byte count
+const size_t maxContainerHeader = 5;
+const int8_t timestampExtension = -1;
+}
+
+MsgpackWriter::MsgpackWriter(OutputBuffer& out)
+    : out(out)
+{
+}
+
+std::unique_ptr<Writer> MsgpackWriter::fork(size_t) const
+{
+    // Counts its elements in an array that's never closed, so its document is never appended to out and splice()
+    // takes the encoded elements and their count from it.
+    std::unique_ptr<MsgpackWriter> forked(new MsgpackWriter(out));
+    forked->containers.push_back({0, 0, true});
+    return forked;
+}
+
+void MsgpackWriter::splice(Writer& fork)
+{
+    const auto& forked = static_cast<MsgpackWriter&>(fork);
+    containers.back().count += forked.containers.front().count;
+    document += forked.document;
+}
+
+void MsgpackWriter::beginObject()
+{
+    beginContainer(false);
+}
+
+void MsgpackWriter::endObject()
+{
+    endContainer();
+}
+
+void MsgpackWriter::beginArray()
+{
+    beginContainer(true);
+}
+
+void MsgpackWriter::endArray()
+{
+    endContainer();
+}
+
+void MsgpackWriter::key(const char* name)
+{
+    ++containers.back().count;
+    text(name, strlen(name));
+}
+
+void MsgpackWriter::string(const char* data, size_t length)
+{
+    beginValue();
+    text(data, length);
+    endValue();
+}
+
+void MsgpackWriter::number(int64_t value)
+{
+    beginValue();
+    if (value >= 0) {
+        const auto unsignedValue = static_cast<uint64_t>(value);
+        if (unsignedValue <= 0x7f) {
+            byte(static_cast<uint8_t>(unsignedValue)); // positive fixint
+        } else if (unsignedValue <= 0xff) {
+            byte(0xcc);
+            bigEndian(unsignedValue, 1);
+        } else if (unsignedValue <= 0xffff) {
+            byte(0xcd);
+            bigEndian(unsignedValue, 2);
+        } else if (unsignedValue <= 0xffffffff) {
+            byte(0xce);
+            bigEndian(unsignedValue, 4);
+        } else {
+            byte(0xcf);
+            bigEndian(unsignedValue, 8);
+        }
+    } else if (value >= -32) {
+        byte(static_cast<uint8_t>(value)); // negative fixint
+    } else if (value >= INT8_MIN) {
+        byte(0xd0);
+        bigEndian(static_cast<uint64_t>(value), 1);
+    } else if (value >= INT16_MIN) {
+        byte(0xd1);
+        bigEndian(static_cast<uint64_t>(value), 2);
+    } else if (value >= INT32_MIN) {
+        byte(0xd2);
+        bigEndian(static_cast<uint64_t>(value), 4);
+    } else {
+        byte(0xd3);
+        bigEndian(static_cast<uint64_t>(value), 8);
+    }
+    endValue();
+}
+
+void MsgpackWriter::hex(const uint8_t* data, size_t length)
+{
+    beginValue();
+    if (length <= 0xff) {
+        byte(0xc4);
+        bigEndian(length, 1);
+    } else if (length <= 0xffff) {
+        byte(0xc5);
+        bigEndian(length, 2);
+    } else {
+        byte(0xc6);
+        bigEndian(length, 4);
+    }
+    document.append(reinterpret_cast<const char*>(data), length);
+    endValue();
+}
+
+void MsgpackWriter::timestamp(uint64_t secondsSinceEpoch)
+{
+    beginValue();
+    if (secondsSinceEpoch <= 0xffffffff) {
+        // timestamp 32: fixext 4
+        byte(0xd6);
+        byte(static_cast<uint8_t>(timestampExtension));
+        bigEndian(secondsSinceEpoch, 4);
+    } else if (secondsSinceEpoch < (uint64_t{1} << 34)) {
+        // timestamp 64: fixext 8, nanoseconds in the upper 30 bits
+        byte(0xd7);
+        byte(static_cast<uint8_t>(timestampExtension));
+        bigEndian(secondsSinceEpoch, 8);
+    } else {
+        // timestamp 96: ext 8 of 12 bytes, 4 bytes of nanoseconds then signed 64 bit seconds
+        byte(0xc7);
+        byte(12);
+        byte(static_cast<uint8_t>(timestampExtension));
+        bigEndian(0, 4);
+        bigEndian(secondsSinceEpoch, 8);
+    }
+    endValue();
+}
+
+void MsgpackWriter::beginValue()
+{
+    if (!containers.empty() && containers.back().isArray) {
+        ++containers.back().count;
+    }
+}
+
+void MsgpackWriter::endValue()
+{
+    if (containers.empty()) {
+        out.append(document.data(), document.size());
+        document.clear();
+    }
+}
+
+void MsgpackWriter::beginContainer(bool isArray)
+{
+    beginValue();
+    containers.push_back({document.size(), 0, isArray});
+    document.append(maxContainerHeader, '\0');
+}
+
+void MsgpackWriter::endContainer()
+{
+    const Container container = containers.back();
+    containers.pop_back();
+
+    char header[maxContainerHeader];
+    size_t headerSize;
+    if (container.count <= 15) {
+        header[0] = static_cast<char>((container.isArray ? 0x90 : 0x80) | container.count); // fixarray / fixmap
+        headerSize = 1;
+    } else if (container.count <= 0xffff) {
+        header[0] = static_cast<char>(container.isArray ? 0xdc : 0xde);
+        header[1] = static_cast<char>(container.count >> 8);
+        header[2] = static_cast<char>(container.count);
+        headerSize = 3;
+    } else {
+        header[0] = static_cast<char>(container.isArray ? 0xdd : 0xdf);
+        for (size_t i = 0; i < 4; ++i) {
+            header[1 + i] = static_cast<char>(container.count >> 8*(3 - i));
+        }
+        headerSize = 5;
+    }
+
+    char* const start = &document[container.headerOffset];
+    const size_t contentsSize = document.size() - container.headerOffset - maxContainerHeader;
+    memcpy(start, header, headerSize);
+    if (headerSize != maxContainerHeader) {
+        memmove(start + headerSize, start + maxContainerHeader, contentsSize);
+        document.resize(document.size() - (maxContainerHeader - headerSize));
+    }
+    endValue();
+}
+
+void MsgpackWriter::text(const char* data, size_t length)
+{
+    if (!toValidUtf8(data, length, fixedText)) {
+        data = fixedText.data();
+        length = fixedText.size();
+    }
+    if (length <= 31) {
+        byte(static_cast<uint8_t>(0xa0 | length)); // fixstr
+    } else if (length <= 0xff) {
+        byte(0xd9);
+        bigEndian(length, 1);
+    } else if (length <= 0xffff) {
+        byte(0xda);
+        bigEndian(length, 2);
+    } else {
+        byte(0xdb);
+        bigEndian(length, 4);
+    }
+    document.append(data, length);
+}
+
+void MsgpackWriter::bigEndian(uint64_t value, size_t size)
+{
+    for (size_t i = size; i-- > 0;) {
+        byte(static_cast<uint8_t>(value >> 8*i));
+    }
+}
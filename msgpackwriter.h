@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>  // for size_t
+#include <cstdint>  // for int64_t, uint8_t, uint64_t
+#include <memory>   // for unique_ptr
+#include <string>   // for string
+#include <vector>   // for vector
+#include "writer.h"
+
+class OutputBuffer;
+
+// Writes MessagePack. Keys and ids are bin of the raw bytes, timestamps use the timestamp extension type (-1), and
+// text is UTF-8 with invalid bytes replaced like in the JSON output.
+//
+// Maps and arrays are prefixed with their element count, which isn't known until they end. Each one gets room for the
+// largest header, and when it ends the header is filled in and the contents are moved down over the unused bytes, so
+// the result is as compact as if the counts had been known up front. A document is therefore collected in memory and
+// only appended to the OutputBuffer once complete.
+class MsgpackWriter : public Writer {
+public:
+    explicit MsgpackWriter(OutputBuffer& out);
+
+    void beginObject() override;
+    void endObject() override;
+    void beginArray() override;
+    void endArray() override;
+    void key(const char* name) override;
+    void string(const char* data, size_t length) override;
+    void number(int64_t value) override;
+    void hex(const uint8_t* data, size_t length) override;
+    void timestamp(uint64_t secondsSinceEpoch) override;
+    using Writer::string;
+    std::unique_ptr<Writer> fork(size_t nested = 0) const override;
+    void splice(Writer& fork) override;
+
+private:
+    struct Container {
+        size_t headerOffset;
+        uint32_t count;
+        bool isArray;
+    };
+
+    void beginValue();
+    void endValue();
+    void beginContainer(bool isArray);
+    void endContainer();
+    void text(const char* data, size_t length);
+    void byte(uint8_t value) { document.push_back(static_cast<char>(value)); }
+    void bigEndian(uint64_t value, size_t size);
+
+    OutputBuffer& out;
+    std::string document;
+    std::vector<Container> containers;
+    std::string fixedText;
+};
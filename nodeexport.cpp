@@ -0,0 +1,174 @@
+#include "nodeexport.h"
+#include <string.h>             // for memcpy, memcmp
+#include <chrono>               // for steady_clock, duration
+#include <exception>            // for exception
+#include <filesystem>           // for create_directories
+#include <iostream>             // for cerr, ostream, endl
+#include <memory>               // for unique_ptr
+#include <stdexcept>            // for runtime_error
+#include "columnfile.h"         // for ColumnFile
+#include "cursor.h"             // for Cursor
+#include "decoders.h"           // for getDhtNodes
+#include "encryptedsave.h"      // for DecryptedSave, KeyCache, openSave
+#include "hash.h"               // for hashBytes
+#include "interntable.h"        // for InternTable
+#include "mappedfile.h"         // for MappedFile
+#include "nodeinfo.h"           // for nodeInfoSize, getAddressFamily, getTransportProtocol, CRYPTO_PUBLIC_KEY_SIZE
+#include "profile.h"            // for NodeView
+#include "sections.h"           // for SectionHeader, SectionType, getAllSections, parseGlobalHeader
+#include "threadpool.h"         // for orderedMap
+#include "utils.h"              // for loadNumber, storeNumber, Endianness
+
+namespace {
+const size_t ipOffset = 1;
+const size_t portOffset = ipOffset + 16;
+const size_t keyOffset = portOffset + 2;
+
+// The identity of a node: family byte as stored (so the protocol too), address padded to 16 bytes, big-endian port
+// and public key.
+struct NodeRecord {
+    uint8_t bytes[keyOffset + CRYPTO_PUBLIC_KEY_SIZE];
+
+    bool operator==(const NodeRecord& other) const { return memcmp(bytes, other.bytes, sizeof(bytes)) == 0; }
+};
+
+struct Sighting {
+    NodeRecord node;
+    uint64_t hash;
+    uint8_t section;
+};
+
+struct ProfileNodes {
+    std::vector<Sighting> sightings;
+    uint64_t bytes = 0;
+    std::string error;
+};
+
+void addSightings(Cursor records, SectionType section, std::vector<Sighting>& sightings)
+{
+    while (!records.atEnd()) {
+        const size_t size = nodeInfoSize(records.peek());
+        records.require(size, "node info");
+        const NodeView view(records.advance(size));
+
+        Sighting sighting = {};
+        sighting.node.bytes[0] = view.data()[0];
+        const auto ip = view.ip();
+        memcpy(sighting.node.bytes + ipOffset, ip.data(), ip.size());
+        storeNumber<Endianness::big>(sighting.node.bytes + portOffset, view.port());
+        memcpy(sighting.node.bytes + keyOffset, view.publicKey().data(), CRYPTO_PUBLIC_KEY_SIZE);
+        sighting.hash = hashBytes(sighting.node.bytes, sizeof(sighting.node.bytes));
+        sighting.section = static_cast<uint8_t>(section);
+        sightings.push_back(sighting);
+    }
+}
+
+// Decodes and hashes one profile's nodes on a pool thread, leaving only the table lookups to the merge.
+struct ReadNodes {
+    ProfileNodes operator()(const std::string& path) const
+    {
+        ProfileNodes nodes;
+        try {
+            MappedFile file(path);
+            std::unique_ptr<DecryptedSave> decrypted;
+            Cursor data = openSave(file.data(), file.size(), *passphrase, *keys, decrypted);
+            parseGlobalHeader(data);
+            for (const auto& header : getAllSections(data)) {
+                switch (header.type) {
+                case SectionType::dht: {
+                    Cursor payload = header.payload();
+                    addSightings(getDhtNodes(payload), header.type, nodes.sightings);
+                    break;
+                }
+                case SectionType::tcpRelay:
+                case SectionType::pathNode:
+                    addSightings(header.payload(), header.type, nodes.sightings);
+                    break;
+                default:
+                    break;
+                }
+            }
+            nodes.bytes = file.size();
+        }
+        catch (const std::exception& e) {
+            nodes.sightings.clear();
+            nodes.error = path + ": " + e.what();
+        }
+        return nodes;
+    }
+
+    const std::optional<std::string>* passphrase;
+    KeyCache* keys;
+};
+}
+
+NodeExportResult exportNodes(const std::vector<std::string>& profilePaths, const std::string& directory,
+                             const std::optional<std::string>& passphrase)
+{
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        throw std::runtime_error("Couldn't create " + directory + ": " + error.message());
+    }
+
+    ColumnFile profiles(directory, "profiles.txt");
+    ColumnFile sightingNodes(directory, "sightings.node");
+    ColumnFile sightingProfiles(directory, "sightings.profile");
+    ColumnFile sightingSections(directory, "sightings.section");
+
+    InternTable<NodeRecord> table;
+    KeyCache keys;
+    uint32_t profileId = 0;
+    const auto start = std::chrono::steady_clock::now();
+
+    // Merged in order, so profile ids are input positions and node rows are numbered by first appearance.
+    NodeExportResult result;
+    auto merge = [&](const ProfileNodes& nodes) {
+        const uint32_t profile = profileId++;
+        ++result.files;
+        if (!nodes.error.empty()) {
+            ++result.failed;
+            std::cerr << nodes.error << std::endl;
+        }
+        result.bytes += nodes.bytes;
+        result.entries += nodes.sightings.size();
+        profiles.append(profilePaths[profile].data(), profilePaths[profile].size());
+        profiles.append("\n", 1);
+        for (const auto& sighting : nodes.sightings) {
+            sightingNodes.appendNumber(table.insert(sighting.node, sighting.hash));
+            sightingProfiles.appendNumber(profile);
+            sightingSections.appendNumber(sighting.section);
+        }
+    };
+    orderedMap(profilePaths, ReadNodes{&passphrase, &keys}, merge);
+
+    ColumnFile families(directory, "nodes.family");
+    ColumnFile protocols(directory, "nodes.protocol");
+    ColumnFile ips(directory, "nodes.ip");
+    ColumnFile ports(directory, "nodes.port");
+    ColumnFile publicKeys(directory, "nodes.key");
+    for (const auto& node : table.rows()) {
+        families.appendNumber<uint8_t>(getAddressFamily(node.bytes[0]) == AddressFamily::ipv4 ? 4 : 6);
+        protocols.appendNumber(static_cast<uint8_t>(getTransportProtocol(node.bytes[0])));
+        ips.append(node.bytes + ipOffset, 16);
+        ports.appendNumber(loadNumber<Endianness::big, uint16_t>(node.bytes + portOffset));
+        publicKeys.append(node.bytes + keyOffset, CRYPTO_PUBLIC_KEY_SIZE);
+    }
+    for (auto* file : {&profiles, &sightingNodes, &sightingProfiles, &sightingSections, &families, &protocols, &ips,
+                       &ports, &publicKeys}) {
+        file->finish();
+    }
+
+    result.uniqueNodes = table.rows().size();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+void printNodeExportSummary(const NodeExportResult& result, std::ostream& out)
+{
+    const double seconds = result.seconds > 0 ? result.seconds : 1e-9;
+    out << "Exported " << result.entries << " nodes (" << result.uniqueNodes << " unique) from "
+        << result.files - result.failed << "/" << result.files << " files (" << result.failed << " failed), "
+        << result.bytes << " bytes in " << result.seconds << " s: " << result.files / seconds << " files/s, "
+        << result.bytes / seconds / (1024 * 1024) << " MiB/s" << std::endl;
+}
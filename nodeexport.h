@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>   // for size_t
+#include <cstdint>   // for uint64_t
+#include <iosfwd>    // for ostream
+#include <optional>  // for optional
+#include <string>    // for string
+#include <vector>    // for vector
+
+struct NodeExportResult {
+    size_t files = 0;
+    size_t failed = 0;
+    uint64_t bytes = 0;
+    uint64_t entries = 0;     // nodes in all the DHT, TCP relay and path node sections
+    uint64_t uniqueNodes = 0; // distinct (protocol, address, port, key)
+    double seconds = 0;
+};
+
+// Writes the nodes of every profile as flat column files into directory, one fixed-size little-endian value per row:
+//
+//   nodes.family       u8        4 or 6
+//   nodes.protocol     u8        0 UDP, 1 TCP
+//   nodes.ip           16 bytes  network order, IPv4 addresses in the first 4 bytes and the rest zero
+//   nodes.port         u16
+//   nodes.key          32 bytes  public key
+//   sightings.node     u32       row in the nodes.* files
+//   sightings.profile  u32       line in profiles.txt
+//   sightings.section  u8        SectionType the node was listed in (2 DHT, 10 TCP relay, 11 path node)
+//   profiles.txt                 every input path, one per line
+//
+// Nodes are deduplicated across all profiles, so each distinct node has one row in the nodes.* files and every time a
+// profile lists it is a row in the sightings.* files. Only the distinct nodes are kept in memory; sightings are
+// streamed out as profiles are decoded. Profiles are read in parallel but merged in input order, so node rows are
+// numbered by first appearance and the output is the same on every run. A profile that fails to parse is reported on
+// stderr and has no sightings. Throws std::runtime_error if the output files can't be written.
+NodeExportResult exportNodes(const std::vector<std::string>& profilePaths, const std::string& directory,
+                             const std::optional<std::string>& passphrase = std::nullopt);
+
+void printNodeExportSummary(const NodeExportResult& result, std::ostream& out);
@@ -1,24 +1,12 @@
-#include <qjsonobject.h>  // for QJsonObject
 #include <stdio.h>        // for snprintf
 #include <cstdint>        // for uint8_t, uint16_t
 #include <stdexcept>      // for runtime_error, invalid_argument
 #include <string>         // for string
 #include "nodeinfo.h"
-#include "utils.h"        // for dataToNumber, readHexData, Endianness, Endi...
-
-#define CRYPTO_PUBLIC_KEY_SIZE         32
-
-enum class TransportProtocol
-{
-    udp = 0,
-    tcp = 1
-};
-
-enum class AddressFamily
-{
-    ipv4,
-    ipv6
-};
+#include "utils.h"        // for Endianness, Endianness::big
+#include "cursor.h"       // for Cursor
+#include "writer.h"       // for Writer, writeHex
+#include "stats.h"        // for countRecords
 
 std::string transportProtocolToString(TransportProtocol proto)
 {
@@ -62,59 +50,76 @@ AddressFamily getAddressFamily(uint8_t data)
     }
 }
 
-void addFamily(uint8_t*& data, AddressFamily addrFamily, QJsonObject& node)
+size_t nodeInfoSize(uint8_t family)
+{
+    const size_t addressSize = getAddressFamily(family) == AddressFamily::ipv4 ? 4 : 16;
+    return 1 + addressSize + sizeof(uint16_t) + CRYPTO_PUBLIC_KEY_SIZE;
+}
+
+void addFamily(Cursor& data, AddressFamily addrFamily, Writer& out)
 {
-    auto protocol = getTransportProtocol(data[0]);
-    node.insert("Transport Protocol", transportProtocolToString(protocol).c_str());
-    node.insert("Address Family", addressFamilyToString(addrFamily).c_str());
-    data++;
+    auto protocol = getTransportProtocol(data.peek());
+    out.key("Transport Protocol");
+    out.string(transportProtocolToString(protocol));
+    out.key("Address Family");
+    out.string(addressFamilyToString(addrFamily));
+    data.advance(1);
 }
 
-void addIpAddress(uint8_t*& data, QJsonObject& node, AddressFamily addrFamily)
+void addIpAddress(Cursor& data, Writer& out, AddressFamily addrFamily)
 {
-    char addressName[32+8]; // length of ipv4 address (32) + 8 colons for formatting
+    const uint8_t* const ip = data.data();
+    char addressName[32+8]; // length of ipv6 address (32) + colons for formatting
+    int length = 0;
 
     switch (addrFamily) {
     case AddressFamily::ipv4:
-        snprintf(addressName, sizeof(addressName), "%d.%d.%d.%d", data[0], data[1], data[2], data[3]);
-        data += 4;
+        length = snprintf(addressName, sizeof(addressName), "%d.%d.%d.%d", ip[0], ip[1], ip[2], ip[3]);
+        data.advance(4);
         break;
     case AddressFamily::ipv6:
-        snprintf(addressName, sizeof(addressName), "%02X%02X:%02X%02X:%02X%02X:%02X%02X:%02X%02X:%02X%02X:%02X%02X:%02X%02X",
-            data[0], data[1], data[2], data[3], data[4], data[5], data[6], data[7], data[8],
-            data[9], data[10], data[11], data[12], data[13], data[14], data[15]);
-        data += 16;
+        length = snprintf(addressName, sizeof(addressName), "%02X%02X:%02X%02X:%02X%02X:%02X%02X:%02X%02X:%02X%02X:%02X%02X:%02X%02X",
+            ip[0], ip[1], ip[2], ip[3], ip[4], ip[5], ip[6], ip[7], ip[8],
+            ip[9], ip[10], ip[11], ip[12], ip[13], ip[14], ip[15]);
+        data.advance(16);
         break;
     default:
         throw std::invalid_argument("Invalid AddressFamily passed to addIpUnion");
     }
-    node.insert("IP address", addressName);
+    out.key("IP address");
+    out.string(addressName, length);
 }
 
-void addIp(uint8_t*& data, QJsonObject& node)
+void addIp(Cursor& data, Writer& out)
 {
-    auto addrFamily = getAddressFamily(data[0]);
-    addFamily(data, addrFamily, node);
-    addIpAddress(data, node, addrFamily);
+    auto addrFamily = getAddressFamily(data.peek());
+    addFamily(data, addrFamily, out);
+    addIpAddress(data, out, addrFamily);
 }
 
-QJsonArray getNodeInfos(uint8_t*& data, int sectionSize)
+void writeNodeInfo(Cursor& data, Writer& out)
 {
-    uint8_t* const initialPoint = data;
-    QJsonArray nodes;
-    while ((data - initialPoint) < sectionSize)
-    {
-        QJsonObject nodeJson;
-        addIp(data, nodeJson);
-        nodeJson.insert("Port Number", dataToNumber<uint16_t>(data, Endianness::big));
-        nodeJson.insert("Public Key", readHexData(data, CRYPTO_PUBLIC_KEY_SIZE).c_str());
-        nodes.append(nodeJson);
-    }
+    // one check per node, sized by its address family
+    data.require(nodeInfoSize(data.peek()), "node info");
 
-    if ((data - initialPoint) != sectionSize)
+    out.beginObject();
+    addIp(data, out);
+    out.key("Port Number");
+    out.number(data.read<Endianness::big, uint16_t>());
+    out.key("Public Key");
+    writeHex(data, CRYPTO_PUBLIC_KEY_SIZE, out);
+    out.endObject();
+}
+
+void getNodeInfos(Cursor& data, Writer& out)
+{
+    size_t count = 0;
+    out.beginArray();
+    while (!data.atEnd())
     {
-        throw std::runtime_error("Section isn't the expected size.");
+        writeNodeInfo(data, out);
+        ++count;
     }
-
-    return nodes;
+    out.endArray();
+    countRecords(count);
 }
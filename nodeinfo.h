@@ -1,12 +1,35 @@
 #pragma once
 
-#include <qjsonarray.h>  // for QJsonArray
+#include <cstddef>       // for size_t
 #include <cstdint>       // for uint8_t
-class QJsonObject;
+#include <string>        // for string
+class Cursor;
+class Writer;
+
+#define CRYPTO_PUBLIC_KEY_SIZE         32
+
+enum class TransportProtocol
+{
+    udp = 0,
+    tcp = 1
+};
+
+enum class AddressFamily
+{
+    ipv4,
+    ipv6
+};
+
+std::string transportProtocolToString(TransportProtocol proto);
+std::string addressFamilyToString(AddressFamily fam);
+TransportProtocol getTransportProtocol(uint8_t data);
+AddressFamily getAddressFamily(uint8_t data);
+// Size of the packed node record starting with the given family byte (family, address, port, public key).
+size_t nodeInfoSize(uint8_t family);
 
 bool isFamilyIpv4(uint8_t family);
-void addFamily(uint8_t*& data, QJsonObject& node);
-void addIpUnion(uint8_t*& data, QJsonObject& node, bool isIpv4);
-void addIp(uint8_t*& data, QJsonObject& node);
-void addIpPort(uint8_t*& data, QJsonObject& node);
-QJsonArray getNodeInfos(uint8_t*& data, int sectionSize);
+void addIp(Cursor& data, Writer& out);
+// Decodes one node as an object.
+void writeNodeInfo(Cursor& data, Writer& out);
+// Decodes nodes until data is exhausted.
+void getNodeInfos(Cursor& data, Writer& out);
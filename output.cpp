@@ -0,0 +1,86 @@
+#include "output.h"
+#include <stdexcept>        // for invalid_argument
+#include "cborwriter.h"     // for CborWriter
+#include "decoders.h"       // for writeProfile, writeSortedProfile
+#include "jsonwriter.h"     // for JsonWriter
+#include "msgpackwriter.h"  // for MsgpackWriter
+#include "outputbuffer.h"   // for OutputBuffer
+#include "salvage.h"        // for writeSalvagedProfile
+
+namespace {
+void writeProfile(Cursor data, const OutputOptions& options, Writer& writer)
+{
+    if (options.salvage) {
+        writeSalvagedProfile(data, writer);
+    } else if (options.format == OutputFormat::qjson) {
+        writeSortedProfile(data, writer, options.parallelSections, options.selection);
+    } else {
+        writeProfile(data, writer, options.selection);
+    }
+}
+
+std::unique_ptr<Writer> makeEncoder(const OutputOptions& options, OutputBuffer& out)
+{
+    switch (options.format) {
+    case OutputFormat::json:
+    case OutputFormat::qjson:
+        return std::unique_ptr<Writer>(new JsonWriter(out, options.indented));
+    case OutputFormat::cbor:
+        return std::unique_ptr<Writer>(new CborWriter(out));
+    case OutputFormat::msgpack:
+        return std::unique_ptr<Writer>(new MsgpackWriter(out));
+    }
+    throw std::invalid_argument("Unknown output format");
+}
+}
+
+OutputFormat outputFormatFromString(const std::string& name)
+{
+    if (name == "json") {
+        return OutputFormat::json;
+    }
+    if (name == "qjson") {
+        return OutputFormat::qjson;
+    }
+    if (name == "cbor") {
+        return OutputFormat::cbor;
+    }
+    if (name == "msgpack") {
+        return OutputFormat::msgpack;
+    }
+    throw std::invalid_argument("Unknown output format " + name);
+}
+
+void writeProfileOutput(Cursor data, const OutputOptions& options, OutputBuffer& out, const std::string& file)
+{
+    ProfileOutput output(options, out, file);
+    writeProfile(data, options, output.writer());
+    output.finish();
+}
+
+ProfileOutput::ProfileOutput(const OutputOptions& options, OutputBuffer& out, const std::string& file)
+    : out(out)
+    , encoder(makeEncoder(options, out))
+    , newline(options.format == OutputFormat::json || options.format == OutputFormat::qjson)
+    , wrapped(!file.empty())
+{
+    if (wrapped) {
+        encoder->beginObject();
+        encoder->key("File");
+        encoder->string(file);
+        encoder->key("Profile");
+    }
+}
+
+ProfileOutput::~ProfileOutput() = default;
+
+void ProfileOutput::finish()
+{
+    if (wrapped) {
+        encoder->endObject();
+    }
+    // binary formats are written back to back
+    if (newline) {
+        out.append('\n');
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>  // for uint8_t
+#include <memory>   // for unique_ptr
+#include <string>   // for string
+#include "cursor.h"  // for Cursor
+
+class OutputBuffer;
+class Selection;
+class Writer;
+
+enum class OutputFormat {
+    json,  // streamed straight from the decoders, members in save order
+    qjson, // members sorted by key, the same document as QJsonDocument produces
+    cbor,    // streamed like json, keys and ids as byte strings, timestamps as integers
+    msgpack, // same model as cbor
+};
+
+// Throws std::invalid_argument for unknown names.
+OutputFormat outputFormatFromString(const std::string& name);
+
+struct OutputOptions {
+    OutputFormat format = OutputFormat::json;
+    bool indented = true;
+    bool parallelSections = true; // only used by the qjson format
+    const Selection* selection = nullptr; // only write these fields, all of them without
+    bool salvage = false; // search damaged saves for sections, see salvage.h (always in save order)
+};
+
+// Decodes the save at data and appends it to out, followed by a newline for the JSON formats. With a file name the
+// profile is wrapped as {"File": file, "Profile": ...}, as used for the one-line-per-profile batch output. Binary
+// formats are written back to back, so batch output is a sequence of documents.
+void writeProfileOutput(Cursor data, const OutputOptions& options, OutputBuffer& out, const std::string& file = {});
+
+// The encoding side of writeProfileOutput(), for profiles that come from somewhere else than a mapped save: writer()
+// takes the profile as one value, and finish() ends the document once it has been written.
+class ProfileOutput {
+public:
+    ProfileOutput(const OutputOptions& options, OutputBuffer& out, const std::string& file = {});
+    ~ProfileOutput();
+    ProfileOutput(const ProfileOutput&) = delete;
+    ProfileOutput& operator=(const ProfileOutput&) = delete;
+
+    Writer& writer() { return *encoder; }
+    void finish();
+
+private:
+    OutputBuffer& out;
+    std::unique_ptr<Writer> encoder;
+    bool newline;
+    bool wrapped;
+};
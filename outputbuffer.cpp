@@ -0,0 +1,82 @@
+#include "outputbuffer.h"
+#include <errno.h>    // for errno, EINTR
+#include <string.h>   // for memcpy, strerror
+#include <unistd.h>   // for write
+#include <algorithm>  // for max
+#include <stdexcept>  // for runtime_error
+#include <string>     // for string
+#include <utility>    // for move
+#include "stats.h"    // for StageTimer
+
+namespace {
+void writeAll(int fd, const char* data, size_t length)
+{
+    StageTimer timer(Stage::output);
+    while (length > 0) {
+        const auto written = write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(std::string("Error writing output: ") + strerror(errno));
+        }
+        data += written;
+        length -= written;
+    }
+}
+}
+
+OutputBuffer::OutputBuffer(int fd, size_t capacity)
+    : fd(fd)
+    , buffer(new char[capacity])
+    , capacity(capacity)
+{
+}
+
+OutputBuffer::~OutputBuffer()
+{
+    try {
+        flush();
+    }
+    catch (const std::exception&) {
+        // nowhere left to report it
+    }
+}
+
+void OutputBuffer::append(const char* data, size_t length)
+{
+    if (capacity - used < length) {
+        if (fd != -1 && length >= capacity) {
+            // bigger than the whole buffer, no point in copying it first
+            flush();
+            writeAll(fd, data, length);
+            return;
+        }
+        makeRoom(length);
+    }
+    memcpy(buffer.get() + used, data, length);
+    used += length;
+}
+
+void OutputBuffer::flush()
+{
+    if (fd == -1 || used == 0) {
+        return;
+    }
+    writeAll(fd, buffer.get(), used);
+    used = 0;
+}
+
+void OutputBuffer::makeRoom(size_t length)
+{
+    if (fd != -1) {
+        flush();
+    }
+    if (capacity - used < length) {
+        const size_t grown = std::max(capacity * 2, used + length);
+        std::unique_ptr<char[]> larger(new char[grown]);
+        memcpy(larger.get(), buffer.get(), used);
+        buffer = std::move(larger);
+        capacity = grown;
+    }
+}
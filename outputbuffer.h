@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>  // for size_t
+#include <memory>   // for unique_ptr
+
+// Append-only byte buffer. Bound to a file descriptor it is flushed with write(2) whenever it fills up, otherwise
+// (fd == -1) it grows and the caller takes the bytes with data()/size().
+class OutputBuffer {
+public:
+    explicit OutputBuffer(int fd = -1, size_t capacity = 1 << 20);
+    ~OutputBuffer();
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    void append(const char* data, size_t length);
+    void append(char c)
+    {
+        if (used == capacity) {
+            makeRoom(1);
+        }
+        buffer[used++] = c;
+    }
+
+    // Returns space for at least length bytes; commit() how many were actually written.
+    char* reserve(size_t length)
+    {
+        if (capacity - used < length) {
+            makeRoom(length);
+        }
+        return buffer.get() + used;
+    }
+    void commit(size_t length) { used += length; }
+
+    void flush();
+    void clear() { used = 0; }
+
+    const char* data() const { return buffer.get(); }
+    size_t size() const { return used; }
+
+private:
+    void makeRoom(size_t length);
+
+    int fd;
+    // left uninitialized, so pages that are never written to are never touched
+    std::unique_ptr<char[]> buffer;
+    size_t capacity;
+    size_t used = 0;
+};
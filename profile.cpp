@@ -0,0 +1,251 @@
+#include "profile.h"
+#include <algorithm>            // for min
+#include <stdexcept>            // for runtime_error
+#include "conferenceindex.h"    // for ConferenceIndex
+#include "cursor.h"             // for Cursor
+#include "decoders.h"           // for getDhtNodes
+
+namespace {
+template <typename T, Endianness E = Endianness::little>
+T readNumber(const uint8_t* data)
+{
+    return loadNumber<E, T>(data);
+}
+
+// Length prefixed fields in friend records are stored after their fixed-size buffer; clamp bogus lengths to it.
+std::string_view boundedString(const uint8_t* start, size_t maxLength, uint16_t length)
+{
+    return {reinterpret_cast<const char*>(start), std::min<size_t>(length, maxLength)};
+}
+
+using Layout = FriendRecordLayout;
+
+// Every node record has to fit in records, the views size their address by the family byte alone.
+NodeList checkedNodes(Cursor records)
+{
+    const uint8_t* const first = records.data();
+    size_t count = 0;
+    while (!records.atEnd()) {
+        const size_t size = nodeInfoSize(records.peek());
+        records.require(size, "node info");
+        records.advance(size);
+        ++count;
+    }
+    return {first, records.data(), count};
+}
+
+NodeList checkedNodes(const SectionHeader* section)
+{
+    if (!section) {
+        return {};
+    }
+    Cursor data = section->payload();
+    if (section->type == SectionType::dht) {
+        const Cursor records = getDhtNodes(data);
+        if (!data.atEnd()) {
+            throw std::runtime_error("Section contents didn't match section size.");
+        }
+        return checkedNodes(records);
+    }
+    return checkedNodes(data);
+}
+
+FriendList checkedFriends(const SectionHeader* section)
+{
+    if (!section) {
+        return {};
+    }
+    if (section->size % FriendView::recordSize != 0) {
+        throw std::runtime_error("Friends section size isn't a multiple of the friend record size");
+    }
+    return {section->data, section->size / FriendView::recordSize};
+}
+
+// The same walk as ConferenceIndex, without keeping the offsets.
+ConferenceList checkedConferences(const SectionHeader* section)
+{
+    if (!section) {
+        return {};
+    }
+    size_t count = 0;
+    ConferenceIndex::walk(section->payload(), [&count](uint32_t) { ++count; }, [](uint32_t) {});
+    return {section->data, section->data + section->size, count};
+}
+}
+
+std::span<const uint8_t> NodeView::ip() const
+{
+    return {record + 1, family() == AddressFamily::ipv4 ? size_t{4} : size_t{16}};
+}
+
+uint16_t NodeView::port() const
+{
+    return readNumber<uint16_t, Endianness::big>(record + 1 + ip().size());
+}
+
+PublicKey NodeView::publicKey() const
+{
+    return PublicKey(record + 1 + ip().size() + 2, 32);
+}
+
+std::string_view FriendView::requestMessage() const
+{
+    return boundedString(record + Layout::requestMessage, Layout::requestMessageMaxLength,
+                         readNumber<uint16_t, Endianness::big>(record + Layout::requestMessageLength));
+}
+
+std::string_view FriendView::name() const
+{
+    return boundedString(record + Layout::name, Layout::nameMaxLength,
+                         readNumber<uint16_t, Endianness::big>(record + Layout::nameLength));
+}
+
+std::string_view FriendView::statusMessage() const
+{
+    return boundedString(record + Layout::statusMessage, Layout::statusMessageMaxLength,
+                         readNumber<uint16_t, Endianness::big>(record + Layout::statusMessageLength));
+}
+
+UserStatus FriendView::userStatus() const
+{
+    return static_cast<UserStatus>(record[Layout::userStatus]);
+}
+
+std::span<const uint8_t, 4> FriendView::nospam() const
+{
+    return std::span<const uint8_t, 4>(record + Layout::nospam, 4);
+}
+
+uint64_t FriendView::lastSeen() const
+{
+    return readNumber<uint64_t, Endianness::big>(record + Layout::lastSeen);
+}
+
+uint16_t ConferencePeerView::peerNumber() const
+{
+    return readNumber<uint16_t>(record + 64);
+}
+
+uint64_t ConferencePeerView::lastActive() const
+{
+    return readNumber<uint64_t>(record + 66);
+}
+
+std::string_view ConferencePeerView::name() const
+{
+    return {reinterpret_cast<const char*>(record + fixedSize), record[fixedSize - 1]};
+}
+
+uint32_t ConferenceView::messageNumber() const
+{
+    return readNumber<uint32_t>(record + 33);
+}
+
+uint16_t ConferenceView::lossyMessageNumber() const
+{
+    return readNumber<uint16_t>(record + 37);
+}
+
+uint16_t ConferenceView::peerNumber() const
+{
+    return readNumber<uint16_t>(record + 39);
+}
+
+uint32_t ConferenceView::peerCount() const
+{
+    return readNumber<uint32_t>(record + 41);
+}
+
+std::string_view ConferenceView::title() const
+{
+    return {reinterpret_cast<const char*>(record + fixedSize), record[fixedSize - 1]};
+}
+
+ConferencePeerList ConferenceView::peers() const
+{
+    const auto count = static_cast<int32_t>(peerCount());
+    return {peersStart(), record + size(), count > 0 ? static_cast<size_t>(count) : 0};
+}
+
+size_t ConferenceView::size() const
+{
+    const uint8_t* pos = peersStart();
+    for (int32_t i = 0, count = static_cast<int32_t>(peerCount()); i < count; ++i) {
+        pos += ConferencePeerView(pos).size();
+    }
+    return pos - record;
+}
+
+Profile::Profile(const uint8_t* data, size_t size)
+{
+    Cursor bytes(data, size);
+    parseGlobalHeader(bytes);
+    allSections = getAllSections(bytes);
+
+    friendList = checkedFriends(section(SectionType::friends));
+    dhtNodeList = checkedNodes(section(SectionType::dht));
+    tcpRelayList = checkedNodes(section(SectionType::tcpRelay));
+    pathNodeList = checkedNodes(section(SectionType::pathNode));
+    conferenceList = checkedConferences(section(SectionType::conferences));
+}
+
+const SectionHeader* Profile::section(SectionType type) const
+{
+    for (const auto& section : allSections) {
+        if (section.type == type) {
+            return &section;
+        }
+    }
+    return nullptr;
+}
+
+std::span<const uint8_t> Profile::payload(SectionType type) const
+{
+    const auto header = section(type);
+    if (!header) {
+        return {};
+    }
+    return {header->data, header->size};
+}
+
+std::span<const uint8_t> Profile::nospamKeysField(size_t offset, size_t length) const
+{
+    const auto bytes = payload(SectionType::nospamkeys);
+    if (bytes.size() < offset + length) {
+        return {};
+    }
+    return bytes.subspan(offset, length);
+}
+
+std::span<const uint8_t> Profile::nospam() const
+{
+    return nospamKeysField(0, 4);
+}
+
+std::span<const uint8_t> Profile::publicKey() const
+{
+    return nospamKeysField(4, 32);
+}
+
+std::span<const uint8_t> Profile::secretKey() const
+{
+    return nospamKeysField(36, 32);
+}
+
+std::string_view Profile::name() const
+{
+    const auto bytes = payload(SectionType::name);
+    return {reinterpret_cast<const char*>(bytes.data()), bytes.size()};
+}
+
+std::string_view Profile::statusMessage() const
+{
+    const auto bytes = payload(SectionType::statusmessage);
+    return {reinterpret_cast<const char*>(bytes.data()), bytes.size()};
+}
+
+UserStatus Profile::status() const
+{
+    const auto bytes = payload(SectionType::status);
+    return bytes.empty() ? UserStatus::online : static_cast<UserStatus>(bytes[0]);
+}
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <cstddef>         // for size_t, ptrdiff_t
+#include <cstdint>         // for uint8_t, uint16_t, uint32_t, uint64_t
+#include <iterator>        // for forward_iterator_tag
+#include <span>            // for span
+#include <string_view>     // for string_view
+#include <vector>          // for vector
+#include "friendrecord.h"  // for FriendRecordLayout
+#include "nodeinfo.h"      // for TransportProtocol, AddressFamily
+#include "sections.h"      // for SectionHeader, SectionType
+#include "utils.h"         // for FriendStatus, UserStatus
+
+// Read-only views over a save's bytes. Nothing is copied or decoded up front: constructing a Profile walks the
+// section headers and the record lengths of its lists, and each accessor decodes its field from the underlying bytes
+// when it's called. Everything returned points into the buffer the Profile was created from, which has to outlive it
+// (e.g. a MappedFile).
+//
+// The views themselves don't check anything. The lists are bounds checked once, when the Profile is constructed, so
+// every view reached through a list stays inside the save and the accessors only hand out what was checked.
+
+using PublicKey = std::span<const uint8_t, 32>;
+
+// Forward iteration over packed records of varying size, each View knowing its own size(), counted when they were
+// checked. Finding record n means walking the ones before it, so there's no indexing: copy the views into a vector for
+// random access (ConferenceIndex does that for conferences and their peers).
+template <typename View>
+class RecordList {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = View;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = View;
+
+        iterator() = default;
+        explicit iterator(const uint8_t* pos) : pos(pos) {}
+        View operator*() const { return View(pos); }
+        iterator& operator++() { pos += View(pos).size(); return *this; }
+        iterator operator++(int) { auto old = *this; ++*this; return old; }
+        // ordered rather than equal, so a record overrunning the end still terminates the loop
+        bool operator==(const iterator& other) const { return pos >= other.pos; }
+        bool operator!=(const iterator& other) const { return pos < other.pos; }
+
+    private:
+        const uint8_t* pos = nullptr;
+    };
+
+    RecordList() = default;
+    RecordList(const uint8_t* first, const uint8_t* last, size_t count) : first(first), last(last), count(count) {}
+
+    iterator begin() const { return iterator(first); }
+    iterator end() const { return iterator(last); }
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+
+private:
+    const uint8_t* first = nullptr;
+    const uint8_t* last = nullptr;
+    size_t count = 0;
+};
+
+class NodeView {
+public:
+    explicit NodeView(const uint8_t* record) : record(record) {}
+
+    TransportProtocol protocol() const { return getTransportProtocol(record[0]); }
+    AddressFamily family() const { return getAddressFamily(record[0]); }
+    // 4 bytes for IPv4, 16 for IPv6, in network order
+    std::span<const uint8_t> ip() const;
+    uint16_t port() const;
+    PublicKey publicKey() const;
+    size_t size() const { return nodeInfoSize(record[0]); }
+    const uint8_t* data() const { return record; }
+
+private:
+    const uint8_t* record;
+};
+using NodeList = RecordList<NodeView>;
+
+class FriendView {
+public:
+    explicit FriendView(const uint8_t* record) : record(record) {}
+
+    FriendStatus status() const { return static_cast<FriendStatus>(record[FriendRecordLayout::status]); }
+    PublicKey publicKey() const { return PublicKey(record + FriendRecordLayout::publicKey, 32); }
+    std::string_view requestMessage() const;
+    std::string_view name() const;
+    std::string_view statusMessage() const;
+    UserStatus userStatus() const;
+    std::span<const uint8_t, 4> nospam() const;
+    uint64_t lastSeen() const;
+    const uint8_t* data() const { return record; }
+
+    static constexpr size_t recordSize = FriendRecordLayout::size;
+
+private:
+    const uint8_t* record;
+};
+
+// Friend records have a fixed size, so unlike the other lists this one has constant time indexing.
+class FriendList {
+public:
+    FriendList() = default;
+    FriendList(const uint8_t* first, size_t count) : first(first), count(count) {}
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    FriendView operator[](size_t index) const { return FriendView(first + index * FriendView::recordSize); }
+
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = FriendView;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = FriendView;
+
+        iterator() = default;
+        explicit iterator(const uint8_t* pos) : pos(pos) {}
+        FriendView operator*() const { return FriendView(pos); }
+        iterator& operator++() { pos += FriendView::recordSize; return *this; }
+        iterator operator++(int) { auto old = *this; ++*this; return old; }
+        bool operator==(const iterator& other) const { return pos == other.pos; }
+        bool operator!=(const iterator& other) const { return pos != other.pos; }
+
+    private:
+        const uint8_t* pos = nullptr;
+    };
+    iterator begin() const { return iterator(first); }
+    iterator end() const { return iterator(first + count * FriendView::recordSize); }
+
+private:
+    const uint8_t* first = nullptr;
+    size_t count = 0;
+};
+
+class ConferencePeerView {
+public:
+    explicit ConferencePeerView(const uint8_t* record) : record(record) {}
+
+    PublicKey publicKey() const { return PublicKey(record, 32); }
+    PublicKey dhtPublicKey() const { return PublicKey(record + 32, 32); }
+    uint16_t peerNumber() const;
+    uint64_t lastActive() const;
+    std::string_view name() const;
+    size_t size() const { return fixedSize + record[fixedSize - 1]; }
+
+private:
+    // keys, peer number, timestamp, name length
+    static constexpr size_t fixedSize = 32 + 32 + 2 + 8 + 1;
+    const uint8_t* record;
+};
+using ConferencePeerList = RecordList<ConferencePeerView>;
+
+class ConferenceView {
+public:
+    explicit ConferenceView(const uint8_t* record) : record(record) {}
+
+    uint8_t type() const { return record[0]; }
+    PublicKey id() const { return PublicKey(record + 1, 32); }
+    uint32_t messageNumber() const;
+    uint16_t lossyMessageNumber() const;
+    uint16_t peerNumber() const;
+    uint32_t peerCount() const;
+    std::string_view title() const;
+    ConferencePeerList peers() const;
+    // Walks the peers' name lengths. A negative peer count is taken as no peers, as ConferenceIndex does.
+    size_t size() const;
+    const uint8_t* data() const { return record; }
+
+private:
+    // type, id, message number, lossy message number, peer number, peer count, title length
+    static constexpr size_t fixedSize = 1 + 32 + 4 + 2 + 2 + 4 + 1;
+    const uint8_t* peersStart() const { return record + fixedSize + record[fixedSize - 1]; }
+    const uint8_t* record;
+};
+using ConferenceList = RecordList<ConferenceView>;
+
+class Profile {
+public:
+    // Throws std::runtime_error if the bytes aren't a plain (unencrypted) tox save, or if a record of one of the lists
+    // below doesn't fit in its section (a friends section that isn't whole records, a node or conference cut off, or a
+    // DHT section with a bad header, as getDht() rejects it).
+    Profile(const uint8_t* data, size_t size);
+    explicit Profile(std::span<const uint8_t> bytes) : Profile(bytes.data(), bytes.size()) {}
+
+    const std::vector<SectionHeader>& sections() const { return allSections; }
+    // First section of the given type, or nullptr if the save doesn't have one.
+    const SectionHeader* section(SectionType type) const;
+
+    // Empty if the save has no such section.
+    std::span<const uint8_t> nospam() const;
+    std::span<const uint8_t> publicKey() const;
+    std::span<const uint8_t> secretKey() const;
+    std::string_view name() const;
+    std::string_view statusMessage() const;
+    UserStatus status() const;
+
+    // Empty if the save has no such section. Checked by the constructor, so these cost nothing.
+    FriendList friends() const { return friendList; }
+    NodeList dhtNodes() const { return dhtNodeList; }
+    NodeList tcpRelays() const { return tcpRelayList; }
+    NodeList pathNodes() const { return pathNodeList; }
+    ConferenceList conferences() const { return conferenceList; }
+
+private:
+    std::span<const uint8_t> payload(SectionType type) const;
+    std::span<const uint8_t> nospamKeysField(size_t offset, size_t length) const;
+
+    std::vector<SectionHeader> allSections;
+    FriendList friendList;
+    NodeList dhtNodeList;
+    NodeList tcpRelayList;
+    NodeList pathNodeList;
+    ConferenceList conferenceList;
+};
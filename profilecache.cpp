@@ -0,0 +1,322 @@
+#include "profilecache.h"
+#include <errno.h>          // for errno, EINTR
+#include <fcntl.h>          // for open, O_CREAT, O_EXCL, O_WRONLY
+#include <stdio.h>          // for rename, snprintf
+#include <string.h>         // for strerror
+#include <sys/stat.h>       // for stat, chmod
+#include <time.h>           // for time
+#include <unistd.h>         // for write, close, unlink, getpid
+#include <atomic>           // for atomic
+#include <cstdint>          // for uint8_t, uint16_t, uint32_t, uint64_t, int64_t
+#include <filesystem>       // for absolute, create_directories
+#include <fstream>          // for ifstream
+#include <optional>         // for optional
+#include <stdexcept>        // for runtime_error
+#include <string>           // for string, to_string
+#include <utility>          // for move
+#include <vector>           // for vector
+#include "cursor.h"         // for Cursor
+#include "decoders.h"       // for writeSection
+#include "encryptedsave.h"  // for isEncryptedSave
+#include "hash.h"           // for hashBytes
+#include "jsonwriter.h"     // for JsonWriter
+#include "mappedfile.h"     // for MappedFile
+#include "outputbuffer.h"   // for OutputBuffer
+#include "sections.h"       // for getAllSections, parseGlobalHeader, replacedSections
+#include "utils.h"          // for loadNumber, Endianness
+
+namespace {
+const char entryMagic[] = "TSCACHE1";
+const uint32_t indentedFlag = 1;
+const uint32_t wrappedFlag = 2;
+
+struct CachedSection {
+    uint32_t offset;
+    uint32_t size;
+    uint16_t type;
+    uint64_t hash;
+    std::string json;
+};
+
+struct CacheEntry {
+    uint32_t flags = 0;
+    uint64_t size = 0;
+    int64_t mtimeSeconds = 0;
+    int64_t mtimeNanoseconds = 0;
+    uint64_t contentHash = 0;
+    std::string path;
+    std::vector<CachedSection> sections;
+};
+
+template <typename T>
+void appendNumber(std::string& out, T value)
+{
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        out.push_back(static_cast<char>(static_cast<uint64_t>(value) >> 8*i));
+    }
+}
+
+void appendBytes(std::string& out, const std::string& bytes)
+{
+    appendNumber<uint32_t>(out, bytes.size());
+    out += bytes;
+}
+
+std::string readBytes(Cursor& data)
+{
+    data.require(4, "cache entry");
+    const auto length = data.read<uint32_t>();
+    const auto bytes = data.take(length, "cache entry");
+    return {reinterpret_cast<const char*>(bytes.data()), length};
+}
+
+std::string serialize(const CacheEntry& entry)
+{
+    std::string out(entryMagic, sizeof(entryMagic) - 1);
+    appendNumber(out, entry.flags);
+    appendNumber(out, entry.size);
+    appendNumber(out, entry.mtimeSeconds);
+    appendNumber(out, entry.mtimeNanoseconds);
+    appendNumber(out, entry.contentHash);
+    appendBytes(out, entry.path);
+    appendNumber<uint32_t>(out, entry.sections.size());
+    for (const auto& section : entry.sections) {
+        appendNumber(out, section.offset);
+        appendNumber(out, section.size);
+        appendNumber(out, section.type);
+        appendNumber(out, section.hash);
+        appendBytes(out, section.json);
+    }
+    // a torn or otherwise damaged entry fails this and counts as a miss
+    appendNumber(out, hashBytes(reinterpret_cast<const uint8_t*>(out.data()), out.size()));
+    return out;
+}
+
+std::optional<CacheEntry> parse(const std::string& bytes)
+{
+    const auto* data = reinterpret_cast<const uint8_t*>(bytes.data());
+    const size_t magicSize = sizeof(entryMagic) - 1;
+    if (bytes.size() < magicSize + 8 || bytes.compare(0, magicSize, entryMagic) != 0
+        || hashBytes(data, bytes.size() - 8) != loadNumber<Endianness::little, uint64_t>(data + bytes.size() - 8)) {
+        return std::nullopt;
+    }
+
+    try {
+        Cursor entryData(data + magicSize, bytes.size() - magicSize - 8);
+        CacheEntry entry;
+        entryData.require(4 + 8 + 8 + 8 + 8, "cache entry");
+        entry.flags = entryData.read<uint32_t>();
+        entry.size = entryData.read<uint64_t>();
+        entry.mtimeSeconds = entryData.read<int64_t>();
+        entry.mtimeNanoseconds = entryData.read<int64_t>();
+        entry.contentHash = entryData.read<uint64_t>();
+        entry.path = readBytes(entryData);
+        entryData.require(4, "cache entry");
+        const auto count = entryData.read<uint32_t>();
+        for (uint32_t i = 0; i < count; ++i) {
+            CachedSection section;
+            entryData.require(4 + 4 + 2 + 8, "cache entry");
+            section.offset = entryData.read<uint32_t>();
+            section.size = entryData.read<uint32_t>();
+            section.type = entryData.read<uint16_t>();
+            section.hash = entryData.read<uint64_t>();
+            section.json = readBytes(entryData);
+            entry.sections.push_back(std::move(section));
+        }
+        return entry;
+    }
+    catch (const std::runtime_error&) {
+        return std::nullopt;
+    }
+}
+
+std::optional<CacheEntry> load(const std::string& entryPath)
+{
+    std::ifstream file(entryPath, std::ios::binary | std::ios::ate);
+    if (!file) {
+        return std::nullopt;
+    }
+    std::string bytes(static_cast<size_t>(file.tellg()), '\0');
+    file.seekg(0);
+    if (!file.read(bytes.data(), bytes.size())) {
+        return std::nullopt;
+    }
+    return parse(bytes);
+}
+
+// Writes a temporary file next to the entry and renames it over the entry, so readers see either the old or the new
+// one. No fsync: after a crash the checksum throws out a half written entry, which only costs a re-decode.
+void store(const std::string& entryPath, const CacheEntry& entry)
+{
+    static std::atomic<unsigned> counter{0};
+    const std::string temporaryPath = entryPath + ".tmp." + std::to_string(getpid()) + "." + std::to_string(counter++);
+    const std::string bytes = serialize(entry);
+
+    const int fd = open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return; // the cache is best effort
+    }
+    size_t written = 0;
+    while (written < bytes.size()) {
+        const ssize_t result = ::write(fd, bytes.data() + written, bytes.size() - written);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            break;
+        }
+        written += result;
+    }
+    const bool complete = close(fd) == 0 && written == bytes.size();
+    if (!complete || rename(temporaryPath.c_str(), entryPath.c_str()) != 0) {
+        unlink(temporaryPath.c_str());
+    }
+}
+
+void writeEntry(const CacheEntry& entry, const std::string& path, bool indented, bool wrap, OutputBuffer& out)
+{
+    JsonWriter writer(out, indented);
+    if (wrap) {
+        writer.beginObject();
+        writer.key("File");
+        writer.string(path);
+        writer.key("Profile");
+    }
+    std::vector<SectionType> types;
+    for (const auto& section : entry.sections) {
+        types.push_back(static_cast<SectionType>(section.type));
+    }
+    const auto replaced = replacedSections(types);
+    writer.beginObject();
+    for (size_t i = 0; i < entry.sections.size(); ++i) {
+        if (!replaced[i]) {
+            writer.key(sectionName(types[i]));
+            writer.raw(entry.sections[i].json.data(), entry.sections[i].json.size());
+        }
+    }
+    writer.endObject();
+    if (wrap) {
+        writer.endObject();
+    }
+    out.append('\n');
+}
+}
+
+ProfileCache::ProfileCache(const std::string& directory)
+    : directory(directory)
+{
+    std::error_code error;
+    const bool created = std::filesystem::create_directories(directory, error);
+    if (error) {
+        throw std::runtime_error("Couldn't create cache directory " + directory + ": " + error.message());
+    }
+    // Entries hold whole decoded profiles, secret keys included. A directory the user already had keeps its mode,
+    // the entry files are 0600 either way.
+    if (created) {
+        chmod(directory.c_str(), 0700);
+    }
+}
+
+// Indented and compact output (and batch and single file output) are cached separately.
+std::string ProfileCache::entryPath(const std::string& profilePath, uint32_t flags) const
+{
+    char name[40];
+    snprintf(name, sizeof(name), "/%016llx-%u.idx",
+             static_cast<unsigned long long>(hashBytes(reinterpret_cast<const uint8_t*>(profilePath.data()),
+                                                       profilePath.size())), flags);
+    return directory + name;
+}
+
+bool ProfileCache::write(const std::string& path, const OutputOptions& options, OutputBuffer& out, bool wrap,
+                         uint64_t& profileSize)
+{
+    // entries hold whole, intact profiles
+    if (options.format != OutputFormat::json || options.selection || options.salvage) {
+        return false;
+    }
+
+    struct stat fileInfo;
+    if (stat(path.c_str(), &fileInfo) != 0) {
+        throw std::runtime_error("Couldn't stat " + path + ": " + strerror(errno));
+    }
+
+    std::error_code error;
+    const std::string absolutePath = std::filesystem::absolute(path, error).string();
+    const uint32_t flags = (options.indented ? indentedFlag : 0) | (wrap ? wrappedFlag : 0);
+    const std::string entryFile = entryPath(absolutePath, flags);
+
+    auto cached = load(entryFile);
+    if (cached && (cached->path != absolutePath || cached->flags != flags)) {
+        cached.reset();
+    }
+
+    CacheEntry entry;
+    entry.flags = flags;
+    entry.path = absolutePath;
+    entry.size = fileInfo.st_size;
+    profileSize = entry.size;
+    // A file changed again within the same timestamp tick would keep its size and mtime, so entries of files
+    // modified just now are stored without an mtime and get hashed on the next run.
+    if (fileInfo.st_mtim.tv_sec < time(nullptr) - 1) {
+        entry.mtimeSeconds = fileInfo.st_mtim.tv_sec;
+        entry.mtimeNanoseconds = fileInfo.st_mtim.tv_nsec;
+    }
+
+    if (cached && cached->size == entry.size && cached->mtimeSeconds != 0
+        && cached->mtimeSeconds == fileInfo.st_mtim.tv_sec && cached->mtimeNanoseconds == fileInfo.st_mtim.tv_nsec) {
+        ++hits;
+        writeEntry(*cached, path, options.indented, wrap, out);
+        return true;
+    }
+
+    MappedFile file(path);
+    if (isEncryptedSave(file.data(), file.size())) {
+        return false;
+    }
+    entry.contentHash = hashBytes(file.data(), file.size());
+
+    if (cached && cached->contentHash == entry.contentHash && cached->size == file.size()) {
+        // touched but not changed
+        entry.sections = std::move(cached->sections);
+        ++hits;
+    } else {
+        Cursor data(file.data(), file.size());
+        parseGlobalHeader(data);
+        size_t reused = 0;
+        const std::vector<CachedSection> none;
+        const auto& previousSections = cached ? cached->sections : none;
+        for (const auto& header : getAllSections(data)) {
+            CachedSection section;
+            section.offset = static_cast<uint32_t>(header.data - file.data());
+            section.size = header.size;
+            section.type = static_cast<uint16_t>(header.type);
+            section.hash = hashBytes(header.data, header.size);
+
+            const CachedSection* previous = nullptr;
+            for (const auto& candidate : previousSections) {
+                if (candidate.type == section.type && candidate.size == section.size && candidate.hash == section.hash) {
+                    previous = &candidate;
+                    break;
+                }
+            }
+            if (previous) {
+                section.json = previous->json;
+                ++reused;
+            } else {
+                thread_local OutputBuffer sectionBuffer;
+                sectionBuffer.clear();
+                JsonWriter writer(sectionBuffer, options.indented, wrap ? 2 : 1);
+                writeSection(header, writer);
+                section.json.assign(sectionBuffer.data(), sectionBuffer.size());
+            }
+            entry.sections.push_back(std::move(section));
+        }
+        if (reused > 0) {
+            ++partialHits;
+        }
+    }
+
+    writeEntry(entry, path, options.indented, wrap, out);
+    store(entryFile, entry);
+    return true;
+}
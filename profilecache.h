@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>    // for atomic
+#include <cstddef>   // for size_t
+#include <cstdint>   // for uint32_t, uint64_t
+#include <string>    // for string
+#include "output.h"  // for OutputOptions
+
+class OutputBuffer;
+
+// On-disk cache of decoded profiles for the json format, one entry file per profile in a cache directory. An entry
+// holds the profile's path, size, mtime and content hash, its section table (offset, type, size and payload hash of
+// each section) and every section's serialized JSON.
+//
+// A profile whose size and mtime match its entry is written from the entry without being opened. Otherwise it's
+// hashed: if only the mtime changed the entry is reused as is, if the contents changed only the sections whose
+// payload hash isn't in the entry are decoded again. Entries are replaced by writing a temporary file and renaming it
+// over the old one, and carry a checksum, so concurrent runs and crashes leave either a complete entry or one that is
+// ignored. Encrypted profiles are never cached, that would put their plaintext on disk.
+class ProfileCache {
+public:
+    // Creates directory if needed. Throws std::runtime_error if that fails.
+    explicit ProfileCache(const std::string& directory);
+
+    // Appends the same output as writeProfileOutput(data, options, out, wrap ? path : "") to out, sets profileSize and
+    // returns true, or returns false without writing anything if the profile can't be cached (encrypted, a format other
+    // than json, a selection or salvaging). Throws std::runtime_error like writeProfileOutput for unreadable or broken
+    // profiles.
+    bool write(const std::string& path, const OutputOptions& options, OutputBuffer& out, bool wrap,
+               uint64_t& profileSize);
+
+    // profiles written without decoding anything / with only some sections decoded
+    std::atomic<size_t> hits{0};
+    std::atomic<size_t> partialHits{0};
+
+private:
+    std::string entryPath(const std::string& profilePath, uint32_t flags) const;
+
+    std::string directory;
+};
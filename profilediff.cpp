@@ -0,0 +1,479 @@
+#include "profilediff.h"
+#include <cstdint>        // for uint8_t, uint64_t
+#include <cstring>        // for memcmp
+#include <string>         // for string
+#include <string_view>    // for string_view
+#include <unordered_map>  // for unordered_map
+#include <vector>         // for vector
+#include "conferenceindex.h"  // for ConferenceIndex
+#include "cursor.h"       // for Cursor
+#include "hash.h"         // for hashBytes
+#include "nodeinfo.h"     // for writeNodeInfo
+#include "profile.h"      // for Profile, FriendView, NodeView, ...
+#include "sections.h"     // for SectionHeader, SectionType, sectionToString
+#include "utils.h"        // for FriendStatusToString, userStatusToString
+#include "writer.h"       // for Writer, writeString
+
+namespace {
+std::string_view bytesOf(const uint8_t* data, size_t size)
+{
+    return {reinterpret_cast<const char*>(data), size};
+}
+
+std::string_view bytesOf(PublicKey key)
+{
+    return bytesOf(key.data(), key.size());
+}
+
+void stringValue(std::string_view value, Writer& out)
+{
+    writeString(reinterpret_cast<const uint8_t*>(value.data()), value.size(), out);
+}
+
+// Writes key: {"Old": ..., "New": ...} if the values differ.
+template <typename T, typename Write>
+void changedValue(const char* key, const T& before, const T& after, Write write, Writer& out)
+{
+    if (before == after) {
+        return;
+    }
+    out.key(key);
+    out.beginObject();
+    out.key("Old");
+    write(before);
+    out.key("New");
+    write(after);
+    out.endObject();
+}
+
+void changedString(const char* key, std::string_view before, std::string_view after, Writer& out)
+{
+    changedValue(key, before, after, [&](std::string_view value) { stringValue(value, out); }, out);
+}
+
+void oldAndNew(std::string_view before, std::string_view after, Writer& out)
+{
+    out.beginObject();
+    out.key("Old");
+    stringValue(before, out);
+    out.key("New");
+    stringValue(after, out);
+    out.endObject();
+}
+
+void changedHex(const char* key, std::span<const uint8_t> before, std::span<const uint8_t> after, Writer& out)
+{
+    changedValue(key, bytesOf(before.data(), before.size()), bytesOf(after.data(), after.size()),
+                 [&](std::string_view value) { out.hex(reinterpret_cast<const uint8_t*>(value.data()), value.size()); },
+                 out);
+}
+
+// Sections of one type with their payload hashes, in file order.
+struct SectionHashes {
+    SectionType type;
+    std::vector<uint64_t> hashes;
+    std::vector<uint32_t> sizes;
+
+    bool operator==(const SectionHashes& other) const { return hashes == other.hashes && sizes == other.sizes; }
+};
+
+std::vector<SectionHashes> hashSections(const Profile& profile)
+{
+    std::vector<SectionHashes> result;
+    for (const auto& section : profile.sections()) {
+        SectionHashes* entry = nullptr;
+        for (auto& existing : result) {
+            if (existing.type == section.type) {
+                entry = &existing;
+            }
+        }
+        if (!entry) {
+            result.push_back({section.type, {}, {}});
+            entry = &result.back();
+        }
+        entry->hashes.push_back(hashBytes(section.data, section.size));
+        entry->sizes.push_back(section.size);
+    }
+    return result;
+}
+
+void friendSummary(FriendView friendView, Writer& out)
+{
+    out.beginObject();
+    out.key("Long term public key");
+    out.hex(friendView.publicKey().data(), friendView.publicKey().size());
+    out.key("Name as a byte string");
+    stringValue(friendView.name(), out);
+    out.endObject();
+}
+
+void diffFriends(FriendList before, FriendList after, Writer& out)
+{
+    std::unordered_map<std::string_view, FriendView> beforeByKey;
+    beforeByKey.reserve(before.size());
+    for (auto friendView : before) {
+        beforeByKey.emplace(bytesOf(friendView.publicKey()), friendView);
+    }
+
+    std::vector<FriendView> added;
+    std::vector<std::pair<FriendView, FriendView>> changed;
+    for (auto friendView : after) {
+        auto found = beforeByKey.find(bytesOf(friendView.publicKey()));
+        if (found == beforeByKey.end()) {
+            added.push_back(friendView);
+            continue;
+        }
+        // most friends don't change between snapshots, comparing the whole record settles those
+        if (memcmp(found->second.data(), friendView.data(), FriendView::recordSize) != 0) {
+            changed.emplace_back(found->second, friendView);
+        }
+        beforeByKey.erase(found);
+    }
+
+    out.beginObject();
+    out.key("Added");
+    out.beginArray();
+    for (auto friendView : added) {
+        friendSummary(friendView, out);
+    }
+    out.endArray();
+
+    out.key("Removed");
+    out.beginArray();
+    // walk the old list rather than the map, so the order is stable
+    for (auto friendView : before) {
+        if (beforeByKey.count(bytesOf(friendView.publicKey()))) {
+            friendSummary(friendView, out);
+        }
+    }
+    out.endArray();
+
+    out.key("Changed");
+    out.beginArray();
+    for (const auto& [old, updated] : changed) {
+        out.beginObject();
+        out.key("Long term public key");
+        out.hex(updated.publicKey().data(), updated.publicKey().size());
+        changedValue("Status", old.status(), updated.status(),
+                     [&](FriendStatus status) { out.string(FriendStatusToString(status)); }, out);
+        changedString("Friend request message as a byte string", old.requestMessage(), updated.requestMessage(), out);
+        changedString("Name as a byte string", old.name(), updated.name(), out);
+        changedString("Status message as a byte string", old.statusMessage(), updated.statusMessage(), out);
+        changedValue("User status", old.userStatus(), updated.userStatus(),
+                     [&](UserStatus status) { out.string(userStatusToString(status)); }, out);
+        changedHex("Nospam (only used for sending a friend request)", old.nospam(), updated.nospam(), out);
+        changedValue("Last seen time", old.lastSeen(), updated.lastSeen(),
+                     [&](uint64_t time) { out.timestamp(time); }, out);
+        out.endObject();
+    }
+    out.endArray();
+    out.endObject();
+}
+
+void nodeValue(NodeView node, Writer& out)
+{
+    Cursor data(node.data(), node.size());
+    writeNodeInfo(data, out);
+}
+
+void diffNodes(NodeList before, NodeList after, Writer& out)
+{
+    // Nodes are compared as whole records first, since the same key can be listed with several addresses. Of the
+    // records only on one side, those sharing a key are reported as that node having moved.
+    auto recordOf = [](NodeView node) { return bytesOf(node.data(), node.size()); };
+
+    std::unordered_map<std::string_view, size_t> beforeRecords;
+    for (auto node : before) {
+        ++beforeRecords[recordOf(node)];
+    }
+    std::vector<NodeView> added;
+    for (auto node : after) {
+        auto found = beforeRecords.find(recordOf(node));
+        if (found != beforeRecords.end() && found->second > 0) {
+            --found->second;
+        } else {
+            added.push_back(node);
+        }
+    }
+    std::vector<NodeView> removed;
+    for (auto node : before) {
+        auto& count = beforeRecords[recordOf(node)];
+        if (count > 0) {
+            --count;
+            removed.push_back(node);
+        }
+    }
+
+    std::unordered_map<std::string_view, size_t> removedByKey;
+    for (size_t i = 0; i < removed.size(); ++i) {
+        removedByKey.emplace(bytesOf(removed[i].publicKey()), i);
+    }
+    std::vector<bool> moved(removed.size(), false);
+    std::vector<std::pair<NodeView, NodeView>> changed;
+    std::vector<NodeView> reallyAdded;
+    for (auto node : added) {
+        auto found = removedByKey.find(bytesOf(node.publicKey()));
+        if (found != removedByKey.end()) {
+            changed.emplace_back(removed[found->second], node);
+            moved[found->second] = true;
+            removedByKey.erase(found);
+        } else {
+            reallyAdded.push_back(node);
+        }
+    }
+
+    out.beginObject();
+    out.key("Added");
+    out.beginArray();
+    for (auto node : reallyAdded) {
+        nodeValue(node, out);
+    }
+    out.endArray();
+    out.key("Removed");
+    out.beginArray();
+    for (size_t i = 0; i < removed.size(); ++i) {
+        if (!moved[i]) {
+            nodeValue(removed[i], out);
+        }
+    }
+    out.endArray();
+    out.key("Changed");
+    out.beginArray();
+    for (const auto& [old, updated] : changed) {
+        out.beginObject();
+        out.key("Old");
+        nodeValue(old, out);
+        out.key("New");
+        nodeValue(updated, out);
+        out.endObject();
+    }
+    out.endArray();
+    out.endObject();
+}
+
+void peerSummary(ConferencePeerView peer, Writer& out)
+{
+    out.beginObject();
+    out.key("Long term public key");
+    out.hex(peer.publicKey().data(), peer.publicKey().size());
+    out.key("Name");
+    stringValue(peer.name(), out);
+    out.endObject();
+}
+
+// The peers of conference as stored, checked by the index.
+std::vector<ConferencePeerView> peersOf(const ConferenceIndex& index, size_t conference)
+{
+    std::vector<ConferencePeerView> peers;
+    peers.reserve(index.peerCount(conference));
+    for (size_t i = 0; i < index.peerCount(conference); ++i) {
+        peers.emplace_back(index.peer(conference, i));
+    }
+    return peers;
+}
+
+void diffPeers(const std::vector<ConferencePeerView>& before, const std::vector<ConferencePeerView>& after,
+               Writer& out)
+{
+    std::unordered_map<std::string_view, ConferencePeerView> beforeByKey;
+    for (auto peer : before) {
+        beforeByKey.emplace(bytesOf(peer.publicKey()), peer);
+    }
+    out.key("Peers added");
+    out.beginArray();
+    for (auto peer : after) {
+        if (!beforeByKey.erase(bytesOf(peer.publicKey()))) {
+            peerSummary(peer, out);
+        }
+    }
+    out.endArray();
+    out.key("Peers removed");
+    out.beginArray();
+    for (auto peer : before) {
+        if (beforeByKey.count(bytesOf(peer.publicKey()))) {
+            peerSummary(peer, out);
+        }
+    }
+    out.endArray();
+}
+
+void conferenceSummary(ConferenceView conference, Writer& out)
+{
+    out.beginObject();
+    out.key("Groupchat id");
+    out.hex(conference.id().data(), conference.id().size());
+    out.key("Title");
+    stringValue(conference.title(), out);
+    out.endObject();
+}
+
+// The first Conferences section of profile, indexed; throws std::runtime_error if a record runs past its end, before
+// any count or length in it is believed.
+ConferenceIndex indexConferences(const Profile& profile)
+{
+    const auto* section = profile.section(SectionType::conferences);
+    return ConferenceIndex(section ? section->payload() : Cursor());
+}
+
+void diffConferences(const Profile& beforeProfile, const Profile& afterProfile, Writer& out)
+{
+    const auto before = indexConferences(beforeProfile);
+    const auto after = indexConferences(afterProfile);
+
+    std::unordered_map<std::string_view, size_t> beforeById;
+    for (size_t i = 0; i < before.size(); ++i) {
+        beforeById.emplace(bytesOf(ConferenceView(before.conference(i)).id()), i);
+    }
+
+    std::vector<size_t> added;
+    std::vector<std::pair<size_t, size_t>> changed;
+    for (size_t i = 0; i < after.size(); ++i) {
+        auto found = beforeById.find(bytesOf(ConferenceView(after.conference(i)).id()));
+        if (found == beforeById.end()) {
+            added.push_back(i);
+            continue;
+        }
+        const auto size = after.conferenceSize(i);
+        if (before.conferenceSize(found->second) != size
+            || memcmp(before.conference(found->second), after.conference(i), size) != 0) {
+            changed.emplace_back(found->second, i);
+        }
+        beforeById.erase(found);
+    }
+
+    out.beginObject();
+    out.key("Added");
+    out.beginArray();
+    for (auto i : added) {
+        conferenceSummary(ConferenceView(after.conference(i)), out);
+    }
+    out.endArray();
+    out.key("Removed");
+    out.beginArray();
+    for (size_t i = 0; i < before.size(); ++i) {
+        const ConferenceView conference(before.conference(i));
+        if (beforeById.count(bytesOf(conference.id()))) {
+            conferenceSummary(conference, out);
+        }
+    }
+    out.endArray();
+    out.key("Changed");
+    out.beginArray();
+    for (const auto& [oldIndex, updatedIndex] : changed) {
+        const ConferenceView old(before.conference(oldIndex));
+        const ConferenceView updated(after.conference(updatedIndex));
+        out.beginObject();
+        out.key("Groupchat id");
+        out.hex(updated.id().data(), updated.id().size());
+        changedString("Title", old.title(), updated.title(), out);
+        diffPeers(peersOf(before, oldIndex), peersOf(after, updatedIndex), out);
+        out.endObject();
+    }
+    out.endArray();
+    out.endObject();
+}
+
+void diffSection(SectionType type, const Profile& before, const Profile& after, Writer& out)
+{
+    switch (type) {
+    case SectionType::nospamkeys:
+        out.beginObject();
+        changedHex("Nospam", before.nospam(), after.nospam(), out);
+        changedHex("Long term public key", before.publicKey(), after.publicKey(), out);
+        changedHex("Long term secret key", before.secretKey(), after.secretKey(), out);
+        out.endObject();
+        break;
+    case SectionType::dht:
+        diffNodes(before.dhtNodes(), after.dhtNodes(), out);
+        break;
+    case SectionType::friends:
+        diffFriends(before.friends(), after.friends(), out);
+        break;
+    case SectionType::name:
+        oldAndNew(before.name(), after.name(), out);
+        break;
+    case SectionType::statusmessage:
+        oldAndNew(before.statusMessage(), after.statusMessage(), out);
+        break;
+    case SectionType::status:
+        oldAndNew(userStatusToString(before.status()), userStatusToString(after.status()), out);
+        break;
+    case SectionType::tcpRelay:
+        diffNodes(before.tcpRelays(), after.tcpRelays(), out);
+        break;
+    case SectionType::pathNode:
+        diffNodes(before.pathNodes(), after.pathNodes(), out);
+        break;
+    case SectionType::conferences:
+        diffConferences(before, after, out);
+        break;
+    default: {
+        // unknown section, nothing to decode
+        const auto* old = before.section(type);
+        const auto* updated = after.section(type);
+        out.beginObject();
+        out.key("Old size");
+        out.number(old ? old->size : 0);
+        out.key("New size");
+        out.number(updated ? updated->size : 0);
+        out.endObject();
+    }
+    }
+}
+}
+
+void writeProfileDiff(const Profile& before, const Profile& after, Writer& out)
+{
+    const auto beforeHashes = hashSections(before);
+    const auto afterHashes = hashSections(after);
+
+    // every section type in either save, in the order they first appear
+    std::vector<SectionType> types;
+    for (const auto* list : {&beforeHashes, &afterHashes}) {
+        for (const auto& entry : *list) {
+            bool seen = false;
+            for (auto type : types) {
+                seen |= type == entry.type;
+            }
+            if (!seen) {
+                types.push_back(entry.type);
+            }
+        }
+    }
+
+    auto find = [](const std::vector<SectionHashes>& list, SectionType type) -> const SectionHashes* {
+        for (const auto& entry : list) {
+            if (entry.type == type) {
+                return &entry;
+            }
+        }
+        return nullptr;
+    };
+    std::vector<SectionType> unchanged;
+    std::vector<SectionType> changed;
+    for (auto type : types) {
+        const auto* old = find(beforeHashes, type);
+        const auto* updated = find(afterHashes, type);
+        if (old && updated && *old == *updated) {
+            unchanged.push_back(type);
+        } else {
+            changed.push_back(type);
+        }
+    }
+
+    out.beginObject();
+    out.key("Unchanged sections");
+    out.beginArray();
+    for (auto type : unchanged) {
+        out.string(sectionToString(type));
+    }
+    out.endArray();
+    out.key("Changed sections");
+    out.beginObject();
+    for (auto type : changed) {
+        out.key(sectionName(type));
+        diffSection(type, before, after, out);
+    }
+    out.endObject();
+    out.endObject();
+}
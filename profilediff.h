@@ -0,0 +1,10 @@
+#pragma once
+
+class Profile;
+class Writer;
+
+// Writes what changed from before to after as one object:
+//   "Unchanged sections": names of the sections whose payloads hash the same, which aren't decoded at all
+//   "Changed sections": for each other section only its differences. Friends, nodes and conferences (and their peers)
+//     are matched by public key / id into "Added", "Removed" and "Changed" lists, single values become {"Old", "New"}.
+void writeProfileDiff(const Profile& before, const Profile& after, Writer& out);
@@ -0,0 +1,83 @@
+#include "qtjsonwriter.h"
+#include <qdatetime.h>    // for QDateTime
+#include <qnamespace.h>   // for ISODate
+#include "utils.h"        // for readHexData
+
+void QtJsonWriter::beginObject()
+{
+    stack.push_back({QJsonObject(), QJsonArray(), false, pendingKey});
+}
+
+void QtJsonWriter::endObject()
+{
+    auto container = std::move(stack.back());
+    stack.pop_back();
+    pendingKey = container.key;
+    add(container.object);
+}
+
+void QtJsonWriter::beginArray()
+{
+    stack.push_back({QJsonObject(), QJsonArray(), true, pendingKey});
+}
+
+void QtJsonWriter::endArray()
+{
+    auto container = std::move(stack.back());
+    stack.pop_back();
+    pendingKey = container.key;
+    add(container.array);
+}
+
+void QtJsonWriter::key(const char* name)
+{
+    pendingKey = name;
+}
+
+void QtJsonWriter::string(const char* data, size_t length)
+{
+    add(QString::fromUtf8(data, static_cast<int>(length)));
+}
+
+void QtJsonWriter::number(int64_t value)
+{
+    add(static_cast<qint64>(value));
+}
+
+void QtJsonWriter::hex(const uint8_t* data, size_t length)
+{
+    add(readHexData(data, static_cast<int>(length)).c_str());
+}
+
+void QtJsonWriter::timestamp(uint64_t secondsSinceEpoch)
+{
+    QDateTime timestamp;
+    timestamp.setTime_t(secondsSinceEpoch);
+    add(timestamp.toString(Qt::ISODate));
+}
+
+std::unique_ptr<Writer> QtJsonWriter::fork(size_t) const
+{
+    std::unique_ptr<QtJsonWriter> forked(new QtJsonWriter);
+    forked->stack.push_back({QJsonObject(), QJsonArray(), true, QString()});
+    return forked;
+}
+
+void QtJsonWriter::splice(Writer& fork)
+{
+    const auto& forked = static_cast<QtJsonWriter&>(fork);
+    for (const auto& value : forked.stack.front().array) {
+        add(value);
+    }
+}
+
+void QtJsonWriter::add(const QJsonValue& value)
+{
+    if (stack.empty()) {
+        root = value;
+    } else if (stack.back().isArray) {
+        stack.back().array.append(value);
+    } else {
+        stack.back().object.insert(pendingKey, value);
+    }
+}
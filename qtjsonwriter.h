@@ -0,0 +1,44 @@
+#pragma once
+
+#include <qjsonarray.h>   // for QJsonArray
+#include <qjsonobject.h>  // for QJsonObject
+#include <qjsonvalue.h>   // for QJsonValue
+#include <qstring.h>      // for QString
+#include <cstddef>        // for size_t
+#include <cstdint>        // for int64_t, uint8_t, uint64_t
+#include <memory>         // for unique_ptr
+#include <vector>         // for vector
+#include "writer.h"
+
+// Builds a QJsonValue tree, for output through QJsonDocument.
+class QtJsonWriter : public Writer {
+public:
+    void beginObject() override;
+    void endObject() override;
+    void beginArray() override;
+    void endArray() override;
+    void key(const char* name) override;
+    void string(const char* data, size_t length) override;
+    void number(int64_t value) override;
+    void hex(const uint8_t* data, size_t length) override;
+    void timestamp(uint64_t secondsSinceEpoch) override;
+    using Writer::string;
+    std::unique_ptr<Writer> fork(size_t nested = 0) const override;
+    void splice(Writer& fork) override;
+
+    const QJsonValue& result() const { return root; }
+
+private:
+    struct Container {
+        QJsonObject object;
+        QJsonArray array;
+        bool isArray;
+        QString key; // the key this container is stored under in its parent
+    };
+
+    void add(const QJsonValue& value);
+
+    std::vector<Container> stack;
+    QString pendingKey;
+    QJsonValue root;
+};
@@ -0,0 +1,43 @@
+#include "qtprofile.h"
+#include <qtconcurrentmap.h>  // for blockingMappedReduced
+#include <algorithm>          // for find
+#include "decoders.h"         // for writeSection
+#include "executionplan.h"    // for planSections
+#include "qtjsonwriter.h"     // for QtJsonWriter
+#include "sections.h"         // for getAllSections, parseGlobalHeader, sectionToString
+
+parsedSection convertSectionToJson(SectionHeader sectionHeader)
+{
+    parsedSection ret;
+    ret.header = sectionHeader;
+    ret.sectionName = sectionToString(sectionHeader.type);
+
+    QtJsonWriter writer;
+    writeSection(sectionHeader, writer);
+    ret.json = writer.result();
+
+    return ret;
+}
+
+void combineJson(QJsonObject &rootNode, const parsedSection &node)
+{
+    rootNode.insert(sectionToString(node.header.type).c_str(), node.json);
+}
+
+QJsonObject parseProfile(Cursor data, bool parallel)
+{
+    parseGlobalHeader(data);
+    auto sections = getAllSections(data);
+
+    const auto spread = planSections(sections);
+    if (!parallel || std::find(spread.begin(), spread.end(), true) == spread.end()) {
+        QJsonObject result;
+        for (const auto& section : sections) {
+            combineJson(result, convertSectionToJson(section));
+        }
+        return result;
+    }
+
+    // only when the sections are big enough for it, see planSections()
+    return QtConcurrent::blockingMappedReduced<QJsonObject>(sections.begin(), sections.end(), convertSectionToJson, combineJson);
+}
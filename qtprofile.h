@@ -0,0 +1,24 @@
+#pragma once
+
+#include <qjsonobject.h>  // for QJsonObject
+#include <qjsonvalue.h>   // for QJsonValue
+#include <string>         // for string
+#include "cursor.h"       // for Cursor
+#include "sections.h"     // for SectionHeader
+
+// The QJsonObject front end of the decoders, for Qt applications (the toxsave_qt library). The command line tool
+// writes the same document without Qt through writeSortedProfile().
+
+struct parsedSection {
+    QJsonValue json;
+    SectionHeader header;
+    std::string sectionName;
+};
+
+parsedSection convertSectionToJson(SectionHeader sectionHeader);
+void combineJson(QJsonObject &rootNode, const parsedSection &node);
+
+// Parses a whole mapped save. With parallel set the sections are spread over Qt's global thread pool if the planner
+// finds them worth it (executionplan.h), otherwise they are decoded on the calling thread (used when whole files are
+// already being run in parallel).
+QJsonObject parseProfile(Cursor data, bool parallel = true);
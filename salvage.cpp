@@ -0,0 +1,186 @@
+#include "salvage.h"
+#include <algorithm>        // for sort, upper_bound
+#include <cstdint>          // for uint8_t
+#include <exception>        // for exception
+#include <vector>           // for vector
+#include "cursor.h"         // for Cursor
+#include "decoders.h"       // for writeSection
+#include "document.h"       // for Arena, DocumentNode, DocumentWriter, writeDocument
+#include "sectionscan.h"    // for findSectionHeaders
+#include "sections.h"       // for SectionHeader, SectionType, getSection, isKnownSection, parseGlobalHeader, se...
+#include "stats.h"          // for StageTimer
+#include "writer.h"         // for Writer
+
+namespace {
+const size_t globalHeaderSize = 8;
+const size_t sectionHeaderSize = 8;
+
+// A section header found by the scan whose payload decoded.
+struct Candidate {
+    SectionHeader header;
+    size_t begin; // offset of the header
+    size_t end;   // offset past the payload
+    const DocumentNode* document; // nullptr for EOF and unknown sections, which are written directly
+};
+
+// Of candidates sorted by end, the non-overlapping ones covering the most bytes (weighted interval scheduling).
+std::vector<const Candidate*> pickSections(const std::vector<Candidate>& candidates)
+{
+    std::vector<size_t> ends(candidates.size());
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        ends[i] = candidates[i].end;
+    }
+
+    // covered[i]: the most bytes covered by the first i candidates, previous[i]: how many candidates end before the
+    // i-th (1-based) begins
+    std::vector<size_t> covered(candidates.size() + 1, 0);
+    std::vector<size_t> previous(candidates.size() + 1, 0);
+    for (size_t i = 1; i <= candidates.size(); ++i) {
+        const Candidate& candidate = candidates[i - 1];
+        previous[i] = std::upper_bound(ends.begin(), ends.begin() + (i - 1), candidate.begin) - ends.begin();
+        covered[i] = std::max(covered[i - 1], covered[previous[i]] + candidate.end - candidate.begin);
+    }
+
+    std::vector<const Candidate*> picked;
+    for (size_t i = candidates.size(); i > 0;) {
+        const Candidate& candidate = candidates[i - 1];
+        if (covered[i] == covered[previous[i]] + candidate.end - candidate.begin) {
+            picked.push_back(&candidate);
+            i = previous[i];
+        } else {
+            --i;
+        }
+    }
+    std::reverse(picked.begin(), picked.end());
+    return picked;
+}
+
+// The sections of unknown type that fill the bytes between from and to exactly, one after another, or none if they
+// don't. The scan never keeps unknown types on their own (anything decodes as one), but between two kept sections
+// their sizes have to line up, so they are as safe as any other section there.
+std::vector<SectionHeader> unknownSectionsBetween(const uint8_t* save, size_t from, size_t to)
+{
+    std::vector<SectionHeader> sections;
+    Cursor gap(save + from, to - from);
+    try {
+        while (!gap.atEnd()) {
+            const auto section = getSection(gap);
+            if (isKnownSection(section.type)) {
+                return {};
+            }
+            gap.take(section.size, "section");
+            sections.push_back(section);
+        }
+    }
+    catch (const std::exception&) {
+        return {};
+    }
+    return sections;
+}
+
+void writeSkippedRange(size_t offset, size_t length, Writer& out)
+{
+    out.beginObject();
+    out.key("Offset");
+    out.number(static_cast<int64_t>(offset));
+    out.key("Length");
+    out.number(static_cast<int64_t>(length));
+    out.endObject();
+}
+}
+
+void writeSalvagedProfile(Cursor data, Writer& out)
+{
+    const uint8_t* const save = data.data();
+    const size_t size = data.remaining();
+
+    // an intact global header counts as covered, and no section can start inside it
+    size_t start = 0;
+    try {
+        Cursor header = data;
+        parseGlobalHeader(header);
+        start = globalHeaderSize;
+    }
+    catch (const std::exception&) {
+    }
+
+    // the decoded sections are kept in the arena until they're written out, so nothing is decoded twice
+    Arena arena;
+    std::vector<SectionHeader> headers;
+    {
+        StageTimer timer(Stage::sections);
+        headers = findSectionHeaders(save, size);
+    }
+
+    std::vector<Candidate> kept;
+    {
+        StageTimer timer(Stage::decode);
+        std::vector<Candidate> candidates;
+        for (const auto& header : headers) {
+            const size_t begin = header.data - save - sectionHeaderSize;
+            if (begin < start) {
+                continue;
+            }
+            Candidate candidate{header, begin, begin + sectionHeaderSize + header.size, nullptr};
+            if (header.type != SectionType::eof) {
+                try {
+                    DocumentWriter writer(arena, save, size);
+                    writeSection(header, writer);
+                    candidate.document = writer.result();
+                }
+                catch (const std::exception&) {
+                    continue;
+                }
+            }
+            candidates.push_back(candidate);
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+            return a.end < b.end;
+        });
+        const auto sections = pickSections(candidates);
+
+        // the kept sections, with the unknown ones that fit between them
+        size_t covered = start;
+        for (const auto* section : sections) {
+            for (const auto& header : unknownSectionsBetween(save, covered, section->begin)) {
+                const size_t begin = header.data - save - sectionHeaderSize;
+                kept.push_back({header, begin, begin + sectionHeaderSize + header.size, nullptr});
+            }
+            kept.push_back(*section);
+            covered = section->end;
+        }
+    }
+
+    StageTimer timer(Stage::serialize);
+    std::vector<SectionType> types;
+    for (const auto& section : kept) {
+        types.push_back(section.header.type);
+    }
+    const auto replaced = replacedSections(types);
+    out.beginObject();
+    for (size_t i = 0; i < kept.size(); ++i) {
+        const auto& section = kept[i];
+        if (section.header.type != SectionType::eof && !replaced[i]) {
+            out.key(sectionName(section.header.type));
+            if (section.document) {
+                writeDocument(*section.document, out);
+            } else {
+                writeSection(section.header, out);
+            }
+        }
+    }
+    out.key("Skipped ranges");
+    out.beginArray();
+    size_t covered = start;
+    for (const auto& section : kept) {
+        if (section.begin > covered) {
+            writeSkippedRange(covered, section.begin - covered, out);
+        }
+        covered = section.end;
+    }
+    if (covered < size) {
+        writeSkippedRange(covered, size - covered, out);
+    }
+    out.endArray();
+    out.endObject();
+}
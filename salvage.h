@@ -0,0 +1,13 @@
+#pragma once
+
+#include "cursor.h"  // for Cursor
+
+class Writer;
+
+// Recovers what it can from a damaged or truncated save. Instead of following the section sizes from the global header
+// on, which stops at the first broken header, the whole save is searched for section headers (findSectionHeaders()).
+// Each one found is decoded, and of those that decode the non-overlapping set covering the most bytes is kept, which
+// for an undamaged save is its chain of sections. Writes the same object as writeProfile(), with the kept sections in
+// save order, plus a "Skipped ranges" member listing the byte ranges that no kept section (or the global header)
+// covers, each as {"Offset", "Length"}.
+void writeSalvagedProfile(Cursor data, Writer& out);
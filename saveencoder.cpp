@@ -0,0 +1,85 @@
+#include "saveencoder.h"
+#include <cstdint>         // for uint16_t, uint32_t, UINT32_MAX
+#include <stdexcept>       // for runtime_error
+#include "decoders.h"      // for dhtStateCookie, dhtNodesSectionType, dhtInnerSectionMagic, dhtHeaderSize
+#include "outputbuffer.h"  // for OutputBuffer
+#include "utils.h"         // for storeNumber, Endianness
+
+namespace {
+const uint32_t globalHeader1 = 0x0;
+const uint32_t globalHeader2 = 0x15ed1b1f;
+const uint16_t sectionMagic = 0x01ce;
+}
+
+SaveEncoder::SaveEncoder(OutputBuffer& out)
+    : out(out)
+{
+    uint8_t header[8];
+    storeNumber<Endianness::little>(header, globalHeader1);
+    storeNumber<Endianness::little>(header + 4, globalHeader2);
+    out.append(reinterpret_cast<const char*>(header), sizeof(header));
+}
+
+void SaveEncoder::beginSection(SectionType type, size_t size)
+{
+    checkSectionEnd();
+    if (size > UINT32_MAX) {
+        throw std::runtime_error("Section too large for a tox save");
+    }
+    uint8_t header[8];
+    storeNumber<Endianness::little>(header, static_cast<uint32_t>(size));
+    storeNumber<Endianness::little>(header + 4, static_cast<uint16_t>(type));
+    storeNumber<Endianness::little>(header + 6, sectionMagic);
+    out.append(reinterpret_cast<const char*>(header), sizeof(header));
+    sectionLeft = size;
+}
+
+void SaveEncoder::append(const uint8_t* data, size_t size)
+{
+    if (size > sectionLeft) {
+        throw std::runtime_error("Section contents didn't match section size.");
+    }
+    out.append(reinterpret_cast<const char*>(data), size);
+    sectionLeft -= size;
+}
+
+void SaveEncoder::section(SectionType type, std::span<const uint8_t> payload)
+{
+    beginSection(type, payload.size());
+    append(payload.data(), payload.size());
+}
+
+void SaveEncoder::nodeSection(SectionType type, const std::vector<NodeView>& nodes)
+{
+    size_t nodesSize = 0;
+    for (const auto& node : nodes) {
+        nodesSize += node.size();
+    }
+
+    if (type == SectionType::dht) {
+        beginSection(type, dhtHeaderSize + nodesSize);
+        uint8_t header[dhtHeaderSize];
+        storeNumber<Endianness::little>(header, dhtStateCookie);
+        storeNumber<Endianness::little>(header + 4, static_cast<uint32_t>(nodesSize));
+        storeNumber<Endianness::little>(header + 8, dhtNodesSectionType);
+        storeNumber<Endianness::little>(header + 10, dhtInnerSectionMagic);
+        append(header, sizeof(header));
+    } else {
+        beginSection(type, nodesSize);
+    }
+    for (const auto& node : nodes) {
+        append(node.data(), node.size());
+    }
+}
+
+void SaveEncoder::finish()
+{
+    beginSection(SectionType::eof, 0);
+}
+
+void SaveEncoder::checkSectionEnd() const
+{
+    if (sectionLeft != 0) {
+        throw std::runtime_error("Section contents didn't match section size.");
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>     // for size_t
+#include <cstdint>     // for uint8_t
+#include <span>        // for span
+#include <vector>      // for vector
+#include "profile.h"   // for NodeView
+#include "sections.h"  // for SectionType
+
+class OutputBuffer;
+
+// Writes a tox save, the inverse of getAllSections() and the decoders: the global header, every section with its
+// header and 0x01ce magic, and the closing EOF section. Payloads are appended from wherever they already are (normally
+// the mapped save being rewritten), so the bytes are only copied once, into out.
+class SaveEncoder {
+public:
+    // Writes the global header.
+    explicit SaveEncoder(OutputBuffer& out);
+
+    // Starts a section with a payload of size bytes, which are appended next.
+    void beginSection(SectionType type, size_t size);
+    void append(const uint8_t* data, size_t size);
+    void section(SectionType type, std::span<const uint8_t> payload);
+    // A DHT, TCP relay or path node section listing nodes. DHT nodes are wrapped in the state cookie and the nodes
+    // inner section, as getDht() expects them.
+    void nodeSection(SectionType type, const std::vector<NodeView>& nodes);
+    // Writes the EOF section.
+    void finish();
+
+private:
+    // Throws std::runtime_error unless the open section got all the bytes it was begun with.
+    void checkSectionEnd() const;
+
+    OutputBuffer& out;
+    size_t sectionLeft = 0;
+};
@@ -1,32 +1,64 @@
 #include "sections.h"
-#include <cstdint>    // for uint16_t, uint32_t, uint8_t
-#include <memory>     // for allocator_traits<>::value_type
-#include <stdexcept>  // for runtime_error
-#include <vector>     // for vector
-#include "utils.h"    // for dataToNumber
+#include <cstdint>        // for uint16_t, uint32_t, uint8_t
+#include <memory>         // for allocator_traits<>::value_type
+#include <stdexcept>      // for runtime_error
+#include <string_view>    // for string_view
+#include <unordered_set>  // for unordered_set
+#include <vector>         // for vector
+#include "cursor.h"       // for Cursor
 
-SectionHeader getSection(uint8_t*& data)
+void parseGlobalHeader(Cursor& data)
 {
+    const static uint32_t globalHeader1 = 0x0;
+    const static uint32_t globalHeader2 = 0x15ed1b1f;
+
+    data.require(8, "global header");
+    if (globalHeader1 != data.read<uint32_t>() || globalHeader2 != data.read<uint32_t>()) {
+        throw std::runtime_error("Couldn't parse global header. Is this a tox save?");
+    }
+}
+
+SectionHeader getSection(Cursor& data)
+{
+    data.require(8, "section header");
     SectionHeader header;
-    header.size = dataToNumber<uint32_t>(data);
+    header.size = data.read<uint32_t>();
     header.type = readSectionType(data);
 
     const static uint16_t sectionMagic = 0x01ce;
-    if (dataToNumber<uint16_t>(data) != sectionMagic) {
+    if (data.read<uint16_t>() != sectionMagic) {
         throw std::runtime_error("Couldn't parse section magic bytes.");
     }
-    header.data = data;
+    header.data = data.data();
 
     return header;
 }
 
-SectionType readSectionType(uint8_t*& data)
+SectionType readSectionType(Cursor& data)
 {
     // don't check if it's valid, since we still want to handle unknown sections
-    return static_cast<SectionType>(dataToNumber<uint16_t>(data));
+    return static_cast<SectionType>(data.read<uint16_t>());
 }
 
-std::string sectionToString(SectionType section)
+bool isKnownSection(SectionType type)
+{
+    switch (type) {
+    case SectionType::nospamkeys:
+    case SectionType::dht:
+    case SectionType::friends:
+    case SectionType::name:
+    case SectionType::statusmessage:
+    case SectionType::status:
+    case SectionType::tcpRelay:
+    case SectionType::pathNode:
+    case SectionType::conferences:
+    case SectionType::eof:
+        return true;
+    }
+    return false;
+}
+
+const char* sectionName(SectionType section)
 {
     switch(section) {
          case SectionType::nospamkeys:
@@ -53,7 +85,32 @@ std::string sectionToString(SectionType section)
     return "Unknown Section";
 }
 
-std::vector<SectionHeader> getAllSections(uint8_t* data)
+std::string sectionToString(SectionType section)
+{
+    return sectionName(section);
+}
+
+std::vector<bool> replacedSections(const std::vector<SectionType>& types)
+{
+    std::vector<bool> replaced(types.size());
+    std::unordered_set<std::string_view> later;
+    for (size_t i = types.size(); i-- > 0;) {
+        replaced[i] = !later.insert(sectionName(types[i])).second;
+    }
+    return replaced;
+}
+
+std::vector<bool> replacedSections(const std::vector<SectionHeader>& sections)
+{
+    std::vector<SectionType> types;
+    types.reserve(sections.size());
+    for (const auto& section : sections) {
+        types.push_back(section.type);
+    }
+    return replacedSections(types);
+}
+
+std::vector<SectionHeader> getAllSections(Cursor data)
 {
     std::vector<SectionHeader> sections;
 
@@ -62,7 +119,7 @@ std::vector<SectionHeader> getAllSections(uint8_t* data)
         if (section.type == SectionType::eof) {
             return sections;
         }
+        data.take(section.size, "section");
         sections.emplace_back(section);
-        data += sections.back().size;
     }
 }
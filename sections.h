@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <string>
 #include <vector>
+#include "cursor.h"
 
 enum class SectionType {
     nospamkeys = 1,
@@ -17,14 +18,27 @@ enum class SectionType {
     eof = 255,
 };
 
-SectionType readSectionType(uint8_t*& data);
+SectionType readSectionType(Cursor& data);
+// Whether type is one of the values above.
+bool isKnownSection(SectionType type);
 
 struct SectionHeader {
     uint32_t size;
-    uint8_t* data;
+    const uint8_t* data;
     SectionType type; // may hold unknown enum values
+
+    Cursor payload() const { return Cursor(data, size); }
 };
 
-SectionHeader getSection(uint8_t*& data);
+void parseGlobalHeader(Cursor& data);
+SectionHeader getSection(Cursor& data);
+// The section's name as a string literal, so it can be passed to Writer::key.
+const char* sectionName(SectionType section);
 std::string sectionToString(SectionType section);
-std::vector<SectionHeader> getAllSections(uint8_t* data);
+// For each of types, whether a later section has the same name. Output keyed by section name keeps only the last
+// of them, like QJsonObject::insert() did, so that a save with several unknown sections (or a repeated known one)
+// doesn't give a document with duplicate keys.
+std::vector<bool> replacedSections(const std::vector<SectionType>& types);
+std::vector<bool> replacedSections(const std::vector<SectionHeader>& sections);
+// Throws std::runtime_error if a section runs past the end of data or the EOF section is missing.
+std::vector<SectionHeader> getAllSections(Cursor data);
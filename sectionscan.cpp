@@ -0,0 +1,164 @@
+#include "sectionscan.h"
+#include "friendrecord.h"  // for FriendRecordLayout
+#include "utils.h"         // for loadNumber, Endianness
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>  // for __m256i, _mm256_*
+#include <emmintrin.h>  // for __m128i, _mm_*
+#define TOXSAVE_SCAN_X86 1
+#endif
+
+namespace {
+const uint8_t magicLow = 0xce;
+const uint8_t magicHigh = 0x01;
+// size and type come before the magic
+const size_t magicOffset = 6;
+const size_t headerSize = 8;
+
+// toxcore's TOX_MAX_NAME_LENGTH and TOX_MAX_STATUS_MESSAGE_LENGTH
+const size_t maxNameLength = 128;
+const size_t maxStatusMessageLength = 1007;
+
+// From begin on, for the tails of the SIMD loops.
+void scanScalar(const uint8_t* data, size_t begin, size_t size, std::vector<size_t>& offsets)
+{
+    for (size_t i = begin; i + 1 < size; ++i) {
+        if (data[i] == magicLow && data[i + 1] == magicHigh) {
+            offsets.push_back(i);
+        }
+    }
+}
+
+#ifdef TOXSAVE_SCAN_X86
+__attribute__((target("sse2")))
+void findSectionMagicSse2(const uint8_t* data, size_t size, std::vector<size_t>& offsets)
+{
+    const __m128i low = _mm_set1_epi8(static_cast<char>(magicLow));
+    const __m128i high = _mm_set1_epi8(magicHigh);
+    size_t i = 0;
+    // the second load is one byte further on
+    for (; i + 17 <= size; i += 16) {
+        const __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        const __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 1));
+        auto hits = static_cast<unsigned>(
+            _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, low), _mm_cmpeq_epi8(second, high))));
+        while (hits) {
+            offsets.push_back(i + __builtin_ctz(hits));
+            hits &= hits - 1;
+        }
+    }
+    scanScalar(data, i, size, offsets);
+}
+
+__attribute__((target("avx2")))
+void findSectionMagicAvx2(const uint8_t* data, size_t size, std::vector<size_t>& offsets)
+{
+    const __m256i low = _mm256_set1_epi8(static_cast<char>(magicLow));
+    const __m256i high = _mm256_set1_epi8(magicHigh);
+    size_t i = 0;
+    for (; i + 33 <= size; i += 32) {
+        const __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        const __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 1));
+        auto hits = static_cast<uint32_t>(
+            _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, low), _mm256_cmpeq_epi8(second, high))));
+        while (hits) {
+            offsets.push_back(i + __builtin_ctz(hits));
+            hits &= hits - 1;
+        }
+    }
+    scanScalar(data, i, size, offsets);
+}
+#endif
+
+MagicFinder pickMagicFinder()
+{
+    if (auto avx2 = magicFinderAvx2()) {
+        return avx2;
+    }
+    if (auto sse2 = magicFinderSse2()) {
+        return sse2;
+    }
+    return findSectionMagicScalar;
+}
+
+bool isPlausible(SectionType type, size_t size)
+{
+    switch (type) {
+    case SectionType::nospamkeys:
+        return size == 4 + 32 + 32;
+    case SectionType::dht:
+        // state cookie and the nodes inner section header
+        return size >= 12;
+    case SectionType::friends:
+        return size % FriendRecordLayout::size == 0;
+    case SectionType::name:
+        return size <= maxNameLength;
+    case SectionType::statusmessage:
+        return size <= maxStatusMessageLength;
+    case SectionType::status:
+        return size == 1;
+    case SectionType::tcpRelay:
+    case SectionType::pathNode:
+    case SectionType::conferences:
+        return true;
+    case SectionType::eof:
+        return size == 0;
+    }
+    return false;
+}
+}
+
+void findSectionMagicScalar(const uint8_t* data, size_t size, std::vector<size_t>& offsets)
+{
+    scanScalar(data, 0, size, offsets);
+}
+
+MagicFinder magicFinderSse2()
+{
+#ifdef TOXSAVE_SCAN_X86
+    // part of the x86-64 baseline, but not of 32 bit x86
+    if (__builtin_cpu_supports("sse2")) {
+        return findSectionMagicSse2;
+    }
+#endif
+    return nullptr;
+}
+
+MagicFinder magicFinderAvx2()
+{
+#ifdef TOXSAVE_SCAN_X86
+    if (__builtin_cpu_supports("avx2")) {
+        return findSectionMagicAvx2;
+    }
+#endif
+    return nullptr;
+}
+
+void findSectionMagic(const uint8_t* data, size_t size, std::vector<size_t>& offsets)
+{
+    static const MagicFinder bestMagicFinder = pickMagicFinder();
+    bestMagicFinder(data, size, offsets);
+}
+
+std::vector<SectionHeader> findSectionHeaders(const uint8_t* data, size_t size)
+{
+    std::vector<size_t> magics;
+    findSectionMagic(data, size, magics);
+
+    std::vector<SectionHeader> headers;
+    for (const size_t magic : magics) {
+        if (magic < magicOffset) {
+            continue;
+        }
+        const uint8_t* const header = data + magic - magicOffset;
+        SectionHeader section;
+        section.size = loadNumber<Endianness::little, uint32_t>(header);
+        section.type = static_cast<SectionType>(loadNumber<Endianness::little, uint16_t>(header + 4));
+        section.data = header + headerSize;
+        const size_t left = size - (magic - magicOffset) - headerSize;
+        if (section.size <= left && isPlausible(section.type, section.size)) {
+            headers.push_back(section);
+        }
+    }
+    return headers;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>     // for size_t
+#include <cstdint>     // for uint8_t
+#include <vector>      // for vector
+#include "sections.h"  // for SectionHeader
+
+// Searching a damaged save for sections without following the chain of section sizes, which a single broken header
+// ends. Every section header ends in the 0x01ce magic, so the bytes are scanned for it and each hit is checked as a
+// possible header.
+
+// Appends the offset of every 0x01ce magic (the bytes CE 01) in data to offsets. Picks the widest of AVX2, SSE2 and a
+// scalar loop that the CPU supports, once at startup.
+void findSectionMagic(const uint8_t* data, size_t size, std::vector<size_t>& offsets);
+
+// Every header in data whose type is known and whose size is plausible for it (e.g. 68 bytes of nospam and keys, a
+// multiple of the friend record size) and fits in data, ordered by offset. Only the header is checked, the payload
+// may still fail to decode.
+std::vector<SectionHeader> findSectionHeaders(const uint8_t* data, size_t size);
+
+// The individual implementations, exposed for the benchmark. The SIMD ones are null when not compiled in or not
+// supported by the CPU.
+using MagicFinder = void (*)(const uint8_t* data, size_t size, std::vector<size_t>& offsets);
+void findSectionMagicScalar(const uint8_t* data, size_t size, std::vector<size_t>& offsets);
+MagicFinder magicFinderSse2();
+MagicFinder magicFinderAvx2();
@@ -0,0 +1,343 @@
+#include "selection.h"
+#include <string.h>   // for strcmp
+#include <span>       // for span
+#include <stdexcept>  // for invalid_argument
+#include <utility>    // for move
+
+namespace {
+std::string trim(const std::string& text)
+{
+    const size_t first = text.find_first_not_of(' ');
+    if (first == std::string::npos) {
+        return {};
+    }
+    return text.substr(first, text.find_last_not_of(' ') + 1 - first);
+}
+
+// The shape of the decoded document, for rejecting paths that can never select anything: the members of an object, or
+// the shape of an array's elements. Keys as the decoders write them; tests/selectionkeys.cpp checks that --select accepts
+// every path they write.
+struct Shape;
+struct ShapeMember {
+    const char* name;
+    const Shape* shape;
+};
+struct Shape {
+    std::span<const ShapeMember> members;
+    const Shape* element = nullptr;
+};
+
+constexpr Shape scalar{};
+
+constexpr ShapeMember nospamKeysMembers[] = {
+    {"Nospam", &scalar}, {"Long term public key", &scalar}, {"Long term secret key", &scalar}};
+constexpr Shape nospamKeys{nospamKeysMembers};
+
+constexpr ShapeMember nodeMembers[] = {{"Transport Protocol", &scalar}, {"Address Family", &scalar},
+                                       {"IP address", &scalar},         {"Port Number", &scalar},
+                                       {"Public Key", &scalar}};
+constexpr Shape node{nodeMembers};
+constexpr Shape nodes{{}, &node};
+
+constexpr ShapeMember friendMembers[] = {{"Status", &scalar},
+                                         {"Long term public key", &scalar},
+                                         {"Size of the friend request message", &scalar},
+                                         {"Friend request message as a byte string", &scalar},
+                                         {"Size of the name", &scalar},
+                                         {"Name as a byte string", &scalar},
+                                         {"Size of the status message", &scalar},
+                                         {"Status message as a byte string", &scalar},
+                                         {"User status", &scalar},
+                                         {"Nospam (only used for sending a friend request)", &scalar},
+                                         {"Last seen time", &scalar}};
+constexpr Shape friendRecord{friendMembers};
+constexpr Shape friends{{}, &friendRecord};
+
+constexpr ShapeMember peerMembers[] = {{"Long term public key", &scalar}, {"DHT public key", &scalar},
+                                       {"Peer number", &scalar},          {"Last active timestamp", &scalar},
+                                       {"Name length", &scalar},          {"Name", &scalar}};
+constexpr Shape peer{peerMembers};
+constexpr Shape peers{{}, &peer};
+
+constexpr ShapeMember conferenceMembers[] = {{"Groupchat type", &scalar},  {"Groupchat id", &scalar},
+                                             {"Message number", &scalar},  {"Lossy message number", &scalar},
+                                             {"Peer number", &scalar},     {"Number of peers", &scalar},
+                                             {"Title length", &scalar},    {"Title", &scalar},
+                                             {"List of peers", &peers}};
+constexpr Shape conference{conferenceMembers};
+constexpr Shape conferences{{}, &conference};
+
+// every name sectionName() returns for a section in the output
+constexpr ShapeMember sectionMembers[] = {{"Nospam and Keys", &nospamKeys}, {"DHT Nodes", &nodes},
+                                          {"Friends", &friends},            {"Name", &scalar},
+                                          {"Status Message", &scalar},      {"Status", &scalar},
+                                          {"Tcp Relays", &nodes},           {"Path Nodes", &nodes},
+                                          {"Conferences", &conferences},    {"Unknown Section", &scalar}};
+constexpr Shape document{sectionMembers};
+
+const Shape* memberShape(const Shape& shape, const std::string& name)
+{
+    for (const auto& member : shape.members) {
+        if (name == member.name) {
+            return member.shape;
+        }
+    }
+    return nullptr;
+}
+
+Selection::Node* memberNode(Selection::Node& node, const std::string& name)
+{
+    for (auto& member : node.members) {
+        if (member.name == name) {
+            return member.node.get();
+        }
+    }
+    node.members.push_back({name, std::make_unique<Selection::Node>()});
+    return node.members.back().node.get();
+}
+
+Selection::Node* elementNode(Selection::Node& node)
+{
+    if (!node.elementNode) {
+        node.elementNode = std::make_unique<Selection::Node>();
+    }
+    return node.elementNode.get();
+}
+
+void addPath(Selection::Node& root, const std::string& path)
+{
+    if (path.empty()) {
+        throw std::invalid_argument("Empty selection path");
+    }
+
+    Selection::Node* node = &root;
+    const Shape* shape = &document;
+    std::string parent;
+    size_t begin = 0;
+    while (begin <= path.size()) {
+        size_t end = path.find('.', begin);
+        if (end == std::string::npos) {
+            end = path.size();
+        }
+        const std::string segment = path.substr(begin, end - begin);
+        const size_t bracket = segment.find('[');
+        const std::string name = segment.substr(0, bracket);
+        if (name.empty()) {
+            throw std::invalid_argument("Invalid selection path " + path + ": empty member name");
+        }
+        if (shape->element) {
+            throw std::invalid_argument("Invalid selection path " + path + ": " + parent + " is an array, use "
+                                        + parent + "[]");
+        }
+        shape = memberShape(*shape, name);
+        if (!shape) {
+            throw std::invalid_argument("Invalid selection path " + path + ": "
+                                        + (node == &root ? "unknown section " : "unknown field ") + name);
+        }
+        node = memberNode(*node, name);
+        for (size_t i = bracket; i != std::string::npos && i < segment.size(); i += 2) {
+            if (segment.compare(i, 2, "[]") != 0) {
+                throw std::invalid_argument("Invalid selection path " + path + ": expected [] after " + name);
+            }
+            if (!shape->element) {
+                throw std::invalid_argument("Invalid selection path " + path + ": "
+                                            + (i == bracket ? name + " isn't an array"
+                                                            : "the elements of " + name + " aren't arrays"));
+            }
+            shape = shape->element;
+            node = elementNode(*node);
+        }
+        parent = name;
+        begin = end + 1;
+    }
+
+    // anything selected below it before is now part of it
+    node->all = true;
+    node->members.clear();
+    node->elementNode.reset();
+}
+}
+
+const Selection::Node* Selection::Node::member(const char* name) const
+{
+    if (all) {
+        return this;
+    }
+    for (const auto& member : members) {
+        if (strcmp(member.name.c_str(), name) == 0) {
+            return member.node.get();
+        }
+    }
+    return nullptr;
+}
+
+Selection::Selection(const std::vector<std::string>& paths)
+{
+    for (const auto& path : paths) {
+        add(path);
+    }
+}
+
+void Selection::add(const std::string& paths)
+{
+    size_t begin = 0;
+    while (begin <= paths.size()) {
+        size_t end = paths.find(',', begin);
+        if (end == std::string::npos) {
+            end = paths.size();
+        }
+        addPath(rootNode, trim(paths.substr(begin, end - begin)));
+        begin = end + 1;
+    }
+}
+
+SelectionWriter::SelectionWriter(Writer& out, const Selection::Node& node, const char* key)
+    : out(out)
+    , rootNode(&node)
+    , pendingKey(key)
+{
+}
+
+SelectionWriter::SelectionWriter(std::unique_ptr<Writer> fork, const Selection::Node& node)
+    : ownWriter(std::move(fork))
+    , out(*ownWriter)
+    , rootNode(nullptr)
+    , pendingKey(nullptr)
+    , open{{&node, false}}
+    , done(true)
+{
+}
+
+const Selection::Node* SelectionWriter::next(bool scalar)
+{
+    const char* key = pendingKey;
+    pendingKey = nullptr;
+
+    const Selection::Node* node = nullptr;
+    if (open.empty()) {
+        node = done ? nullptr : rootNode;
+        done = true;
+    } else if (open.back().object) {
+        node = key ? open.back().node->member(key) : nullptr;
+    } else {
+        node = open.back().node->elements();
+    }
+
+    if (!node || (scalar && !node->all)) {
+        return nullptr;
+    }
+    if (key) {
+        out.key(key);
+    }
+    return node;
+}
+
+void SelectionWriter::begin(bool object)
+{
+    if (skipped > 0) {
+        ++skipped;
+        return;
+    }
+    const Selection::Node* node = next(false);
+    if (!node) {
+        skipped = 1;
+        return;
+    }
+    open.push_back({node, object});
+    if (object) {
+        out.beginObject();
+    } else {
+        out.beginArray();
+    }
+}
+
+void SelectionWriter::end(bool object)
+{
+    if (skipped > 0) {
+        --skipped;
+        return;
+    }
+    open.pop_back();
+    if (object) {
+        out.endObject();
+    } else {
+        out.endArray();
+    }
+}
+
+void SelectionWriter::beginObject()
+{
+    begin(true);
+}
+
+void SelectionWriter::endObject()
+{
+    end(true);
+}
+
+void SelectionWriter::beginArray()
+{
+    begin(false);
+}
+
+void SelectionWriter::endArray()
+{
+    end(false);
+}
+
+void SelectionWriter::key(const char* name)
+{
+    if (skipped == 0) {
+        pendingKey = name;
+    }
+}
+
+void SelectionWriter::string(const char* data, size_t length)
+{
+    if (skipped == 0 && next(true)) {
+        out.string(data, length);
+    }
+}
+
+void SelectionWriter::number(int64_t value)
+{
+    if (skipped == 0 && next(true)) {
+        out.number(value);
+    }
+}
+
+void SelectionWriter::hex(const uint8_t* data, size_t length)
+{
+    if (skipped == 0 && next(true)) {
+        out.hex(data, length);
+    }
+}
+
+void SelectionWriter::timestamp(uint64_t secondsSinceEpoch)
+{
+    if (skipped == 0 && next(true)) {
+        out.timestamp(secondsSinceEpoch);
+    }
+}
+
+std::unique_ptr<Writer> SelectionWriter::fork(size_t nested) const
+{
+    if (skipped > 0 || open.empty() || open.back().object) {
+        return nullptr;
+    }
+    const Selection::Node& array = *open.back().node;
+    // the fork doesn't see the containers opened between this array and the one it's spliced into
+    if (nested > 0 && !(array.elements() && array.elements()->all)) {
+        return nullptr;
+    }
+    auto fork = out.fork(nested);
+    if (!fork) {
+        return nullptr;
+    }
+    return std::unique_ptr<Writer>(new SelectionWriter(std::move(fork), array));
+}
+
+void SelectionWriter::splice(Writer& fork)
+{
+    out.splice(*static_cast<SelectionWriter&>(fork).ownWriter);
+}
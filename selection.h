@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>  // for size_t
+#include <cstdint>  // for int64_t, uint8_t, uint64_t
+#include <memory>   // for unique_ptr
+#include <string>   // for string
+#include <vector>   // for vector
+#include "writer.h"  // for Writer
+
+// The fields picked by --select paths, as a tree. A path is a '.' separated list of member names, starting with a
+// section name, where a name followed by "[]" steps into every element of that array, e.g.
+// "Friends[].Long term public key" or "Nospam and Keys.Nospam". Several paths can be given, separated by ','.
+class Selection {
+public:
+    struct Node {
+        struct Member {
+            std::string name;
+            std::unique_ptr<Node> node;
+        };
+
+        // the node for the value of member name, or nullptr if it isn't selected
+        const Node* member(const char* name) const;
+        // the node for the elements of this array, or nullptr if they aren't selected
+        const Node* elements() const { return all ? this : elementNode.get(); }
+
+        bool all = false; // everything below is selected
+        std::vector<Member> members;
+        std::unique_ptr<Node> elementNode;
+    };
+
+    Selection() = default;
+    // Throws std::invalid_argument for a malformed path, or one naming a section or field the output doesn't have.
+    explicit Selection(const std::vector<std::string>& paths);
+
+    void add(const std::string& paths);
+    const Node& root() const { return rootNode; }
+
+private:
+    Node rootNode;
+};
+
+// Passes on to out only the parts of a value that are selected by node, dropping the rest before it's encoded: an
+// unselected key or secret key is never hex encoded, a timestamp never formatted, and a string never escaped or
+// copied. With key set, the value is written as that member of the object open in out, provided any of it is selected.
+class SelectionWriter : public Writer {
+public:
+    SelectionWriter(Writer& out, const Selection::Node& node, const char* key = nullptr);
+
+    void beginObject() override;
+    void endObject() override;
+    void beginArray() override;
+    void endArray() override;
+    void key(const char* name) override;
+    void string(const char* data, size_t length) override;
+    void number(int64_t value) override;
+    void hex(const uint8_t* data, size_t length) override;
+    void timestamp(uint64_t secondsSinceEpoch) override;
+    using Writer::string;
+
+    // Forks out; with nested > 0 only if the elements of the open array are selected as a whole.
+    std::unique_ptr<Writer> fork(size_t nested = 0) const override;
+    void splice(Writer& fork) override;
+
+private:
+    SelectionWriter(std::unique_ptr<Writer> fork, const Selection::Node& node);
+
+    struct Container {
+        const Selection::Node* node;
+        bool object;
+    };
+
+    // The node of the value about to be written, nullptr if it's dropped. Only a value selected as a whole can be
+    // a scalar. Writes the pending key if the value is kept.
+    const Selection::Node* next(bool scalar);
+    void begin(bool object);
+    void end(bool object);
+
+    std::unique_ptr<Writer> ownWriter;
+    Writer& out;
+    const Selection::Node* rootNode;
+    const char* pendingKey;
+    std::vector<Container> open; // every open container that is passed on
+    size_t skipped = 0; // depth of open containers below a dropped one
+    bool done = false;  // the root value has been written (or dropped)
+};
@@ -0,0 +1,376 @@
+#include "serve.h"
+#include <errno.h>             // for errno, EINTR
+#include <signal.h>            // for signal, SIGPIPE, SIG_IGN
+#include <stdio.h>             // for snprintf
+#include <stdlib.h>            // for EXIT_FAILURE
+#include <string.h>            // for strerror, memcpy
+#include <sys/socket.h>        // for socket, bind, listen, accept4, AF_UNIX, SOCK_STREAM, SOCK_CLOEXEC
+#include <sys/stat.h>          // for stat, lstat, umask, S_ISSOCK
+#include <sys/un.h>            // for sockaddr_un
+#include <unistd.h>            // for read, close, unlink
+#include <chrono>              // for milliseconds
+#include <condition_variable>  // for condition_variable
+#include <cstdint>             // for uint8_t, uint64_t
+#include <exception>           // for exception
+#include <functional>          // for ref
+#include <iostream>            // for cerr, endl
+#include <list>                // for list
+#include <memory>              // for shared_ptr, unique_ptr, make_shared
+#include <mutex>               // for mutex, lock_guard
+#include <stdexcept>           // for runtime_error
+#include <thread>              // for thread, sleep_for
+#include <unordered_map>       // for unordered_map
+#include <utility>             // for move
+#include <vector>              // for vector
+#include "encryptedsave.h"     // for DecryptedSave, KeyCache, openSave
+#include "mappedfile.h"        // for MappedFile
+#include "outputbuffer.h"      // for OutputBuffer
+#include "selection.h"         // for Selection
+#include "threadpool.h"        // for blockingMap
+
+namespace {
+// a connection sending a longer line than this isn't speaking the protocol
+constexpr size_t maxRequestLength = 64 * 1024;
+
+// Answers by profile identity and request options, least recently used first out.
+class AnswerCache {
+public:
+    explicit AnswerCache(size_t capacity)
+        : capacity(capacity)
+    {
+    }
+
+    std::shared_ptr<const std::string> find(const std::string& key)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const auto found = index.find(key);
+        if (found == index.end()) {
+            return nullptr;
+        }
+        entries.splice(entries.begin(), entries, found->second);
+        return found->second->answer;
+    }
+
+    void insert(const std::string& key, std::shared_ptr<const std::string> answer)
+    {
+        const size_t cost = key.size() + answer->size();
+        if (cost > capacity) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        const auto found = index.find(key);
+        if (found != index.end()) {
+            // another connection decoded the same profile at the same time
+            entries.splice(entries.begin(), entries, found->second);
+            return;
+        }
+        while (used + cost > capacity) {
+            const auto& oldest = entries.back();
+            used -= oldest.key.size() + oldest.answer->size();
+            index.erase(oldest.key);
+            entries.pop_back();
+        }
+        entries.push_front({key, std::move(answer)});
+        index.emplace(key, entries.begin());
+        used += cost;
+    }
+
+private:
+    struct Entry {
+        std::string key;
+        std::shared_ptr<const std::string> answer;
+    };
+
+    std::mutex mutex;
+    // most recently used first
+    std::list<Entry> entries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    size_t capacity;
+    size_t used = 0;
+};
+
+struct Request {
+    std::string path;
+    std::string format;
+    std::string select;
+
+    OutputOptions options;
+    std::unique_ptr<Selection> selection;
+    std::shared_ptr<const std::string> answer;
+    std::string error;
+    // set by the dispatcher once a cache miss has been decoded
+    bool decoded = false;
+};
+
+struct Server;
+
+// Decodes the cache misses of every connection on the global pool. A connection thread only does I/O and cache
+// lookups and hands its misses to one dispatcher thread, which takes everything queued at once into a blockingMap(),
+// so decoding runs on --threads threads however many clients are connected.
+class DecodeQueue {
+public:
+    // Queues requests and returns once every one of them has been decoded.
+    void decode(const std::vector<Request*>& requests);
+    // The dispatcher, never returns.
+    void run(Server& server);
+
+private:
+    std::mutex mutex;
+    std::condition_variable queuedChanged;
+    std::condition_variable decodedChanged;
+    std::vector<Request*> queued;
+};
+
+struct Server {
+    OutputOptions options;
+    std::optional<std::string> passphrase;
+    KeyCache keys;
+    AnswerCache cache;
+    DecodeQueue decoder;
+};
+
+template<typename T>
+void appendValue(std::string& key, T value)
+{
+    key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// A changed profile has a new mtime or size, and one replaced with rename(2) a new inode, so any of them going stale
+// misses the cache.
+std::string cacheKey(const struct stat& info, const OutputOptions& options, const std::string& select)
+{
+    std::string key;
+    appendValue(key, static_cast<uint64_t>(info.st_dev));
+    appendValue(key, static_cast<uint64_t>(info.st_ino));
+    appendValue(key, static_cast<int64_t>(info.st_mtim.tv_sec));
+    appendValue(key, static_cast<int64_t>(info.st_mtim.tv_nsec));
+    appendValue(key, static_cast<int64_t>(info.st_size));
+    appendValue(key, static_cast<uint8_t>(options.format));
+    appendValue(key, static_cast<uint8_t>(options.indented));
+    key += select;
+    return key;
+}
+
+// Fills in request.answer from the cache, or request.error for a bad request; returns false if the profile has to be
+// decoded.
+bool lookUp(Request& request, Server& server)
+{
+    try {
+        request.options = server.options;
+        if (!request.format.empty()) {
+            request.options.format = outputFormatFromString(request.format);
+        }
+        if (!request.select.empty()) {
+            request.selection.reset(new Selection);
+            request.selection->add(request.select);
+            request.options.selection = request.selection.get();
+        }
+
+        struct stat info;
+        if (stat(request.path.c_str(), &info) == -1) {
+            throw std::runtime_error("Error opening " + request.path + ": " + strerror(errno));
+        }
+        request.answer = server.cache.find(cacheKey(info, request.options, request.select));
+        return request.answer != nullptr;
+    }
+    catch (const std::exception& e) {
+        request.error = e.what();
+        return true;
+    }
+}
+
+// Decodes a cache miss into request.answer or request.error; never throws, it runs on the pool.
+void answer(Request& request, Server& server)
+{
+    try {
+        MappedFile file(request.path);
+        std::unique_ptr<DecryptedSave> decrypted;
+        thread_local OutputBuffer document;
+        document.clear();
+        writeProfileOutput(openSave(file.data(), file.size(), server.passphrase, server.keys, decrypted),
+                           request.options, document);
+        auto decoded = std::make_shared<const std::string>(document.data(), document.size());
+        // keyed by what was actually mapped, in case the profile was replaced after the stat()
+        server.cache.insert(cacheKey(file.info(), request.options, request.select), decoded);
+        request.answer = std::move(decoded);
+    }
+    catch (const std::exception& e) {
+        request.error = e.what();
+    }
+}
+
+void DecodeQueue::decode(const std::vector<Request*>& requests)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    queued.insert(queued.end(), requests.begin(), requests.end());
+    queuedChanged.notify_one();
+    decodedChanged.wait(lock, [&requests] {
+        for (const auto* request : requests) {
+            if (!request->decoded) {
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+void DecodeQueue::run(Server& server)
+{
+    std::vector<Request*> batch;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            queuedChanged.wait(lock, [this] { return !queued.empty(); });
+            batch.swap(queued);
+        }
+        blockingMap(batch, [&server](Request* request) { answer(*request, server); });
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto* request : batch) {
+                request->decoded = true;
+            }
+        }
+        decodedChanged.notify_all();
+        batch.clear();
+    }
+}
+
+Request parseRequest(const char* line, size_t length)
+{
+    if (length > 0 && line[length - 1] == '\r') {
+        --length;
+    }
+    Request request;
+    std::string* fields[] = {&request.path, &request.format, &request.select};
+    size_t field = 0;
+    for (size_t i = 0; i < length; ++i) {
+        if (line[i] == '\t' && field < 2) {
+            ++field;
+        } else {
+            fields[field]->push_back(line[i]);
+        }
+    }
+    return request;
+}
+
+void writeAnswer(const Request& request, OutputBuffer& out)
+{
+    const std::string& body = request.answer ? *request.answer : request.error;
+    char header[32];
+    const int length = snprintf(header, sizeof(header), "%s %zu\n", request.answer ? "OK" : "ERROR", body.size());
+    out.append(header, length);
+    out.append(body.data(), body.size());
+}
+
+void serveConnection(int fd, Server& server)
+{
+    try {
+        OutputBuffer out(fd);
+        std::string pending;
+        std::vector<Request> requests;
+        std::vector<Request*> misses;
+        char input[64 * 1024];
+        while (true) {
+            const ssize_t length = read(fd, input, sizeof(input));
+            if (length < 0 && errno == EINTR) {
+                continue;
+            }
+            if (length <= 0) {
+                break;
+            }
+            pending.append(input, length);
+
+            // everything the client has pipelined so far is decoded together
+            requests.clear();
+            size_t begin = 0;
+            for (size_t end = pending.find('\n'); end != std::string::npos; end = pending.find('\n', begin)) {
+                if (end > begin) {
+                    requests.push_back(parseRequest(pending.data() + begin, end - begin));
+                }
+                begin = end + 1;
+            }
+            pending.erase(0, begin);
+
+            misses.clear();
+            for (auto& request : requests) {
+                if (!lookUp(request, server)) {
+                    misses.push_back(&request);
+                }
+            }
+            if (!misses.empty()) {
+                server.decoder.decode(misses);
+            }
+            for (const auto& request : requests) {
+                writeAnswer(request, out);
+            }
+            out.flush();
+
+            // the requests that were complete are answered, but a line this long isn't speaking the protocol
+            if (pending.size() > maxRequestLength) {
+                break;
+            }
+        }
+    }
+    catch (const std::exception&) {
+        // the client went away while its answers were written
+    }
+    close(fd);
+}
+}
+
+int runServe(const std::string& socketPath, const OutputOptions& options, size_t cacheBytes,
+             const std::optional<std::string>& passphrase)
+{
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path " << socketPath << " is empty or too long." << std::endl;
+        return EXIT_FAILURE;
+    }
+    memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    // a client closing its end early shouldn't take down the daemon, writing to it fails with EPIPE instead
+    signal(SIGPIPE, SIG_IGN);
+
+    const int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener == -1) {
+        std::cerr << "Couldn't create a socket: " << strerror(errno) << std::endl;
+        return EXIT_FAILURE;
+    }
+    // a socket left over from an earlier run, but never anything else at that path
+    struct stat existing;
+    if (lstat(socketPath.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode)) {
+        unlink(socketPath.c_str());
+    }
+    // the answers hold secret keys, only the user may connect
+    const mode_t mask = umask(077);
+    const int bound = bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+    umask(mask);
+    if (bound == -1 || listen(listener, SOMAXCONN) == -1) {
+        std::cerr << "Couldn't listen on " << socketPath << ": " << strerror(errno) << std::endl;
+        close(listener);
+        return EXIT_FAILURE;
+    }
+
+    // never freed, the detached connection threads use it until the process exits
+    auto* server = new Server{options, passphrase, {}, AnswerCache(cacheBytes), {}};
+    std::thread([server] { server->decoder.run(*server); }).detach();
+    std::cerr << "Serving on " << socketPath << std::endl;
+    while (true) {
+        const int fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            std::cerr << "Accepting a connection failed: " << strerror(errno) << std::endl;
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                // out of descriptors or memory for now, the open connections will give some back
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                continue;
+            }
+            close(listener);
+            return EXIT_FAILURE;
+        }
+        std::thread(serveConnection, fd, std::ref(*server)).detach();
+    }
+}
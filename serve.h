@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>   // for size_t
+#include <optional>  // for optional
+#include <string>    // for string
+#include "output.h"  // for OutputOptions
+
+// Serves parse requests on a Unix domain socket until killed. A request is one line, "path", optionally followed by a
+// tab and an output format and another tab and --select paths ("profile.tox\tcbor\tFriends[].Name"); an empty or
+// missing field uses options. Each request is answered with "OK <length>\n" and the document as writeProfileOutput()
+// writes it, or "ERROR <length>\n" and the message. Requests may be pipelined, and are answered in request order. The
+// profiles that miss the cache are decoded on the global thread pool, together with those of the other connections,
+// so the threads decoding are bounded by its size however many clients are connected. A connection sending a line
+// longer than 64 KiB is closed, after the requests before it have been answered.
+//
+// Answers are kept in memory in an LRU cache of at most cacheBytes, keyed by the profile's device, inode, mtime and
+// size (from the descriptor that was mapped) and the format and selection, so a repeated request for an unchanged
+// profile costs a stat(). The socket is created private to the user. Returns EXIT_FAILURE if it can't be set up.
+int runServe(const std::string& socketPath, const OutputOptions& options, size_t cacheBytes,
+             const std::optional<std::string>& passphrase);
@@ -0,0 +1,328 @@
+#include "shrink.h"
+#include <fcntl.h>          // for open, O_RDONLY, O_DIRECTORY, O_CLOEXEC
+#include <stdio.h>          // for rename
+#include <stdlib.h>         // for mkstemp
+#include <string.h>         // for memcmp, strerror
+#include <sys/stat.h>       // for stat, fchmod
+#include <unistd.h>         // for close, fsync, unlink
+#include <algorithm>        // for find
+#include <cerrno>           // for errno
+#include <cstdint>          // for uint8_t, uint16_t, uint32_t, uint64_t
+#include <filesystem>       // for path
+#include <iostream>         // for cerr, ostream, endl
+#include <span>             // for span
+#include <stdexcept>        // for runtime_error, invalid_argument
+#include <string_view>      // for string_view
+#include <unordered_set>    // for unordered_set
+#include "cursor.h"         // for Cursor
+#include "decoders.h"       // for getDhtNodes, writeSection
+#include "document.h"       // for Arena, DocumentWriter
+#include "encryptedsave.h"  // for isEncryptedSave
+#include "mappedfile.h"     // for MappedFile
+#include "nodeinfo.h"       // for nodeInfoSize
+#include "outputbuffer.h"   // for OutputBuffer
+#include "profile.h"        // for NodeView
+#include "saveencoder.h"    // for SaveEncoder
+#include "sections.h"       // for SectionHeader, SectionType, getAllSections, parseGlobalHeader, sectionName
+
+namespace {
+const SectionType knownSections[] = {SectionType::nospamkeys, SectionType::dht,      SectionType::friends,
+                                     SectionType::name,       SectionType::statusmessage, SectionType::status,
+                                     SectionType::tcpRelay,   SectionType::pathNode, SectionType::conferences};
+
+bool isNodeSection(SectionType type)
+{
+    return type == SectionType::dht || type == SectionType::tcpRelay || type == SectionType::pathNode;
+}
+
+// A section as it is (to be) written: the payload copied as is, or for node sections the nodes listed.
+struct PlannedSection {
+    SectionHeader header;
+    std::vector<NodeView> nodes;
+};
+
+struct Plan {
+    std::vector<PlannedSection> sections;
+    uint64_t nodesBefore = 0;
+    uint64_t nodesAfter = 0;
+    size_t sectionsDropped = 0;
+
+    bool changesAnything() const { return sectionsDropped > 0 || nodesAfter < nodesBefore; }
+};
+
+// The checked node records of a node section, for DHT ones inside the state cookie and nodes inner section.
+std::vector<NodeView> readNodes(const SectionHeader& section)
+{
+    Cursor data = section.payload();
+    if (section.type == SectionType::dht) {
+        Cursor records = getDhtNodes(data);
+        if (!data.atEnd()) {
+            throw std::runtime_error("Section contents didn't match section size.");
+        }
+        data = records;
+    }
+
+    std::vector<NodeView> nodes;
+    while (!data.atEnd()) {
+        const size_t size = nodeInfoSize(data.peek());
+        data.require(size, "node info");
+        nodes.emplace_back(data.advance(size));
+    }
+    return nodes;
+}
+
+bool isDropped(const SectionHeader& section, const ShrinkOptions& options)
+{
+    const auto& drop = options.dropSections;
+    return (options.dropEmpty && section.size == 0)
+        || std::find(drop.begin(), drop.end(), sectionName(section.type)) != drop.end();
+}
+
+Plan planShrink(const std::vector<SectionHeader>& sections, const ShrinkOptions& options)
+{
+    Plan plan;
+    for (const auto& section : sections) {
+        if (isDropped(section, options)) {
+            ++plan.sectionsDropped;
+            continue;
+        }
+        PlannedSection planned{section, {}};
+        if (isNodeSection(section.type)) {
+            const auto nodes = readNodes(section);
+            // records are compared whole (family, address, port and key), they point into the mapped save
+            std::unordered_set<std::string_view> seen;
+            for (const auto& node : nodes) {
+                if (options.maxNodes != 0 && planned.nodes.size() == options.maxNodes) {
+                    break;
+                }
+                if (seen.emplace(reinterpret_cast<const char*>(node.data()), node.size()).second) {
+                    planned.nodes.push_back(node);
+                }
+            }
+            plan.nodesBefore += nodes.size();
+            plan.nodesAfter += planned.nodes.size();
+        }
+        plan.sections.push_back(std::move(planned));
+    }
+    return plan;
+}
+
+void encodePlan(const Plan& plan, OutputBuffer& out)
+{
+    SaveEncoder encoder(out);
+    for (const auto& section : plan.sections) {
+        if (isNodeSection(section.header.type)) {
+            encoder.nodeSection(section.header.type, section.nodes);
+        } else {
+            encoder.section(section.header.type, std::span<const uint8_t>(section.header.data, section.header.size));
+        }
+    }
+    encoder.finish();
+}
+
+bool sameBytes(const uint8_t* a, size_t aSize, const uint8_t* b, size_t bSize)
+{
+    return aSize == bSize && memcmp(a, b, aSize) == 0;
+}
+
+// Whether a save read back parses into what was meant to be written.
+bool samePlan(const Plan& written, const Plan& readBack)
+{
+    if (written.sections.size() != readBack.sections.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < written.sections.size(); ++i) {
+        const auto& expected = written.sections[i];
+        const auto& actual = readBack.sections[i];
+        if (expected.header.type != actual.header.type) {
+            return false;
+        }
+        if (!isNodeSection(expected.header.type)) {
+            if (!sameBytes(expected.header.data, expected.header.size, actual.header.data, actual.header.size)) {
+                return false;
+            }
+            continue;
+        }
+        if (expected.nodes.size() != actual.nodes.size()) {
+            return false;
+        }
+        for (size_t node = 0; node < expected.nodes.size(); ++node) {
+            const auto& a = expected.nodes[node];
+            const auto& b = actual.nodes[node];
+            if (!sameBytes(a.data(), a.size(), b.data(), b.size())) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// The replacement for a profile, written next to it so rename(2) can swap it in. Removed again unless committed.
+class ReplacementFile {
+public:
+    explicit ReplacementFile(const std::string& target)
+        : target(target)
+        , path(target + ".shrink-XXXXXX")
+        , fd(mkstemp(path.data()))
+    {
+        if (fd < 0) {
+            throw std::runtime_error("Couldn't create a file next to " + target + ": " + strerror(errno));
+        }
+        struct stat targetInfo;
+        if (stat(target.c_str(), &targetInfo) != 0 || fchmod(fd, targetInfo.st_mode & 07777) != 0) {
+            const std::string error = strerror(errno);
+            close(fd);
+            unlink(path.c_str());
+            throw std::runtime_error("Couldn't copy the permissions of " + target + ": " + error);
+        }
+    }
+    ~ReplacementFile()
+    {
+        if (fd >= 0) {
+            close(fd);
+        }
+        if (!committed) {
+            unlink(path.c_str());
+        }
+    }
+    ReplacementFile(const ReplacementFile&) = delete;
+    ReplacementFile& operator=(const ReplacementFile&) = delete;
+
+    int descriptor() const { return fd; }
+    const std::string& name() const { return path; }
+
+    // Makes the written bytes durable, closing the file.
+    void sync()
+    {
+        const int result = fsync(fd) == 0 ? close(fd) : -1;
+        fd = -1;
+        if (result != 0) {
+            throw std::runtime_error("Couldn't write " + path + ": " + strerror(errno));
+        }
+    }
+
+    // Replaces the target, and makes that durable too.
+    void commit()
+    {
+        if (rename(path.c_str(), target.c_str()) != 0) {
+            throw std::runtime_error("Couldn't replace " + target + ": " + strerror(errno));
+        }
+        committed = true;
+
+        auto directory = std::filesystem::path(target).parent_path();
+        const int directoryFd = open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (directoryFd >= 0) {
+            fsync(directoryFd);
+            close(directoryFd);
+        }
+    }
+
+private:
+    std::string target;
+    std::string path;
+    int fd;
+    bool committed = false;
+};
+
+void verify(const std::string& path, const Plan& written)
+{
+    MappedFile file(path);
+    Cursor data(file.data(), file.size());
+    parseGlobalHeader(data);
+    const auto sections = getAllSections(data);
+    if (!samePlan(written, planShrink(sections, ShrinkOptions{}))) {
+        throw std::runtime_error("The rewritten save didn't read back as written, left the profile alone");
+    }
+
+    Arena arena;
+    for (const auto& section : sections) {
+        arena.reset();
+        DocumentWriter writer(arena, file.data(), file.size());
+        writeSection(section, writer);
+    }
+}
+
+ShrinkResult shrinkProfile(const std::string& path, const ShrinkOptions& options)
+{
+    MappedFile file(path);
+    if (isEncryptedSave(file.data(), file.size())) {
+        throw std::runtime_error("Encrypted profiles can't be rewritten");
+    }
+    Cursor data(file.data(), file.size());
+    parseGlobalHeader(data);
+    const Plan plan = planShrink(getAllSections(data), options);
+
+    ShrinkResult result;
+    result.files = 1;
+    result.bytesBefore = file.size();
+    result.bytesAfter = file.size();
+    result.nodesBefore = plan.nodesBefore;
+    result.nodesAfter = plan.nodesAfter;
+    result.sectionsDropped = plan.sectionsDropped;
+    if (!plan.changesAnything()) {
+        return result;
+    }
+
+    ReplacementFile replacement(path);
+    {
+        // straight from the mapped profile into the file
+        OutputBuffer out(replacement.descriptor());
+        encodePlan(plan, out);
+        out.flush();
+    }
+    replacement.sync();
+    verify(replacement.name(), plan);
+    replacement.commit();
+
+    result.bytesAfter = MappedFile(path).size();
+    result.rewritten = 1;
+    return result;
+}
+}
+
+ShrinkResult shrinkProfiles(const std::vector<std::string>& profilePaths, const ShrinkOptions& options)
+{
+    for (const auto& name : options.dropSections) {
+        if (name == sectionName(SectionType::nospamkeys)) {
+            throw std::invalid_argument("The " + name + " section holds the profile's keys and can't be dropped");
+        }
+        // type 0 stands for every unknown type
+        bool known = name == sectionName(static_cast<SectionType>(0));
+        for (const auto type : knownSections) {
+            known |= name == sectionName(type);
+        }
+        if (!known) {
+            throw std::invalid_argument("Unknown section " + name);
+        }
+    }
+
+    ShrinkResult result;
+    for (const auto& path : profilePaths) {
+        ++result.files;
+        try {
+            const auto file = shrinkProfile(path, options);
+            if (file.rewritten) {
+                std::cerr << path << ": " << file.bytesBefore << " -> " << file.bytesAfter << " bytes" << std::endl;
+            }
+            result.rewritten += file.rewritten;
+            result.bytesBefore += file.bytesBefore;
+            result.bytesAfter += file.bytesAfter;
+            result.nodesBefore += file.nodesBefore;
+            result.nodesAfter += file.nodesAfter;
+            result.sectionsDropped += file.sectionsDropped;
+        }
+        catch (const std::exception& e) {
+            ++result.failed;
+            std::cerr << path << ": " << e.what() << std::endl;
+        }
+    }
+    return result;
+}
+
+void printShrinkSummary(const ShrinkResult& result, std::ostream& out)
+{
+    out << "Rewrote " << result.rewritten << "/" << result.files << " files (" << result.failed << " failed, "
+        << result.files - result.failed - result.rewritten << " unchanged), " << result.bytesBefore << " -> "
+        << result.bytesAfter << " bytes, " << result.nodesBefore << " -> " << result.nodesAfter << " nodes, "
+        << result.sectionsDropped << " sections dropped" << std::endl;
+}
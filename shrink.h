@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>  // for size_t
+#include <cstdint>  // for uint64_t
+#include <iosfwd>   // for ostream
+#include <string>   // for string
+#include <vector>   // for vector
+
+struct ShrinkOptions {
+    size_t maxNodes = 0;                   // per DHT, TCP relay and path node list, 0 for no limit
+    bool dropEmpty = false;                // sections without any payload
+    std::vector<std::string> dropSections; // by name as in the JSON output, "Unknown Section" for all unknown types
+};
+
+struct ShrinkResult {
+    size_t files = 0;
+    size_t failed = 0;
+    size_t rewritten = 0; // the others were left alone, there was nothing to drop
+    uint64_t bytesBefore = 0;
+    uint64_t bytesAfter = 0;
+    uint64_t nodesBefore = 0;
+    uint64_t nodesAfter = 0;
+    size_t sectionsDropped = 0;
+};
+
+// Rewrites every profile in place without its duplicate nodes, keeping at most options.maxNodes of each node list (the
+// first ones) and leaving out the sections options asks to drop. Everything else is copied byte for byte from the
+// mapped profile. The new save is written to a temporary file next to the profile and read back: it has to parse into
+// the same sections and nodes that were meant to be written, and every section has to decode, before it replaces the
+// profile with rename(2). A crash or a failed check leaves the original. Unencrypted profiles only; a profile that
+// can't be rewritten is reported on stderr and counted, but doesn't stop the others. Throws std::invalid_argument for
+// an unknown section name in options, or for dropping the Nospam and Keys section.
+ShrinkResult shrinkProfiles(const std::vector<std::string>& profilePaths, const ShrinkOptions& options);
+
+void printShrinkSummary(const ShrinkResult& result, std::ostream& out);
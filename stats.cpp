@@ -0,0 +1,342 @@
+#include "stats.h"
+
+#ifdef TOXSAVE_HAVE_STATS
+
+#include <time.h>     // for clock_gettime, timespec, CLOCK_MONOTONIC, CLOCK_THREAD_CPUTIME_ID
+#include <algorithm>  // for sort
+#include <vector>     // for vector
+#include "writer.h"   // for Writer
+
+thread_local uint64_t threadAllocationCount = 0;
+thread_local StatsContext threadStatsContext;
+
+namespace {
+const char* const stageNames[stageCount] = {"Open", "Sections", "Decode", "Serialize", "Output"};
+const size_t unknownSectionSlot = sectionSlotCount - 1;
+
+uint64_t nanoseconds(clockid_t clock)
+{
+    timespec time;
+    clock_gettime(clock, &time);
+    return static_cast<uint64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+}
+
+uint64_t wallClock()
+{
+    return nanoseconds(CLOCK_MONOTONIC);
+}
+
+uint64_t threadCpuClock()
+{
+    return nanoseconds(CLOCK_THREAD_CPUTIME_ID);
+}
+
+size_t sectionSlot(SectionType type)
+{
+    switch (type) {
+    case SectionType::nospamkeys:
+        return 0;
+    case SectionType::dht:
+        return 1;
+    case SectionType::friends:
+        return 2;
+    case SectionType::name:
+        return 3;
+    case SectionType::statusmessage:
+        return 4;
+    case SectionType::status:
+        return 5;
+    case SectionType::tcpRelay:
+        return 6;
+    case SectionType::pathNode:
+        return 7;
+    case SectionType::conferences:
+        return 8;
+    case SectionType::eof:
+        break;
+    }
+    return unknownSectionSlot;
+}
+
+const char* sectionSlotName(size_t slot)
+{
+    static const SectionType types[] = {SectionType::nospamkeys, SectionType::dht, SectionType::friends,
+                                        SectionType::name, SectionType::statusmessage, SectionType::status,
+                                        SectionType::tcpRelay, SectionType::pathNode, SectionType::conferences};
+    // type 0 is named like every unknown type
+    return sectionName(slot == unknownSectionSlot ? static_cast<SectionType>(0) : types[slot]);
+}
+
+// The sections decoded as lists count their entries (countRecords()), the others one record each.
+bool isListSection(SectionType type)
+{
+    return type == SectionType::dht || type == SectionType::friends || type == SectionType::tcpRelay
+        || type == SectionType::pathNode || type == SectionType::conferences;
+}
+
+void add(std::atomic<uint64_t>& counter, uint64_t value)
+{
+    counter.fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t load(const std::atomic<uint64_t>& counter)
+{
+    return counter.load(std::memory_order_relaxed);
+}
+
+struct Totals {
+    uint64_t calls = 0;
+    uint64_t wallNs = 0;
+    uint64_t cpuNs = 0;
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    uint64_t records = 0;
+    // wall time per profile that has any
+    std::vector<uint64_t> profileWallNs;
+
+    void add(const StatsCounters& counters, bool perProfile)
+    {
+        const uint64_t profileCalls = load(counters.calls);
+        calls += profileCalls;
+        wallNs += load(counters.wallNs);
+        cpuNs += load(counters.cpuNs);
+        allocations += load(counters.allocations);
+        bytes += load(counters.bytes);
+        records += load(counters.records);
+        if (perProfile && profileCalls > 0) {
+            profileWallNs.push_back(load(counters.wallNs));
+        }
+    }
+};
+
+int64_t number(uint64_t value)
+{
+    return static_cast<int64_t>(value);
+}
+
+// nearest rank
+uint64_t percentile(const std::vector<uint64_t>& sorted, size_t percent)
+{
+    const size_t rank = (percent * sorted.size() + 99) / 100;
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+void writeTotals(Totals& totals, bool section, Writer& out)
+{
+    out.beginObject();
+    out.key("Calls");
+    out.number(number(totals.calls));
+    if (section) {
+        out.key("Bytes");
+        out.number(number(totals.bytes));
+        out.key("Records");
+        out.number(number(totals.records));
+    }
+    out.key("Wall ns");
+    out.number(number(totals.wallNs));
+    out.key("CPU ns");
+    out.number(number(totals.cpuNs));
+    out.key("Allocations");
+    out.number(number(totals.allocations));
+    if (!totals.profileWallNs.empty()) {
+        auto& wall = totals.profileWallNs;
+        std::sort(wall.begin(), wall.end());
+        out.key("Wall ns per profile");
+        out.beginObject();
+        out.key("p50");
+        out.number(number(percentile(wall, 50)));
+        out.key("p90");
+        out.number(number(percentile(wall, 90)));
+        out.key("p99");
+        out.number(number(percentile(wall, 99)));
+        out.key("Max");
+        out.number(number(wall.back()));
+        out.endObject();
+    }
+    out.endObject();
+}
+}
+
+StatsScope::StatsScope(ProfileStats* stats)
+    : previous(threadStatsContext)
+{
+    threadStatsContext = StatsContext{stats, -1, -1};
+}
+
+StatsScope::~StatsScope()
+{
+    threadStatsContext = previous;
+}
+
+StageTimer::StageTimer(Stage stage)
+    : previousStage(threadStatsContext.stage)
+{
+    if (!threadStatsContext.stats) {
+        return;
+    }
+    counters = &threadStatsContext.stats->stages[static_cast<size_t>(stage)];
+    threadStatsContext.stage = static_cast<int>(stage);
+    wallStart = wallClock();
+    cpuStart = threadCpuClock();
+    allocationStart = threadAllocationCount;
+}
+
+StageTimer::~StageTimer()
+{
+    if (!counters) {
+        return;
+    }
+    add(counters->calls, 1);
+    add(counters->wallNs, wallClock() - wallStart);
+    add(counters->cpuNs, threadCpuClock() - cpuStart);
+    add(counters->allocations, threadAllocationCount - allocationStart);
+    threadStatsContext.stage = previousStage;
+}
+
+SectionTimer::SectionTimer(const SectionHeader& section)
+    : previousSection(threadStatsContext.section)
+{
+    if (!threadStatsContext.stats) {
+        return;
+    }
+    const size_t slot = sectionSlot(section.type);
+    counters = &threadStatsContext.stats->sections[slot];
+    add(counters->bytes, section.size);
+    if (!isListSection(section.type)) {
+        add(counters->records, 1);
+    }
+    threadStatsContext.section = static_cast<int>(slot);
+    wallStart = wallClock();
+    cpuStart = threadCpuClock();
+    allocationStart = threadAllocationCount;
+}
+
+SectionTimer::~SectionTimer()
+{
+    if (!counters) {
+        return;
+    }
+    add(counters->calls, 1);
+    add(counters->wallNs, wallClock() - wallStart);
+    add(counters->cpuNs, threadCpuClock() - cpuStart);
+    add(counters->allocations, threadAllocationCount - allocationStart);
+    threadStatsContext.section = previousSection;
+}
+
+void countRecords(size_t count)
+{
+    const auto& context = threadStatsContext;
+    if (context.stats && context.section >= 0) {
+        add(context.stats->sections[context.section].records, count);
+    }
+}
+
+PoolTaskTimer::PoolTaskTimer(const StatsContext& context)
+{
+    if (!context.stats || threadStatsContext.stats) {
+        return;
+    }
+    active = true;
+    threadStatsContext = context;
+    wallStart = wallClock();
+    cpuStart = threadCpuClock();
+    allocationStart = threadAllocationCount;
+}
+
+PoolTaskTimer::PoolTaskTimer(ProfileStats* stats)
+    : PoolTaskTimer(StatsContext{stats, -1, -1})
+{
+}
+
+PoolTaskTimer::~PoolTaskTimer()
+{
+    if (!active) {
+        return;
+    }
+    const auto& context = threadStatsContext;
+    const uint64_t cpu = threadCpuClock() - cpuStart;
+    const uint64_t allocations = threadAllocationCount - allocationStart;
+    add(context.stats->poolBusyNs, wallClock() - wallStart);
+    // the wall time is already counted by the thread waiting for the task
+    if (context.stage >= 0) {
+        add(context.stats->stages[context.stage].cpuNs, cpu);
+        add(context.stats->stages[context.stage].allocations, allocations);
+    }
+    if (context.section >= 0) {
+        add(context.stats->sections[context.section].cpuNs, cpu);
+        add(context.stats->sections[context.section].allocations, allocations);
+    }
+    threadStatsContext = StatsContext{};
+}
+
+StatsReport::StatsReport()
+    : start(wallClock())
+{
+}
+
+ProfileStats& StatsReport::addProfile()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    profiles.emplace_back();
+    return profiles.back();
+}
+
+void StatsReport::write(Writer& out, unsigned poolThreads) const
+{
+    const uint64_t wallNs = wallClock() - start;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Totals stages[stageCount];
+    Totals sections[sectionSlotCount];
+    uint64_t poolBusyNs = load(outside.poolBusyNs);
+    for (size_t i = 0; i < stageCount; ++i) {
+        stages[i].add(outside.stages[i], false);
+    }
+    for (size_t i = 0; i < sectionSlotCount; ++i) {
+        sections[i].add(outside.sections[i], false);
+    }
+    for (const auto& profile : profiles) {
+        for (size_t i = 0; i < stageCount; ++i) {
+            stages[i].add(profile.stages[i], true);
+        }
+        for (size_t i = 0; i < sectionSlotCount; ++i) {
+            sections[i].add(profile.sections[i], true);
+        }
+        poolBusyNs += load(profile.poolBusyNs);
+    }
+
+    out.beginObject();
+    out.key("Files");
+    out.number(number(profiles.size()));
+    out.key("Wall ns");
+    out.number(number(wallNs));
+    out.key("Stages");
+    out.beginObject();
+    for (size_t i = 0; i < stageCount; ++i) {
+        out.key(stageNames[i]);
+        writeTotals(stages[i], false, out);
+    }
+    out.endObject();
+    out.key("Sections");
+    out.beginObject();
+    for (size_t i = 0; i < sectionSlotCount; ++i) {
+        if (sections[i].calls > 0) {
+            out.key(sectionSlotName(i));
+            writeTotals(sections[i], true, out);
+        }
+    }
+    out.endObject();
+    out.key("Thread pool");
+    out.beginObject();
+    out.key("Threads");
+    out.number(poolThreads);
+    out.key("Busy ns");
+    out.number(number(poolBusyNs));
+    out.key("Utilization %");
+    const uint64_t capacity = wallNs * poolThreads;
+    out.number(capacity > 0 ? number(poolBusyNs * 100 / capacity) : 0);
+    out.endObject();
+    out.endObject();
+}
+
+#endif
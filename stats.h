@@ -0,0 +1,214 @@
+#pragma once
+
+#include <atomic>      // for atomic
+#include <cstddef>     // for size_t
+#include <cstdint>     // for uint64_t
+#include <deque>       // for deque
+#include <mutex>       // for mutex
+#include "sections.h"  // for SectionHeader
+
+class Writer;
+
+// Instrumentation behind --stats: wall time, CPU time and heap allocations per stage of the pipeline and per section
+// type, with the bytes and records decoded. Everything is counted into the ProfileStats installed on the current
+// thread by a StatsScope, and the timers only read a thread local unless one is. Allocations are counted by whoever
+// replaces operator new (the toxsaveparser executable) calling countAllocation(). Built without TOXSAVE_HAVE_STATS
+// (-DTOXSAVE_WITH_STATS=OFF) all of it is empty inline functions and compiles away.
+
+enum class Stage {
+    open,      // mapping and decrypting the save
+    sections,  // checking the global header and walking the section headers
+    decode,    // decoding the sections, for the streamed formats straight into the output encoder
+    serialize, // qjson: sorting the decoded sections and encoding them
+    output,    // write(2)ing the output, which for the streamed formats happens during decode
+};
+
+#ifdef TOXSAVE_HAVE_STATS
+
+const bool statsAvailable = true;
+
+const size_t stageCount = 5;
+// the known section types and one for all unknown ones
+const size_t sectionSlotCount = 10;
+
+struct StatsCounters {
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> wallNs{0};
+    std::atomic<uint64_t> cpuNs{0};
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> bytes{0};   // sections only
+    std::atomic<uint64_t> records{0}; // sections only: friends, nodes, conferences and their peers, 1 for the others
+};
+
+// The counts of one profile (or of the work outside of any, see StatsReport), added to from every thread working on
+// it.
+struct ProfileStats {
+    StatsCounters stages[stageCount];
+    StatsCounters sections[sectionSlotCount];
+    // wall time of the thread pool tasks working on the profile
+    std::atomic<uint64_t> poolBusyNs{0};
+};
+
+// Where the current thread counts to. Captured before handing work to the thread pool, for PoolTaskTimer.
+struct StatsContext {
+    ProfileStats* stats = nullptr;
+    int stage = -1;
+    int section = -1;
+};
+
+extern thread_local uint64_t threadAllocationCount;
+extern thread_local StatsContext threadStatsContext;
+
+inline void countAllocation()
+{
+    ++threadAllocationCount;
+}
+
+inline StatsContext currentStatsContext()
+{
+    return threadStatsContext;
+}
+
+// Counts into stats on this thread until destroyed. A null stats counts nothing.
+class StatsScope {
+public:
+    explicit StatsScope(ProfileStats* stats);
+    ~StatsScope();
+    StatsScope(const StatsScope&) = delete;
+    StatsScope& operator=(const StatsScope&) = delete;
+
+private:
+    StatsContext previous;
+};
+
+// Measures a (possibly nested) stage on the current thread.
+class StageTimer {
+public:
+    explicit StageTimer(Stage stage);
+    ~StageTimer();
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    StatsCounters* counters = nullptr;
+    int previousStage;
+    uint64_t wallStart;
+    uint64_t cpuStart;
+    uint64_t allocationStart;
+};
+
+// Measures decoding one section, in writeSection().
+class SectionTimer {
+public:
+    explicit SectionTimer(const SectionHeader& section);
+    ~SectionTimer();
+    SectionTimer(const SectionTimer&) = delete;
+    SectionTimer& operator=(const SectionTimer&) = delete;
+
+private:
+    StatsCounters* counters = nullptr;
+    int previousSection;
+    uint64_t wallStart;
+    uint64_t cpuStart;
+    uint64_t allocationStart;
+};
+
+// Adds count records to the section being decoded on this thread.
+void countRecords(size_t count);
+
+// Counts a thread pool task into the stage and section it was started from, and its wall time as pool busy time.
+// Does nothing when the task runs on a thread that is already counting, e.g. the one that started it. Tasks that
+// work on a whole profile of their own are started from its stats.
+class PoolTaskTimer {
+public:
+    explicit PoolTaskTimer(const StatsContext& context);
+    explicit PoolTaskTimer(ProfileStats* stats);
+    ~PoolTaskTimer();
+    PoolTaskTimer(const PoolTaskTimer&) = delete;
+    PoolTaskTimer& operator=(const PoolTaskTimer&) = delete;
+
+private:
+    bool active = false;
+    uint64_t wallStart;
+    uint64_t cpuStart;
+    uint64_t allocationStart;
+};
+
+// The stats of a whole run: one ProfileStats per profile, summed and with percentiles over the profiles, plus the
+// work outside of any profile.
+class StatsReport {
+public:
+    StatsReport();
+    StatsReport(const StatsReport&) = delete;
+    StatsReport& operator=(const StatsReport&) = delete;
+
+    // Can be called from any thread, the reference stays valid.
+    ProfileStats& addProfile();
+    ProfileStats& outsideProfiles() { return outside; }
+
+    // Writes {"Files", "Wall ns", "Stages", "Sections", "Thread pool"}, times in nanoseconds. Stages and sections have
+    // their totals and the 50th, 90th and 99th percentile and maximum wall time of a profile.
+    void write(Writer& out, unsigned poolThreads) const;
+
+private:
+    uint64_t start;
+    mutable std::mutex mutex;
+    std::deque<ProfileStats> profiles;
+    ProfileStats outside;
+};
+
+#else
+
+const bool statsAvailable = false;
+
+struct ProfileStats {
+};
+
+struct StatsContext {
+};
+
+inline void countAllocation()
+{
+}
+
+inline StatsContext currentStatsContext()
+{
+    return {};
+}
+
+class StatsScope {
+public:
+    explicit StatsScope(ProfileStats*) {}
+};
+
+class StageTimer {
+public:
+    explicit StageTimer(Stage) {}
+};
+
+class SectionTimer {
+public:
+    explicit SectionTimer(const SectionHeader&) {}
+};
+
+inline void countRecords(size_t)
+{
+}
+
+class PoolTaskTimer {
+public:
+    explicit PoolTaskTimer(const StatsContext&) {}
+    explicit PoolTaskTimer(ProfileStats*) {}
+};
+
+class StatsReport {
+public:
+    ProfileStats& addProfile() { return profile; }
+    ProfileStats& outsideProfiles() { return profile; }
+    void write(Writer&, unsigned) const {}
+
+private:
+    ProfileStats profile;
+};
+
+#endif
@@ -0,0 +1,294 @@
+#include "streamdecoder.h"
+#include <algorithm>           // for min
+#include <stdexcept>           // for runtime_error, invalid_argument
+#include <string>              // for string, to_string
+#include "conferenceindex.h"   // for ConferenceIndex
+#include "cursor.h"            // for Cursor
+#include "decoders.h"          // for addFriend, beginConference, endConference, readDhtHeader, writeConferencePeer, ...
+#include "encryptedsave.h"     // for isEncryptedSave
+#include "friendrecord.h"      // for FriendRecordLayout
+#include "nodeinfo.h"          // for nodeInfoSize, writeNodeInfo
+#include "utils.h"             // for loadNumber, Endianness
+#include "writer.h"            // for Writer
+
+namespace {
+const size_t globalHeaderSize = 8;
+const size_t sectionHeaderSize = 8;
+// a node's family byte, which gives its size
+const size_t nodeMinimumSize = 1;
+
+// Same message as Cursor::require(), for sizes checked against what's left of the stream rather than a buffer.
+[[noreturn]] void truncated(const char* what, uint64_t size, uint64_t left)
+{
+    throw std::runtime_error(std::string("Truncated ") + what + ": needs " + std::to_string(size) + " bytes, "
+                             + std::to_string(left) + " left.");
+}
+}
+
+StreamDecoder::StreamDecoder(Writer& out)
+    : out(out)
+    , need(globalHeaderSize)
+{
+}
+
+void StreamDecoder::feed(const uint8_t* data, size_t size)
+{
+    while (state != State::done) {
+        if (pending.empty()) {
+            if (size < need) {
+                // keep the start of the record until the next chunk completes it
+                pending.assign(data, data + size);
+                return;
+            }
+            const size_t used = step(data, size);
+            data += used;
+            size -= used;
+            continue;
+        }
+
+        if (pending.size() < need) {
+            const size_t take = std::min(need - pending.size(), size);
+            pending.insert(pending.end(), data, data + take);
+            data += take;
+            size -= take;
+            if (pending.size() < need) {
+                return;
+            }
+        }
+        const size_t used = step(pending.data(), pending.size());
+        pending.erase(pending.begin(), pending.begin() + used);
+    }
+}
+
+void StreamDecoder::finish() const
+{
+    if (state != State::done) {
+        throw std::runtime_error("Truncated save: the input ended before its EOF section.");
+    }
+}
+
+size_t StreamDecoder::step(const uint8_t* data, size_t size)
+{
+    switch (state) {
+    case State::globalHeader: {
+        if (isEncryptedSave(data, size)) {
+            throw std::runtime_error("Encrypted profiles can't be decoded from a stream, they're decrypted whole.");
+        }
+        Cursor header(data, globalHeaderSize);
+        parseGlobalHeader(header);
+        out.beginObject();
+        expect(State::sectionHeader, sectionHeaderSize);
+        return globalHeaderSize;
+    }
+    case State::sectionHeader: {
+        Cursor header(data, sectionHeaderSize);
+        section = getSection(header);
+        if (section.type == SectionType::eof) {
+            out.endObject();
+            state = State::done;
+            return sectionHeaderSize;
+        }
+        out.key(sectionName(section.type));
+        sectionLeft = section.size;
+        beginSection();
+        return sectionHeaderSize;
+    }
+    case State::wholeSection: {
+        SectionHeader whole = section;
+        whole.data = data;
+        writeSection(whole, out);
+        expect(State::sectionHeader, sectionHeaderSize);
+        return whole.size;
+    }
+    case State::skip: {
+        const size_t used = std::min<uint64_t>(size, sectionLeft);
+        sectionLeft -= used;
+        if (sectionLeft == 0) {
+            expect(State::sectionHeader, sectionHeaderSize);
+        }
+        return used;
+    }
+    case State::dhtHeader: {
+        Cursor header(data, need);
+        const auto nodesSize = readDhtHeader(header);
+        sectionLeft -= dhtHeaderSize;
+        if (nodesSize > sectionLeft) {
+            truncated("DHT section", nodesSize, sectionLeft);
+        }
+        beginList(State::nodes, nodesSize);
+        return dhtHeaderSize;
+    }
+    case State::nodes:
+    case State::friends:
+    case State::conference:
+    case State::conferencePeer:
+        return stepList(data, size);
+    case State::done:
+        break;
+    }
+    return 0;
+}
+
+size_t StreamDecoder::stepList(const uint8_t* data, size_t size)
+{
+    // peers are counted by their conference, a missing one fails below
+    if (listLeft == 0 && state != State::conferencePeer) {
+        endList();
+        return 0;
+    }
+    // a record running past the list is decoded from what there is, to fail like on a mapped save
+    Cursor record(data, std::min<uint64_t>(size, listLeft));
+
+    switch (state) {
+    case State::nodes: {
+        const size_t recordSize = nodeInfoSize(data[0]);
+        if (!haveRecord(recordSize, size)) {
+            return 0;
+        }
+        writeNodeInfo(record, out);
+        consumed(recordSize);
+        expectRecord(nodeMinimumSize);
+        return recordSize;
+    }
+    case State::friends:
+        out.beginObject();
+        addFriend(record, out);
+        out.endObject();
+        consumed(FriendRecordLayout::size);
+        expectRecord(FriendRecordLayout::size);
+        return FriendRecordLayout::size;
+    case State::conference: {
+        record.require(ConferenceIndex::conferenceFixedSize, "conference");
+        const size_t recordSize = ConferenceIndex::conferenceFixedSize + data[ConferenceIndex::conferenceFixedSize - 1];
+        if (!haveRecord(recordSize, size)) {
+            return 0;
+        }
+        record.require(recordSize, "conference title");
+        beginConference(data, out);
+        peersLeft = loadNumber<Endianness::little, int32_t>(data + ConferenceIndex::conferenceFixedSize - 5);
+        consumed(recordSize);
+        if (peersLeft > 0) {
+            state = State::conferencePeer;
+            expectRecord(ConferenceIndex::peerFixedSize);
+        } else {
+            endConference(out);
+            expectRecord(ConferenceIndex::conferenceFixedSize);
+        }
+        return recordSize;
+    }
+    case State::conferencePeer: {
+        record.require(ConferenceIndex::peerFixedSize, "conference peer");
+        const size_t recordSize = ConferenceIndex::peerFixedSize + data[ConferenceIndex::peerFixedSize - 1];
+        if (!haveRecord(recordSize, size)) {
+            return 0;
+        }
+        record.require(recordSize, "conference peer name");
+        writeConferencePeer(data, out);
+        consumed(recordSize);
+        if (--peersLeft > 0) {
+            expectRecord(ConferenceIndex::peerFixedSize);
+        } else {
+            endConference(out);
+            state = State::conference;
+            expectRecord(ConferenceIndex::conferenceFixedSize);
+        }
+        return recordSize;
+    }
+    default:
+        break;
+    }
+    return 0;
+}
+
+void StreamDecoder::beginSection()
+{
+    switch (section.type) {
+    case SectionType::nospamkeys:
+    case SectionType::name:
+    case SectionType::statusmessage:
+    case SectionType::status:
+        if (section.size > maxWholeSectionSize) {
+            throw std::runtime_error("Section too large to decode from a stream: " + std::to_string(section.size)
+                                     + " bytes.");
+        }
+        expect(State::wholeSection, section.size);
+        break;
+    case SectionType::dht:
+        expect(State::dhtHeader, std::min<uint64_t>(dhtHeaderSize, sectionLeft));
+        break;
+    case SectionType::friends:
+        if (section.size % FriendRecordLayout::size != 0) {
+            throw std::runtime_error("Friends section size isn't a multiple of the friend record size");
+        }
+        beginList(State::friends, section.size);
+        break;
+    case SectionType::tcpRelay:
+    case SectionType::pathNode:
+        beginList(State::nodes, section.size);
+        break;
+    case SectionType::conferences:
+        beginList(State::conference, section.size);
+        break;
+    default:
+        // unknown section
+        out.number(static_cast<int>(section.type));
+        if (section.size == 0) {
+            expect(State::sectionHeader, sectionHeaderSize);
+        } else {
+            expect(State::skip, 1);
+        }
+    }
+}
+
+void StreamDecoder::beginList(State list, uint64_t size)
+{
+    out.beginArray();
+    state = list;
+    listLeft = size;
+    switch (list) {
+    case State::nodes:
+        expectRecord(nodeMinimumSize);
+        break;
+    case State::friends:
+        expectRecord(FriendRecordLayout::size);
+        break;
+    default:
+        expectRecord(ConferenceIndex::conferenceFixedSize);
+    }
+}
+
+void StreamDecoder::endList()
+{
+    out.endArray();
+    if (sectionLeft != 0) {
+        throw std::runtime_error("Section contents didn't match section size.");
+    }
+    expect(State::sectionHeader, sectionHeaderSize);
+}
+
+void StreamDecoder::expect(State next, size_t bytes)
+{
+    state = next;
+    need = bytes;
+}
+
+void StreamDecoder::expectRecord(size_t minimumSize)
+{
+    // never wait for input past the list, a record that doesn't fit fails with what there is
+    need = std::min<uint64_t>(minimumSize, listLeft);
+}
+
+bool StreamDecoder::haveRecord(size_t recordSize, size_t available)
+{
+    if (recordSize > available && recordSize <= listLeft) {
+        need = recordSize;
+        return false;
+    }
+    return true;
+}
+
+void StreamDecoder::consumed(size_t bytes)
+{
+    listLeft -= bytes;
+    sectionLeft -= bytes;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>     // for size_t
+#include <cstdint>     // for uint8_t, int32_t, uint64_t
+#include <vector>      // for vector
+#include "sections.h"  // for SectionHeader
+
+class Writer;
+
+// Decodes a save that arrives in chunks of any size, e.g. read from a pipe, writing the same events as writeProfile()
+// (sections in save order). Input is consumed section by section and record by record within a section (friends,
+// nodes, conferences and each of their peers), decoding every record as soon as it is complete, so only a record
+// that runs past the end of a chunk is buffered. Sections that are a single value (nospam and keys, name, status
+// message, status) are buffered whole, up to maxWholeSectionSize.
+//
+// Unlike a mapped save, whose section headers are all checked before anything is written, malformed or truncated input
+// is only found when decoding gets there, after the sections before it have been written. For the same reason a
+// section name that comes up again later (several unknown sections, say) is written every time, where writeProfile()
+// keeps only the last. Encrypted saves can't be
+// decrypted incrementally and are rejected. Anything after the EOF section is ignored.
+class StreamDecoder {
+public:
+    static constexpr size_t maxWholeSectionSize = 1 << 20;
+
+    explicit StreamDecoder(Writer& out);
+
+    // Decodes what data completes. Throws like the decoders do on malformed input, after which the decoder is unusable.
+    void feed(const uint8_t* data, size_t size);
+    // Throws std::runtime_error if the input ended before the EOF section.
+    void finish() const;
+
+    bool done() const { return state == State::done; }
+
+private:
+    enum class State {
+        globalHeader,
+        sectionHeader,
+        wholeSection,  // one value, decoded by writeSection()
+        skip,          // an unknown section's payload
+        dhtHeader,     // state cookie and the nodes inner section header
+        nodes,
+        friends,
+        conference,
+        conferencePeer,
+        done,
+    };
+
+    // Decodes the next step from the size (at least need) bytes at data, returning how many it consumed. 0 means it
+    // needs more input and has raised need.
+    size_t step(const uint8_t* data, size_t size);
+    size_t stepList(const uint8_t* data, size_t size);
+    void beginSection();
+    void beginList(State list, uint64_t size);
+    void endList();
+    void expect(State next, size_t bytes);
+    void expectRecord(size_t minimumSize);
+    bool haveRecord(size_t recordSize, size_t available);
+    void consumed(size_t bytes);
+
+    Writer& out;
+    State state = State::globalHeader;
+    size_t need;
+    // the start of a record that ran past the end of the last chunk
+    std::vector<uint8_t> pending;
+    SectionHeader section;
+    uint64_t sectionLeft = 0;
+    // what's left of the records of the current list, which for the DHT is the nodes inner section
+    uint64_t listLeft = 0;
+    int32_t peersLeft = 0;
+};
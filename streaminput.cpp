@@ -0,0 +1,106 @@
+#include "streaminput.h"
+#include <errno.h>           // for errno, EINTR
+#include <string.h>          // for strerror
+#include <unistd.h>          // for read
+#include <chrono>            // for steady_clock, duration
+#include <cstdint>           // for uint8_t
+#include <exception>         // for exception
+#include <iostream>          // for cerr, endl
+#include <stdexcept>         // for runtime_error
+#include <vector>            // for vector
+#include "outputbuffer.h"    // for OutputBuffer
+#include "streamdecoder.h"   // for StreamDecoder
+#include "tarreader.h"       // for TarReader
+
+namespace {
+const size_t chunkSize = 64 * 1024;
+
+size_t readChunk(int fd, uint8_t* buffer, size_t size)
+{
+    while (true) {
+        const auto got = ::read(fd, buffer, size);
+        if (got >= 0) {
+            return static_cast<size_t>(got);
+        }
+        if (errno != EINTR) {
+            throw std::runtime_error(std::string("Error reading the profile: ") + strerror(errno));
+        }
+    }
+}
+
+bool isProfileName(const std::string& name)
+{
+    const std::string extension = ".tox";
+    return name.size() > extension.size() && name.compare(name.size() - extension.size(), extension.size(), extension) == 0;
+}
+}
+
+void writeStreamedProfile(int fd, const OutputOptions& options, OutputBuffer& out)
+{
+    ProfileOutput output(options, out);
+    StreamDecoder decoder(output.writer());
+    std::vector<uint8_t> chunk(chunkSize);
+    // the rest of the input after the EOF section isn't read
+    while (!decoder.done()) {
+        const size_t size = readChunk(fd, chunk.data(), chunk.size());
+        if (size == 0) {
+            break;
+        }
+        decoder.feed(chunk.data(), size);
+    }
+    decoder.finish();
+    output.finish();
+}
+
+BatchResult runTarStream(int fd, const std::string& archive, OutputOptions options)
+{
+    BatchResult result;
+    OutputBuffer stdoutBuffer(1);
+    // each profile is written to stdout once it decoded, so a broken one doesn't leave half a document
+    OutputBuffer memberBuffer;
+    std::vector<uint8_t> chunk(chunkSize);
+    // one profile per line, as in batches
+    options.indented = false;
+
+    const auto start = std::chrono::steady_clock::now();
+    TarReader tar(fd);
+    try {
+        while (tar.next()) {
+            if (!isProfileName(tar.name())) {
+                continue;
+            }
+            const std::string file = archive + ":" + tar.name();
+            ++result.files;
+            result.bytes += tar.size();
+            memberBuffer.clear();
+            try {
+                ProfileOutput output(options, memberBuffer, file);
+                StreamDecoder decoder(output.writer());
+                while (!decoder.done()) {
+                    const size_t size = tar.read(chunk.data(), chunk.size());
+                    if (size == 0) {
+                        break;
+                    }
+                    decoder.feed(chunk.data(), size);
+                }
+                decoder.finish();
+                output.finish();
+                stdoutBuffer.append(memberBuffer.data(), memberBuffer.size());
+            }
+            catch (const std::exception& e) {
+                ++result.failed;
+                std::cerr << file << ": " << e.what() << std::endl;
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        // counted as a failed file, so a damaged archive fails the run even if every profile in it decoded
+        ++result.files;
+        ++result.failed;
+        std::cerr << archive << ": " << e.what() << std::endl;
+    }
+    stdoutBuffer.flush();
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>    // for string
+#include "batch.h"   // for BatchResult
+#include "output.h"  // for OutputOptions
+
+class OutputBuffer;
+
+// Decodes the save read from fd (e.g. stdin) with a StreamDecoder as it arrives, appending it to out like
+// writeProfileOutput(). Only one record of the input is held at a time, so the output starts before the input has
+// ended; a save that turns out to be malformed leaves what was written so far in out. The qjson format, selections and
+// salvaging need the whole save and aren't supported.
+void writeStreamedProfile(int fd, const OutputOptions& options, OutputBuffer& out);
+
+// Decodes every *.tox file of the uncompressed tar archive read from fd in one pass, without unpacking or seeking it,
+// writing one {"File": "<archive>:<member>", "Profile"} document per profile to stdout like runBatch(). A profile that
+// fails to decode is reported on stderr and counted, but doesn't stop the archive; a damaged archive does, after
+// reporting it the same way.
+BatchResult runTarStream(int fd, const std::string& archive, OutputOptions options);
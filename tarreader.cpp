@@ -0,0 +1,223 @@
+#include "tarreader.h"
+#include <errno.h>    // for errno, EINTR
+#include <string.h>   // for strerror, memchr
+#include <unistd.h>   // for read
+#include <algorithm>  // for min, all_of
+#include <stdexcept>  // for runtime_error
+
+namespace {
+const size_t blockSize = 512;
+// long names and pax headers are read whole
+const uint64_t maxValueSize = 1 << 20;
+
+// ustar header fields: offset and length
+const size_t nameField = 0, nameLength = 100;
+const size_t sizeField = 124, sizeLength = 12;
+const size_t checksumField = 148, checksumLength = 8;
+const size_t typeField = 156;
+const size_t magicField = 257;
+const size_t prefixField = 345, prefixLength = 155;
+
+// A NUL terminated (or full length) string field.
+std::string field(const uint8_t* header, size_t offset, size_t length)
+{
+    const auto* begin = reinterpret_cast<const char*>(header + offset);
+    const auto* nul = static_cast<const char*>(memchr(begin, 0, length));
+    return std::string(begin, nul ? nul : begin + length);
+}
+
+// Octal digits surrounded by spaces or NULs, or GNU's base-256 for sizes past 8 GiB.
+uint64_t number(const uint8_t* header, size_t offset, size_t length)
+{
+    const uint8_t* value = header + offset;
+    uint64_t result = 0;
+    if (value[0] & 0x80) {
+        result = value[0] & 0x7f;
+        for (size_t i = 1; i < length; ++i) {
+            result = (result << 8) | value[i];
+        }
+        return result;
+    }
+    size_t i = 0;
+    while (i < length && value[i] == ' ') {
+        ++i;
+    }
+    for (; i < length && value[i] >= '0' && value[i] <= '7'; ++i) {
+        result = result * 8 + (value[i] - '0');
+    }
+    if (i < length && value[i] != ' ' && value[i] != 0) {
+        throw std::runtime_error("Invalid number in tar header");
+    }
+    return result;
+}
+
+void checkChecksum(const uint8_t* header)
+{
+    // summed with the checksum field itself taken as spaces
+    uint64_t sum = ' ' * checksumLength;
+    for (size_t i = 0; i < blockSize; ++i) {
+        if (i < checksumField || i >= checksumField + checksumLength) {
+            sum += header[i];
+        }
+    }
+    if (number(header, checksumField, checksumLength) != sum) {
+        throw std::runtime_error("Invalid tar header checksum");
+    }
+}
+
+uint64_t paddingFor(uint64_t size)
+{
+    return (blockSize - size % blockSize) % blockSize;
+}
+
+// The "path" of a pax extended header's "length key=value\n" records, empty if it has none.
+std::string paxPath(const std::string& records)
+{
+    std::string path;
+    size_t pos = 0;
+    while (pos < records.size()) {
+        const size_t space = records.find(' ', pos);
+        if (space == std::string::npos) {
+            break;
+        }
+        const size_t length = std::stoul(records.substr(pos, space - pos));
+        if (length <= space - pos || pos + length > records.size()) {
+            throw std::runtime_error("Invalid pax header record");
+        }
+        const std::string record = records.substr(space + 1, pos + length - space - 2);
+        const size_t equals = record.find('=');
+        if (equals != std::string::npos && record.compare(0, equals, "path") == 0) {
+            path = record.substr(equals + 1);
+        }
+        pos += length;
+    }
+    return path;
+}
+}
+
+TarReader::TarReader(int fd)
+    : fd(fd)
+{
+}
+
+bool TarReader::next()
+{
+    skip(left + padding);
+    left = 0;
+    padding = 0;
+
+    // from the GNU or pax member before a file's header
+    std::string longName;
+    while (true) {
+        uint8_t header[blockSize];
+        const size_t got = readSome(header, blockSize);
+        if (got == 0) {
+            // ended without the two zero blocks, as some writers do
+            return false;
+        }
+        if (got < blockSize) {
+            readExactly(header + got, blockSize - got);
+        }
+        if (std::all_of(header, header + blockSize, [](uint8_t byte) { return byte == 0; })) {
+            return false;
+        }
+        checkChecksum(header);
+
+        const uint64_t size = number(header, sizeField, sizeLength);
+        const char type = static_cast<char>(header[typeField]);
+        if (type == 'L') {
+            longName = readValue(size, paddingFor(size));
+            // NUL terminated
+            longName = longName.substr(0, longName.find('\0'));
+            continue;
+        }
+        if (type == 'x') {
+            const auto path = paxPath(readValue(size, paddingFor(size)));
+            if (!path.empty()) {
+                longName = path;
+            }
+            continue;
+        }
+        // regular files, the old style ones without a type and contiguous files
+        if (type != '0' && type != '\0' && type != '7') {
+            skip(size + paddingFor(size));
+            longName.clear();
+            continue;
+        }
+
+        if (!longName.empty()) {
+            memberName = longName;
+        } else {
+            memberName = field(header, nameField, nameLength);
+            const auto prefix = field(header, prefixField, prefixLength);
+            if (field(header, magicField, 5) == "ustar" && !prefix.empty()) {
+                memberName = prefix + "/" + memberName;
+            }
+        }
+        memberSize = size;
+        left = size;
+        padding = paddingFor(size);
+        return true;
+    }
+}
+
+size_t TarReader::read(uint8_t* buffer, size_t size)
+{
+    const size_t wanted = std::min<uint64_t>(size, left);
+    if (wanted == 0) {
+        return 0;
+    }
+    const size_t got = readSome(buffer, wanted);
+    if (got == 0) {
+        throw std::runtime_error("Truncated tar archive: " + memberName + " ends early");
+    }
+    left -= got;
+    return got;
+}
+
+size_t TarReader::readSome(uint8_t* buffer, size_t size)
+{
+    while (true) {
+        const auto got = ::read(fd, buffer, size);
+        if (got >= 0) {
+            return static_cast<size_t>(got);
+        }
+        if (errno != EINTR) {
+            throw std::runtime_error(std::string("Error reading tar archive: ") + strerror(errno));
+        }
+    }
+}
+
+void TarReader::readExactly(uint8_t* buffer, size_t size)
+{
+    while (size > 0) {
+        const size_t got = readSome(buffer, size);
+        if (got == 0) {
+            throw std::runtime_error("Truncated tar archive");
+        }
+        buffer += got;
+        size -= got;
+    }
+}
+
+void TarReader::skip(uint64_t size)
+{
+    // pipes can't seek
+    uint8_t buffer[64 * 1024];
+    while (size > 0) {
+        const size_t chunk = std::min<uint64_t>(size, sizeof(buffer));
+        readExactly(buffer, chunk);
+        size -= chunk;
+    }
+}
+
+std::string TarReader::readValue(uint64_t size, uint64_t padding)
+{
+    if (size > maxValueSize) {
+        throw std::runtime_error("Tar header value too large: " + std::to_string(size) + " bytes");
+    }
+    std::string value(size, '\0');
+    readExactly(reinterpret_cast<uint8_t*>(value.data()), size);
+    skip(padding);
+    return value;
+}
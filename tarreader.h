@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>  // for size_t
+#include <cstdint>  // for uint8_t, uint64_t
+#include <string>   // for string
+
+// Reads the regular files of an uncompressed tar archive (ustar or GNU, with long names from GNU 'L' members or pax
+// "path" records) from a file descriptor in one pass. Nothing is seeked or buffered beyond one 512 byte header, so it
+// works on pipes and archives of any size. Directories, links and other members are skipped. Throws
+// std::runtime_error for a damaged header or an archive that ends inside a member.
+class TarReader {
+public:
+    explicit TarReader(int fd);
+
+    // Moves to the next regular file, skipping what's left of the current one. False at the end of the archive.
+    bool next();
+    const std::string& name() const { return memberName; }
+    uint64_t size() const { return memberSize; }
+    // Reads up to size bytes of the current file into buffer, 0 at its end.
+    size_t read(uint8_t* buffer, size_t size);
+
+private:
+    size_t readSome(uint8_t* buffer, size_t size);
+    void readExactly(uint8_t* buffer, size_t size);
+    void skip(uint64_t size);
+    std::string readValue(uint64_t size, uint64_t padding);
+
+    int fd;
+    std::string memberName;
+    uint64_t memberSize = 0;
+    // unread bytes of the current file, and the padding after it
+    uint64_t left = 0;
+    uint64_t padding = 0;
+};
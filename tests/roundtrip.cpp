@@ -0,0 +1,124 @@
+// Checks that writing a decoded save gives back the same save: for generated saves of several shapes,
+// parse(write(parse(x))) has to print byte for byte the same JSON and CBOR as parse(x), and writing the rewritten save
+// again has to give the same bytes. Saves are written with SaveEncoder the way --shrink writes them, node sections
+// from their node lists and every other section copied from its payload.
+
+#include <stdio.h>          // for fprintf
+#include <stdlib.h>         // for EXIT_FAILURE, EXIT_SUCCESS
+#include <cstdint>          // for uint8_t
+#include <exception>        // for exception
+#include <string>           // for string
+#include <vector>           // for vector
+#include "bench/savegen.h"  // for SaveShape, generateSave
+#include "cursor.h"         // for Cursor
+#include "output.h"         // for OutputOptions, OutputFormat, writeProfileOutput
+#include "outputbuffer.h"   // for OutputBuffer
+#include "profile.h"        // for Profile, NodeList, NodeView
+#include "saveencoder.h"    // for SaveEncoder
+#include "sections.h"       // for SectionType
+
+namespace {
+std::string decode(const std::vector<uint8_t>& save, OutputFormat format)
+{
+    OutputOptions options;
+    options.format = format;
+    options.indented = false;
+    OutputBuffer out;
+    writeProfileOutput(Cursor(save.data(), save.size()), options, out);
+    return std::string(out.data(), out.size());
+}
+
+std::vector<NodeView> nodesOf(NodeList list)
+{
+    return std::vector<NodeView>(list.begin(), list.end());
+}
+
+std::vector<uint8_t> encode(const std::vector<uint8_t>& save)
+{
+    const Profile profile(save.data(), save.size());
+    OutputBuffer out;
+    SaveEncoder encoder(out);
+    for (const auto& section : profile.sections()) {
+        switch (section.type) {
+        case SectionType::dht:
+            encoder.nodeSection(section.type, nodesOf(profile.dhtNodes()));
+            break;
+        case SectionType::tcpRelay:
+            encoder.nodeSection(section.type, nodesOf(profile.tcpRelays()));
+            break;
+        case SectionType::pathNode:
+            encoder.nodeSection(section.type, nodesOf(profile.pathNodes()));
+            break;
+        case SectionType::eof:
+            // finish() writes it
+            break;
+        default:
+            encoder.section(section.type, std::span<const uint8_t>(section.data, section.size));
+        }
+    }
+    encoder.finish();
+    return std::vector<uint8_t>(out.data(), out.data() + out.size());
+}
+
+size_t firstDifference(const std::string& a, const std::string& b)
+{
+    size_t i = 0;
+    while (i < a.size() && i < b.size() && a[i] == b[i]) {
+        ++i;
+    }
+    return i;
+}
+
+bool check(const char* name, const SaveShape& shape, uint32_t seed)
+{
+    try {
+        const auto save = generateSave(shape, seed);
+        const auto rewritten = encode(save);
+        for (auto format : {OutputFormat::json, OutputFormat::cbor}) {
+            const auto expected = decode(save, format);
+            const auto actual = decode(rewritten, format);
+            if (expected != actual) {
+                fprintf(stderr, "%s, seed %u: %s output differs at byte %zu\n", name, seed,
+                        format == OutputFormat::json ? "json" : "cbor", firstDifference(expected, actual));
+                return false;
+            }
+        }
+        if (encode(rewritten) != rewritten) {
+            fprintf(stderr, "%s, seed %u: writing the rewritten save again changes it\n", name, seed);
+            return false;
+        }
+    }
+    catch (const std::exception& e) {
+        fprintf(stderr, "%s, seed %u: %s\n", name, seed, e.what());
+        return false;
+    }
+    return true;
+}
+}
+
+int main()
+{
+    struct {
+        const char* name;
+        SaveShape shape;
+    } const cases[] = {
+        {"empty", {}},
+        {"friends", {.friends = 25}},
+        {"nodes", {.dhtNodes = 200, .tcpRelays = 50, .pathNodes = 10}},
+        {"conferences with peers", {.conferences = 12, .peersPerConference = 30}},
+        {"conferences without peers", {.conferences = 4}},
+        {"everything", {.friends = 40, .dhtNodes = 100, .tcpRelays = 20, .pathNodes = 5, .conferences = 6,
+                        .peersPerConference = 9}},
+    };
+
+    size_t failed = 0;
+    size_t checked = 0;
+    for (const auto& testCase : cases) {
+        for (uint32_t seed = 1; seed <= 3; ++seed) {
+            ++checked;
+            failed += !check(testCase.name, testCase.shape, seed);
+        }
+    }
+    fprintf(stderr, "%zu/%zu saves round-tripped\n", checked - failed, checked);
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,109 @@
+// Checks that --select accepts every path the decoders actually write. selection.cpp keeps its own table of the
+// document's sections and fields to reject paths that can never select anything; a key renamed or added in the
+// decoders without updating that table would make --select reject valid paths, so this fails instead. The paths are
+// recorded from a generated save with every kind of section, an unknown one included.
+
+#include <stdio.h>          // for fprintf
+#include <stdlib.h>         // for EXIT_FAILURE, EXIT_SUCCESS
+#include <cstdint>          // for uint8_t, int64_t, uint64_t
+#include <exception>        // for exception
+#include <set>              // for set
+#include <string>           // for string
+#include <vector>           // for vector
+#include "bench/savegen.h"  // for SaveShape, generateSave
+#include "cursor.h"         // for Cursor
+#include "decoders.h"       // for writeProfile
+#include "outputbuffer.h"   // for OutputBuffer
+#include "profile.h"        // for Profile
+#include "saveencoder.h"    // for SaveEncoder
+#include "sections.h"       // for SectionType
+#include "selection.h"      // for Selection
+#include "writer.h"         // for Writer
+
+namespace {
+// Records the path of every value written, in --select syntax: "Friends", "Friends[].Name", ...
+class PathRecorder : public Writer {
+public:
+    void beginObject() override { open(false); }
+    void endObject() override { containers.pop_back(); }
+    void beginArray() override { open(true); }
+    void endArray() override { containers.pop_back(); }
+    void key(const char* name) override { pendingKey = name; }
+
+    void string(const char*, size_t) override { value(); }
+    void number(int64_t) override { value(); }
+    void hex(const uint8_t*, size_t) override { value(); }
+    void timestamp(uint64_t) override { value(); }
+
+    std::set<std::string> paths;
+
+private:
+    struct Container {
+        std::string path;
+        bool array;
+    };
+
+    std::string value()
+    {
+        if (containers.empty()) {
+            return {};
+        }
+        const auto& parent = containers.back();
+        std::string path = parent.array ? parent.path + "[]"
+                                        : (parent.path.empty() ? "" : parent.path + ".") + pendingKey;
+        paths.insert(path);
+        return path;
+    }
+
+    void open(bool array) { containers.push_back({value(), array}); }
+
+    std::vector<Container> containers;
+    std::string pendingKey;
+};
+
+// A generated save with an unknown section added before its EOF section.
+std::vector<uint8_t> saveWithEverySection()
+{
+    const auto generated = generateSave({.friends = 3, .dhtNodes = 4, .tcpRelays = 2, .pathNodes = 2, .conferences = 2,
+                                         .peersPerConference = 3});
+    const Profile profile(generated.data(), generated.size());
+    OutputBuffer out;
+    SaveEncoder encoder(out);
+    for (const auto& section : profile.sections()) {
+        if (section.type != SectionType::eof) {
+            encoder.section(section.type, std::span<const uint8_t>(section.data, section.size));
+        }
+    }
+    const uint8_t unknown[] = {1, 2, 3};
+    encoder.section(static_cast<SectionType>(30), unknown);
+    encoder.finish();
+    return std::vector<uint8_t>(out.data(), out.data() + out.size());
+}
+}
+
+int main()
+{
+    PathRecorder recorder;
+    try {
+        const auto save = saveWithEverySection();
+        writeProfile(Cursor(save.data(), save.size()), recorder);
+    }
+    catch (const std::exception& e) {
+        fprintf(stderr, "Decoding the generated save failed: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+
+    size_t rejected = 0;
+    for (const auto& path : recorder.paths) {
+        try {
+            Selection().add(path);
+        }
+        catch (const std::exception& e) {
+            fprintf(stderr, "%s\n", e.what());
+            ++rejected;
+        }
+    }
+    fprintf(stderr, "%zu/%zu decoded paths accepted by --select\n", recorder.paths.size() - rejected,
+            recorder.paths.size());
+    return rejected == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,133 @@
+#include "threadpool.h"
+#include <algorithm>  // for find, max
+#include <atomic>     // for atomic
+
+struct ThreadPool::Job {
+    void (*task)(void*, size_t);
+    void* context;
+    size_t count;
+    std::atomic<size_t> next{0};
+    // workers inside run(), guarded by the pool's mutex
+    unsigned helpers = 0;
+
+    void runTasks()
+    {
+        for (size_t i = next.fetch_add(1, std::memory_order_relaxed); i < count;
+             i = next.fetch_add(1, std::memory_order_relaxed)) {
+            task(context, i);
+        }
+    }
+};
+
+ThreadPool& ThreadPool::global()
+{
+    static ThreadPool pool(std::thread::hardware_concurrency());
+    return pool;
+}
+
+ThreadPool::ThreadPool(unsigned threads)
+    : threadCount(std::max(1u, threads))
+{
+}
+
+ThreadPool::~ThreadPool()
+{
+    stop();
+}
+
+void ThreadPool::setMaxThreadCount(unsigned threads)
+{
+    stop();
+    threadCount = std::max(1u, threads);
+}
+
+bool ThreadPool::busy() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return active + 1 >= threadCount;
+}
+
+void ThreadPool::run(size_t count, void (*task)(void*, size_t), void* context)
+{
+    if (count < 2 || threadCount < 2) {
+        for (size_t i = 0; i < count; ++i) {
+            task(context, i);
+        }
+        return;
+    }
+
+    Job job;
+    job.task = task;
+    job.context = context;
+    job.count = count;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        start();
+        jobs.push_back(&job);
+    }
+    wake.notify_all();
+
+    job.runTasks();
+
+    // every task has been taken, wait for the workers still running one
+    std::unique_lock<std::mutex> lock(mutex);
+    const auto queued = std::find(jobs.begin(), jobs.end(), &job);
+    if (queued != jobs.end()) {
+        jobs.erase(queued);
+    }
+    finished.wait(lock, [&job] { return job.helpers == 0; });
+}
+
+void ThreadPool::start()
+{
+    if (!threads.empty()) {
+        return;
+    }
+    // the calling thread is the last one
+    threads.reserve(threadCount - 1);
+    for (unsigned i = 1; i < threadCount; ++i) {
+        threads.emplace_back(&ThreadPool::work, this);
+    }
+}
+
+void ThreadPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+    stopping = false;
+}
+
+void ThreadPool::work()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+        if (stopping) {
+            return;
+        }
+        Job& job = *jobs.front();
+        ++job.helpers;
+        ++active;
+        lock.unlock();
+
+        job.runTasks();
+
+        lock.lock();
+        --active;
+        // nothing left to take, don't let idle workers pick it up again
+        const auto queued = std::find(jobs.begin(), jobs.end(), &job);
+        if (queued != jobs.end()) {
+            jobs.erase(queued);
+        }
+        if (--job.helpers == 0) {
+            finished.notify_all();
+        }
+    }
+}
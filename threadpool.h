@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>           // for min
+#include <condition_variable>  // for condition_variable
+#include <cstddef>             // for size_t
+#include <mutex>               // for mutex
+#include <thread>              // for thread
+#include <utility>             // for declval
+#include <vector>              // for vector
+
+// A fixed set of worker threads for the parallel decoders and batches, started on the first parallel run so that
+// decoding a single small save never starts any. The calling thread of run() works on its own tasks too and only
+// returns once all of them are done, so a task may run() again (a batch task decoding a large section in parallel)
+// without waiting on the pool: whichever threads are idle help out.
+class ThreadPool {
+public:
+    // As many threads as the hardware runs at once.
+    static ThreadPool& global();
+
+    // threads counts the thread calling run(), so one less worker is started, and none for 1.
+    explicit ThreadPool(unsigned threads);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned maxThreadCount() const { return threadCount; }
+    // Stops the workers, which are started again for the next run(). Not while a run() is in progress.
+    void setMaxThreadCount(unsigned threads);
+    // Whether every worker is running a task, so that a run() now would only run on the calling thread.
+    bool busy() const;
+
+    // Calls task(context, i) for every i below count, spread over the workers and the calling thread, and returns when
+    // all calls have. Tasks must not throw.
+    void run(size_t count, void (*task)(void* context, size_t i), void* context);
+
+private:
+    struct Job;
+
+    void start();
+    void stop();
+    void work();
+
+    unsigned threadCount;
+    std::vector<std::thread> threads;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    // oldest first, so nested runs don't starve the one that started them
+    std::vector<Job*> jobs;
+    unsigned active = 0;
+    bool stopping = false;
+};
+
+// Calls function on every element of items on the global pool, like QtConcurrent::blockingMap().
+template<typename Container, typename Function>
+void blockingMap(Container& items, Function function)
+{
+    struct Context {
+        Container& items;
+        Function& function;
+    } context{items, function};
+    ThreadPool::global().run(items.size(), [](void* context, size_t i) {
+        auto& map = *static_cast<Context*>(context);
+        map.function(map.items[i]);
+    }, &context);
+}
+
+// Calls map on every element of items on the global pool, and merge with each result on the calling thread, in the
+// order of items. Items are mapped a window of a few per thread at a time, which bounds the results waiting for an
+// earlier one to be merged by the window rather than by the number of items. map must not throw; an exception from
+// merge stops the map and is passed on to the caller.
+template<typename Container, typename Map, typename Merge>
+void orderedMap(const Container& items, Map map, Merge merge)
+{
+    using Item = typename Container::value_type;
+    struct Pending {
+        const Item* item;
+        decltype(map(std::declval<const Item&>())) result;
+    };
+    const size_t window = static_cast<size_t>(ThreadPool::global().maxThreadCount()) * 8;
+    std::vector<Pending> pending;
+    for (size_t first = 0; first < items.size(); first += window) {
+        pending.clear();
+        for (size_t i = first; i < std::min(first + window, items.size()); ++i) {
+            pending.push_back({&items[i], {}});
+        }
+        blockingMap(pending, [&map](Pending& next) { next.result = map(*next.item); });
+        for (const auto& next : pending) {
+            merge(next.result);
+        }
+    }
+}
@@ -1,28 +1,105 @@
 #include "utils.h"
-#include <stdio.h>  // for sprintf
 #include <cstdint>  // for uint8_t
 #include <string>   // for string
-#include <vector>   // for vector
 #include <stdexcept>
+#include "hex.h"    // for hexEncode
 
-std::string readString(uint8_t*& data, size_t length)
+namespace {
+constexpr uint8_t endianSample[] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x88};
+static_assert(loadNumber<Endianness::little, uint16_t>(endianSample) == 0x0201);
+static_assert(loadNumber<Endianness::big, uint16_t>(endianSample) == 0x0102);
+static_assert(loadNumber<Endianness::little, uint32_t>(endianSample) == 0x04030201);
+static_assert(loadNumber<Endianness::big, uint32_t>(endianSample + 4) == 0x05060788);
+// the old int based shifts lost everything above bit 31 here
+static_assert(loadNumber<Endianness::little, uint64_t>(endianSample) == 0x8807060504030201);
+static_assert(loadNumber<Endianness::big, uint64_t>(endianSample) == 0x0102030405060788);
+static_assert(loadNumber<Endianness::little, int16_t>(endianSample + 6) == -30713);
+}
+
+size_t utf8SequenceLength(const unsigned char* data, size_t available)
+{
+    const unsigned char c = data[0];
+    size_t length;
+    unsigned char min = 0x80, max = 0xbf; // allowed range of the second byte
+    if (c >= 0xc2 && c <= 0xdf) {
+        length = 2;
+    } else if (c >= 0xe0 && c <= 0xef) {
+        length = 3;
+        if (c == 0xe0) {
+            min = 0xa0; // overlong
+        } else if (c == 0xed) {
+            max = 0x9f; // surrogates
+        }
+    } else if (c >= 0xf0 && c <= 0xf4) {
+        length = 4;
+        if (c == 0xf0) {
+            min = 0x90; // overlong
+        } else if (c == 0xf4) {
+            max = 0x8f; // above U+10FFFF
+        }
+    } else {
+        return 0;
+    }
+
+    if (available < length || data[1] < min || data[1] > max) {
+        return 0;
+    }
+    for (size_t i = 2; i < length; ++i) {
+        if ((data[i] & 0xc0) != 0x80) {
+            return 0;
+        }
+    }
+    return length;
+}
+
+bool toValidUtf8(const char* data, size_t length, std::string& fixed)
 {
-    auto string = std::string(reinterpret_cast<char*>(data), length);
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+    size_t i = 0;
+    while (i < length && bytes[i] < 0x80) {
+        ++i;
+    }
+    bool valid = true;
+    while (i < length) {
+        if (bytes[i] < 0x80) {
+            if (!valid) {
+                fixed += data[i];
+            }
+            ++i;
+            continue;
+        }
+        const auto sequence = utf8SequenceLength(bytes + i, length - i);
+        if (sequence == 0 && valid) {
+            valid = false;
+            fixed.assign(data, i);
+        }
+        if (sequence == 0) {
+            fixed += "\xEF\xBF\xBD"; // U+FFFD
+            ++i;
+        } else {
+            if (!valid) {
+                fixed.append(data + i, sequence);
+            }
+            i += sequence;
+        }
+    }
+    return valid;
+}
+
+std::string readString(const uint8_t*& data, size_t length)
+{
+    auto string = std::string(reinterpret_cast<const char*>(data), length);
     data += length;
     return string;
 }
 
-std::string readHexData(uint8_t*& data, int size)
+std::string readHexData(const uint8_t*& data, int size)
 {
-    std::vector<char> hexString(size*2, 0);
-
-    for (int i = 0; i < size; ++i)
-    {
-        sprintf(hexString.data()+i*2, "%02X", data[i]);
-    }
+    std::string hexString(size*2, '\0');
+    hexEncode(data, size, &hexString[0]);
     data += size;
 
-    return {hexString.begin(), hexString.end()};
+    return hexString;
 }
 
 std::string userStatusToString(UserStatus status)
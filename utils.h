@@ -1,8 +1,11 @@
 #pragma once
 
+#include <bit>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <string>
+#include <type_traits>
 
 enum class FriendStatus {
     notAFriend,
@@ -24,26 +27,81 @@ enum class Endianness {
 };
 
 template <typename T>
-T dataToNumber(uint8_t*& data, Endianness order = Endianness::little)
+constexpr T byteSwap(T value)
 {
-    T val = 0;
-    int size = sizeof(T);
-    // TODO: don't assume host is little endian
-    if (order == Endianness::little) {
-        for (int i = 0; i < size; ++i) {
-            val |= data[i] << 8*i;
-        }
+    if constexpr (sizeof(T) == 1) {
+        return value;
+    } else if constexpr (sizeof(T) == 2) {
+        return static_cast<T>(__builtin_bswap16(static_cast<uint16_t>(value)));
+    } else if constexpr (sizeof(T) == 4) {
+        return static_cast<T>(__builtin_bswap32(static_cast<uint32_t>(value)));
     } else {
-        for (int i = 0; i < size; ++i) {
-            val |= data[i] << 8*(size-i-1);
+        static_assert(sizeof(T) == 8, "unsupported integer size");
+        return static_cast<T>(__builtin_bswap64(static_cast<uint64_t>(value)));
+    }
+}
+
+// Reads a T stored in byte order E. At runtime this is one unaligned load, plus a byte swap when E isn't the host's
+// order; in constant expressions it assembles the bytes one by one.
+template <Endianness E, typename T>
+constexpr T loadNumber(const uint8_t* data)
+{
+    static_assert(std::is_integral_v<T>, "loadNumber reads integers");
+    using Unsigned = std::make_unsigned_t<T>;
+
+    if (std::is_constant_evaluated()) {
+        Unsigned val = 0;
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            const size_t shift = E == Endianness::little ? 8*i : 8*(sizeof(T)-i-1);
+            val |= static_cast<Unsigned>(static_cast<Unsigned>(data[i]) << shift);
         }
+        return static_cast<T>(val);
+    }
+
+    Unsigned val;
+    memcpy(&val, data, sizeof(T));
+    constexpr bool hostIsLittle = std::endian::native == std::endian::little;
+    if constexpr ((E == Endianness::little) != hostIsLittle) {
+        val = byteSwap(val);
+    }
+    return static_cast<T>(val);
+}
+
+// Writes value to data in byte order E, the counterpart of loadNumber.
+template <Endianness E, typename T>
+void storeNumber(uint8_t* data, T value)
+{
+    static_assert(std::is_integral_v<T>, "storeNumber writes integers");
+    auto val = static_cast<std::make_unsigned_t<T>>(value);
+    constexpr bool hostIsLittle = std::endian::native == std::endian::little;
+    if constexpr ((E == Endianness::little) != hostIsLittle) {
+        val = byteSwap(val);
     }
-    data += size;
+    memcpy(data, &val, sizeof(T));
+}
+
+template <Endianness E, typename T>
+T dataToNumber(const uint8_t*& data)
+{
+    const T val = loadNumber<E, T>(data);
+    data += sizeof(T);
     return val;
 }
 
-std::string readString(uint8_t*& data, size_t length);
+template <typename T>
+T dataToNumber(const uint8_t*& data, Endianness order = Endianness::little)
+{
+    return order == Endianness::little ? dataToNumber<Endianness::little, T>(data)
+                                       : dataToNumber<Endianness::big, T>(data);
+}
+
+// Length of the well-formed UTF-8 sequence at data, or 0 if it's invalid (QString::fromUtf8 replaces those bytes).
+size_t utf8SequenceLength(const unsigned char* data, size_t available);
+// Returns true if data is valid UTF-8, otherwise sets fixed to data with each invalid byte replaced by U+FFFD.
+bool toValidUtf8(const char* data, size_t length, std::string& fixed);
+
+std::string readString(const uint8_t*& data, size_t length);
 
-std::string readHexData(uint8_t*& data, int size);
+std::string readHexData(const uint8_t*& data, int size);
 std::string userStatusToString(UserStatus status);
 std::string FriendStatusToString(FriendStatus status);
@@ -0,0 +1,207 @@
+#include "watch.h"
+#include <errno.h>          // for errno, EINTR
+#include <stdlib.h>         // for EXIT_FAILURE
+#include <string.h>         // for strerror
+#include <sys/inotify.h>    // for inotify_event, inotify_add_watch, inotify_init1, IN_*
+#include <unistd.h>         // for read, close
+#include <cstdint>          // for uint32_t, uint64_t
+#include <exception>        // for exception
+#include <filesystem>       // for path
+#include <iostream>         // for cerr, endl
+#include <map>              // for map
+#include <memory>           // for unique_ptr
+#include <utility>          // for move
+#include <vector>           // for vector
+#include "cursor.h"         // for Cursor
+#include "decoders.h"       // for writeSection
+#include "encryptedsave.h"  // for DecryptedSave, KeyCache, openSave
+#include "hash.h"           // for hashBytes
+#include "jsonwriter.h"     // for JsonWriter
+#include "mappedfile.h"     // for MappedFile
+#include "outputbuffer.h"   // for OutputBuffer
+#include "sections.h"       // for SectionHeader, SectionType, getAllSections, parseGlobalHeader, sectionToString
+
+namespace {
+struct SectionState {
+    SectionType type;
+    uint32_t size;
+    uint64_t hash;
+
+    bool operator==(const SectionState& other) const
+    {
+        return type == other.type && size == other.size && hash == other.hash;
+    }
+};
+
+struct WatchedProfile {
+    std::string path;
+    std::string fileName;
+    // section table of the last version that parsed
+    std::vector<SectionState> sections;
+};
+
+// Re-reads a profile and writes the sections that changed since the last time to out.
+void update(WatchedProfile& profile, bool indented, const std::optional<std::string>& passphrase, KeyCache& keys,
+            OutputBuffer& out)
+{
+    MappedFile file(profile.path);
+    std::unique_ptr<DecryptedSave> decrypted;
+    Cursor data = openSave(file.data(), file.size(), passphrase, keys, decrypted);
+    parseGlobalHeader(data);
+    const auto headers = getAllSections(data);
+
+    std::vector<SectionState> sections;
+    for (const auto& header : headers) {
+        sections.push_back({header.type, header.size, hashBytes(header.data, header.size)});
+    }
+
+    // a section is unchanged if the old table has one with the same type and contents left over
+    std::vector<bool> matched(profile.sections.size(), false);
+    std::vector<size_t> changed;
+    for (size_t i = 0; i < sections.size(); ++i) {
+        bool found = false;
+        for (size_t j = 0; j < profile.sections.size() && !found; ++j) {
+            if (!matched[j] && profile.sections[j] == sections[i]) {
+                matched[j] = found = true;
+            }
+        }
+        if (!found) {
+            changed.push_back(i);
+        }
+    }
+    std::vector<SectionType> removed;
+    for (const auto& old : profile.sections) {
+        bool stillThere = false;
+        for (const auto& section : sections) {
+            stillThere |= section.type == old.type;
+        }
+        bool listed = false;
+        for (auto type : removed) {
+            listed |= type == old.type;
+        }
+        if (!stillThere && !listed) {
+            removed.push_back(old.type);
+        }
+    }
+
+    if (changed.empty() && removed.empty()) {
+        profile.sections = std::move(sections);
+        return; // touched, or rewritten with the same contents
+    }
+
+    // decoded into a buffer of its own first, so a section that fails to decode doesn't leave half a document
+    thread_local OutputBuffer document;
+    document.clear();
+    JsonWriter writer(document, indented);
+    writer.beginObject();
+    writer.key("File");
+    writer.string(profile.path);
+    writer.key("Changed sections");
+    writer.beginObject();
+    for (auto index : changed) {
+        writer.key(sectionName(headers[index].type));
+        writeSection(headers[index], writer);
+    }
+    writer.endObject();
+    writer.key("Removed sections");
+    writer.beginArray();
+    for (auto type : removed) {
+        writer.string(sectionToString(type));
+    }
+    writer.endArray();
+    writer.endObject();
+    document.append('\n');
+
+    out.append(document.data(), document.size());
+    out.flush();
+    profile.sections = std::move(sections);
+}
+
+void updateAndReport(WatchedProfile& profile, bool indented, const std::optional<std::string>& passphrase,
+                     KeyCache& keys, OutputBuffer& out)
+{
+    try {
+        update(profile, indented, passphrase, keys, out);
+    }
+    catch (const std::exception& e) {
+        std::cerr << profile.path << ": " << e.what() << std::endl;
+    }
+}
+}
+
+int runWatch(const std::vector<std::string>& paths, bool indented, const std::optional<std::string>& passphrase)
+{
+    const int fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "Couldn't initialize inotify: " << strerror(errno) << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<WatchedProfile> profiles;
+    std::map<std::string, int> watchByDirectory;
+    std::map<int, std::vector<size_t>> profilesByWatch;
+    for (const auto& path : paths) {
+        const std::filesystem::path profilePath(path);
+        const std::string directory = profilePath.has_parent_path() ? profilePath.parent_path().string() : ".";
+
+        auto watch = watchByDirectory.find(directory);
+        if (watch == watchByDirectory.end()) {
+            // close-write for saves written in place, moved-to for ones renamed over the profile
+            const int wd = inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+            if (wd < 0) {
+                std::cerr << "Couldn't watch " << directory << ": " << strerror(errno) << std::endl;
+                close(fd);
+                return EXIT_FAILURE;
+            }
+            watch = watchByDirectory.emplace(directory, wd).first;
+        }
+        profilesByWatch[watch->second].push_back(profiles.size());
+        profiles.push_back({path, profilePath.filename().string(), {}});
+    }
+
+    KeyCache keys;
+    OutputBuffer out(1);
+    for (auto& profile : profiles) {
+        updateAndReport(profile, indented, passphrase, keys, out);
+    }
+
+    alignas(inotify_event) char events[64 * 1024];
+    while (true) {
+        const ssize_t length = read(fd, events, sizeof(events));
+        if (length < 0 && errno == EINTR) {
+            continue;
+        }
+        if (length <= 0) {
+            std::cerr << "Reading inotify events failed: " << strerror(errno) << std::endl;
+            close(fd);
+            return EXIT_FAILURE;
+        }
+
+        // one update per profile however many events a save caused
+        std::vector<bool> dirty(profiles.size(), false);
+        for (ssize_t offset = 0; offset < length;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(events + offset);
+            offset += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                dirty.assign(profiles.size(), true);
+                continue;
+            }
+            auto watched = profilesByWatch.find(event->wd);
+            if (event->len == 0 || watched == profilesByWatch.end()) {
+                continue;
+            }
+            for (auto index : watched->second) {
+                if (profiles[index].fileName == event->name) {
+                    dirty[index] = true;
+                }
+            }
+        }
+
+        for (size_t i = 0; i < profiles.size(); ++i) {
+            if (dirty[i]) {
+                updateAndReport(profiles[i], indented, passphrase, keys, out);
+            }
+        }
+    }
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <optional>  // for optional
+#include <string>    // for string
+#include <vector>    // for vector
+
+// Watches the profiles with inotify until killed. Their parent directories are watched rather than the files, so both
+// in-place writes and toxcore's write-to-temp-then-rename are seen. Every profile is printed in full once, then on each
+// change a {"File", "Changed sections", "Removed sections"} document holds only the sections whose contents differ
+// from the previous version. A profile that can't be parsed (e.g. caught mid-write) is reported on stderr and picked
+// up again with its next change. Returns EXIT_FAILURE if the watches can't be set up.
+int runWatch(const std::vector<std::string>& paths, bool indented, const std::optional<std::string>& passphrase);
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>  // for size_t
+#include <cstdint>  // for int64_t, uint8_t, uint64_t
+#include <cstring>  // for memchr
+#include <memory>   // for unique_ptr
+#include <string>   // for string
+#include "cursor.h"  // for Cursor
+
+// Receives a decoded profile as a stream of events, in the order the fields appear in the save. The decoders only
+// talk to this interface, so every output backend shares the same section and field model.
+class Writer {
+public:
+    virtual ~Writer() = default;
+
+    virtual void beginObject() = 0;
+    virtual void endObject() = 0;
+    virtual void beginArray() = 0;
+    virtual void endArray() = 0;
+    // name has to outlive the writer (the decoders only pass string literals), writers may keep the pointer.
+    virtual void key(const char* name) = 0;
+
+    // Text as stored in the save (expected to be UTF-8). Callers cut it at the first NUL.
+    virtual void string(const char* data, size_t length) = 0;
+    virtual void number(int64_t value) = 0;
+    // Keys, ids and other binary blobs.
+    virtual void hex(const uint8_t* data, size_t length) = 0;
+    virtual void timestamp(uint64_t secondsSinceEpoch) = 0;
+
+    void string(const std::string& value) { string(value.data(), value.size()); }
+
+    // For decoding the elements of the array that's open in this writer on several threads. fork() returns an
+    // independent writer with the same settings that takes a run of elements of that array, and splice() appends
+    // everything a fork received as the array's next elements, as if they had been written here. With nested > 0 the
+    // fork is for an array that will be open that many containers further in by the time it's spliced. Forks can be
+    // written concurrently with each other, and are spliced in order from the thread that owns this writer. Writers
+    // that don't support this return nullptr and have to be written from one thread.
+    virtual std::unique_ptr<Writer> fork(size_t nested = 0) const { (void)nested; return nullptr; }
+    virtual void splice(Writer& fork) { (void)fork; }
+};
+
+// Writes the next size bytes as hex. Unchecked, the caller has already required them.
+inline void writeHex(Cursor& data, size_t size, Writer& out)
+{
+    out.hex(data.advance(size), size);
+}
+
+// Writes a length byte string field. Like the old QString(const char*) conversion, the value ends at the first NUL.
+inline void writeString(const uint8_t* data, size_t length, Writer& out)
+{
+    const auto* nul = static_cast<const uint8_t*>(memchr(data, 0, length));
+    out.string(reinterpret_cast<const char*>(data), nul ? nul - data : length);
+}
+
+// Unchecked, the caller has already required the bytes.
+inline void writeString(Cursor& data, size_t length, Writer& out)
+{
+    writeString(data.advance(length), length, out);
+}